@@ -0,0 +1,101 @@
+#include "benchrunner.hpp"
+#include <QTextStream>
+#include <algorithm>
+
+void BenchRunner::Stopwatch::start()
+{
+	timer.start();
+}
+
+void BenchRunner::Stopwatch::stop()
+{
+	total += timer.nsecsElapsed();
+}
+
+qint64 BenchRunner::Stopwatch::nanoseconds() const
+{
+	return total;
+}
+
+BenchRunner::BenchRunner(int repetitions, const QString& filter) : repetitions(std::max(1, repetitions)), filter(filter)
+{
+}
+
+bool BenchRunner::isSelected(const QString& name) const
+{
+	return filter.pattern().isEmpty() || filter.match(name).hasMatch();
+}
+
+void BenchRunner::run(const QString& name, const QString& corpus, qint64 bytes, const Repetition& repetition)
+{
+	if (!isSelected(name))
+	{
+		return;
+	}
+
+	QTextStream log(stderr);
+	QList<qint64> times;
+	QVariantMap counters;
+	for (int i = 0; i < repetitions; ++i)
+	{
+		Stopwatch stopwatch;
+		counters = repetition(stopwatch);
+		times.append(stopwatch.nanoseconds());
+	}
+
+	QList<qint64> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	qint64 median = sorted[sorted.size() / 2];
+	double mean = 0;
+	QJsonArray samples;
+	for (qint64 time : times)
+	{
+		mean += double(time) / times.size();
+		samples.append(time);
+	}
+	double bytesPerSecond = median > 0 ? double(bytes) * 1e9 / double(median) : 0;
+
+	QJsonObject result;
+	result["name"] = name;
+	result["corpus"] = corpus;
+	result["bytes"] = bytes;
+	result["repetitions"] = repetitions;
+	result["time_unit"] = "ns";
+	result["real_time"] = double(median);
+	result["min_time"] = double(sorted.first());
+	result["mean_time"] = mean;
+	result["samples"] = samples;
+	result["bytes_per_second"] = bytesPerSecond;
+	for (auto it = counters.cbegin(); it != counters.cend(); ++it)
+	{
+		result[it.key()] = QJsonValue::fromVariant(it.value());
+	}
+	results.append(result);
+
+	log << name.leftJustified(48) << QString::number(median / 1e6, 'f', 2).rightJustified(12) << " ms" << QString::number(bytesPerSecond / (1024 * 1024), 'f', 1).rightJustified(12)
+	    << " MiB/s" << Qt::endl;
+}
+
+void BenchRunner::skip(const QString& name, const QString& corpus, const QString& reason)
+{
+	if (!isSelected(name))
+	{
+		return;
+	}
+
+	QJsonObject result;
+	result["name"] = name;
+	result["corpus"] = corpus;
+	result["skipped"] = reason;
+	results.append(result);
+
+	QTextStream(stderr) << name.leftJustified(48) << " skipped: " << reason << Qt::endl;
+}
+
+QJsonObject BenchRunner::report(const QJsonObject& context) const
+{
+	QJsonObject report;
+	report["context"] = context;
+	report["benchmarks"] = results;
+	return report;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QVariantMap>
+#include <functional>
+
+// Times the selected benchmarks and collects the results in the layout of Google Benchmark's
+// JSON reporter ("context" plus a "benchmarks" array), so runs can be compared with its tools.
+class BenchRunner
+{
+  public:
+	// Accumulates the time spent in the measured parts of one repetition
+	class Stopwatch
+	{
+	  private:
+		QElapsedTimer timer;
+		qint64 total = 0;
+
+	  public:
+		void start();
+		void stop();
+		qint64 nanoseconds() const;
+	};
+
+	// Runs one repetition and returns extra counters (tokens, hits, ...) to report with it
+	using Repetition = std::function<QVariantMap(Stopwatch& stopwatch)>;
+
+  private:
+	int repetitions;
+	QRegularExpression filter;
+	QJsonArray results;
+
+  public:
+	BenchRunner(int repetitions, const QString& filter);
+
+	bool isSelected(const QString& name) const;
+	void run(const QString& name, const QString& corpus, qint64 bytes, const Repetition& repetition);
+	void skip(const QString& name, const QString& corpus, const QString& reason);
+
+	QJsonObject report(const QJsonObject& context) const;
+};
@@ -0,0 +1,396 @@
+#include "corpus.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+	// Bump when the generators change so that stale corpus files are not reused
+	constexpr int generatorVersion = 1;
+
+	constexpr qint64 writeBufferSize = 4 * 1024 * 1024;
+
+	const QStringList words = {
+		"value", "index", "buffer", "count", "result", "node", "item", "state", "offset", "length",
+		"text", "block", "cache", "token", "line", "file", "range", "cursor", "data", "size",
+		"parent", "child", "first", "last", "next", "entry", "table", "queue", "worker", "chunk"
+	};
+
+	// Non-ASCII text so the decoders and word counters do not only see ASCII
+	const QStringList foreignWords = { "données", "größe", "значение", "строка", "κόμβος", "ファイル", "naïve", "façade" };
+
+	const QStringList typeNames = { "QString", "QVector", "QTextBlock", "PieceTable", "Lexer", "Token", "Node", "Range" };
+
+	const QStringList logLevels = { "DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+	const QStringList logModules = { "http", "db.pool", "scheduler", "auth", "cache", "storage", "rpc" };
+
+	// Elements of a braced list are evaluated left to right, unlike the operands of +, so the
+	// random numbers are drawn in the same order by every compiler
+	QString cat(std::initializer_list<QString> parts)
+	{
+		QString text;
+		for (const QString& part : parts)
+		{
+			text += part;
+		}
+		return text;
+	}
+
+}; // namespace
+
+namespace corpus
+{
+	QList<Kind> allKinds()
+	{
+		return { Kind::Cpp, Kind::Python, Kind::JavaScript, Kind::Log };
+	}
+
+	QString kindName(Kind kind)
+	{
+		switch (kind)
+		{
+			case Kind::Cpp: return "cpp";
+			case Kind::Python: return "python";
+			case Kind::JavaScript: return "javascript";
+			case Kind::Log: return "log";
+		}
+		return QString();
+	}
+
+	QString languageOf(Kind kind)
+	{
+		return kind == Kind::Log ? QString() : kindName(kind);
+	}
+
+	QString extensionOf(Kind kind)
+	{
+		switch (kind)
+		{
+			case Kind::Cpp: return ".cpp";
+			case Kind::Python: return ".py";
+			case Kind::JavaScript: return ".js";
+			case Kind::Log: return ".log";
+		}
+		return QString();
+	}
+
+	QString searchTermOf(Kind kind)
+	{
+		switch (kind)
+		{
+			case Kind::Cpp: return "return";
+			case Kind::Python: return "self";
+			case Kind::JavaScript: return "const";
+			case Kind::Log: return "ERROR";
+		}
+		return QString();
+	}
+
+	Generator::Generator(Kind kind, quint32 seed) : kind(kind), random(seed), lineNumber(0), indent(0), inBlockComment(false)
+	{
+	}
+
+	QString Generator::word()
+	{
+		if (random.bounded(40) == 0)
+		{
+			return foreignWords[random.bounded(int(foreignWords.size()))];
+		}
+		return words[random.bounded(int(words.size()))];
+	}
+
+	QString Generator::identifier()
+	{
+		QString name = words[random.bounded(int(words.size()))];
+		if (random.bounded(3) == 0)
+		{
+			QString second = words[random.bounded(int(words.size()))];
+			second[0] = second[0].toUpper();
+			name += second;
+		}
+		return name;
+	}
+
+	QString Generator::typeName()
+	{
+		return typeNames[random.bounded(int(typeNames.size()))];
+	}
+
+	QString Generator::number()
+	{
+		switch (random.bounded(3))
+		{
+			case 0: return QString::number(random.bounded(1000));
+			case 1: return "0x" + QString::number(random.bounded(0x10000), 16).toUpper();
+			default: return QString::number(random.bounded(100)) + "." + QString::number(random.bounded(100));
+		}
+	}
+
+	QString Generator::sentence(int count)
+	{
+		QStringList parts;
+		for (int i = 0; i < count; ++i)
+		{
+			parts.append(word());
+		}
+		return parts.join(' ');
+	}
+
+	QString Generator::tabs() const
+	{
+		return kind == Kind::Python ? QString(indent * 4, u' ') : QString(indent, u'\t');
+	}
+
+	QString Generator::nextLine()
+	{
+		++lineNumber;
+		switch (kind)
+		{
+			case Kind::Cpp: return cppLine();
+			case Kind::Python: return pythonLine();
+			case Kind::JavaScript: return javaScriptLine();
+			case Kind::Log: return logLine();
+		}
+		return QString();
+	}
+
+	QString Generator::cppLine()
+	{
+		if (inBlockComment)
+		{
+			inBlockComment = random.bounded(4) != 0;
+			return cat({ tabs(), " * ", sentence(6), inBlockComment ? "" : " */" });
+		}
+		if (indent == 0)
+		{
+			switch (random.bounded(6))
+			{
+				case 0: return cat({ "#include \"core/", identifier().toLower(), ".hpp\"" });
+				case 1:
+					inBlockComment = true;
+					return cat({ "/* ", sentence(5) });
+				case 2: return "";
+				default:
+					indent = 1;
+					return cat({ typeName(), " ", typeName(), "::", identifier(), "(const ", typeName(), "& ", identifier(), ", int ", identifier(), ")\n{" });
+			}
+		}
+		switch (random.bounded(9))
+		{
+			case 0: return cat({ tabs(), "// ", sentence(7) });
+			case 1: return cat({ tabs(), "int ", identifier(), " = ", number(), ";" });
+			case 2: return cat({ tabs(), "QString ", identifier(), " = \"", sentence(3), "\";" });
+			case 3: return cat({ tabs(), identifier(), ".", identifier(), "(", identifier(), ", ", number(), ");" });
+			case 4:
+				if (indent < 4)
+				{
+					QString line = cat({ tabs(), "if (", identifier(), " < ", number(), ")\n", tabs(), "{" });
+					++indent;
+					return line;
+				}
+				return cat({ tabs(), "return ", identifier(), ";" });
+			case 5: return cat({ tabs(), "for (qsizetype i = 0; i < ", identifier(), ".size(); ++i)\n", tabs(), "{\n", tabs(), "\t", identifier(), " += ", identifier(), "[i];\n", tabs(), "}" });
+			case 6: return cat({ tabs(), "return ", identifier(), " + ", number(), ";" });
+			default:
+				--indent;
+				return cat({ tabs(), "}" });
+		}
+	}
+
+	QString Generator::pythonLine()
+	{
+		if (indent == 0)
+		{
+			switch (random.bounded(5))
+			{
+				case 0: return cat({ "import ", identifier().toLower() });
+				case 1: return "";
+				case 2: return cat({ "# ", sentence(6) });
+				default:
+					indent = 1;
+					return cat({ "def ", identifier(), "(self, ", identifier(), ", ", identifier(), "=None):" });
+			}
+		}
+		switch (random.bounded(9))
+		{
+			case 0: return cat({ tabs(), "\"\"\"", sentence(8), "\"\"\"" });
+			case 1: return cat({ tabs(), "self.", identifier(), " = ", number() });
+			case 2: return cat({ tabs(), identifier(), " = '", sentence(3), "'" });
+			case 3: return cat({ tabs(), "result = self.", identifier(), "(", identifier(), ")  # ", sentence(3) });
+			case 4:
+				if (indent < 4)
+				{
+					QString line = cat({ tabs(), "for ", identifier(), " in self.", identifier(), ":" });
+					++indent;
+					return line;
+				}
+				return cat({ tabs(), "pass" });
+			case 5: return cat({ tabs(), "if ", identifier(), " is not None and ", identifier(), " > ", number(), ":" });
+			default:
+			{
+				QString line = cat({ tabs(), "return self.", identifier() });
+				--indent;
+				return line;
+			}
+		}
+	}
+
+	QString Generator::javaScriptLine()
+	{
+		if (indent == 0)
+		{
+			switch (random.bounded(5))
+			{
+				case 0: return cat({ "import { ", identifier(), " } from './", identifier(), ".js';" });
+				case 1: return "";
+				case 2: return cat({ "// ", sentence(6) });
+				default:
+					indent = 1;
+					return cat({ "export async function ", identifier(), "(", identifier(), ", ", identifier(), ") {" });
+			}
+		}
+		switch (random.bounded(8))
+		{
+			case 0: return cat({ tabs(), "const ", identifier(), " = `", word(), " ${", identifier(), "} ", word(), "`;" });
+			case 1: return cat({ tabs(), "let ", identifier(), " = ", number(), ";" });
+			case 2: return cat({ tabs(), "const ", identifier(), " = await ", identifier(), ".", identifier(), "('", sentence(2), "');" });
+			case 3:
+				if (indent < 4)
+				{
+					QString line = cat({ tabs(), "if (", identifier(), " !== null) {" });
+					++indent;
+					return line;
+				}
+				return cat({ tabs(), "return ", identifier(), ";" });
+			case 4: return cat({ tabs(), "/* ", sentence(5), " */" });
+			case 5: return cat({ tabs(), identifier(), ".push({ ", identifier(), ": ", number(), ", ", identifier(), ": \"", word(), "\" });" });
+			default:
+				--indent;
+				return cat({ tabs(), "}" });
+		}
+	}
+
+	QString Generator::logLine()
+	{
+		// One line per ~10 ms of simulated time, starting at a fixed date
+		qint64 ms = lineNumber * 10 + random.bounded(10);
+		QString timestamp = QString("2024-03-%1T%2:%3:%4.%5Z")
+		                        .arg(1 + (ms / 86400000) % 28, 2, 10, QChar(u'0'))
+		                        .arg((ms / 3600000) % 24, 2, 10, QChar(u'0'))
+		                        .arg((ms / 60000) % 60, 2, 10, QChar(u'0'))
+		                        .arg((ms / 1000) % 60, 2, 10, QChar(u'0'))
+		                        .arg(ms % 1000, 3, 10, QChar(u'0'));
+		QString level = logLevels[random.bounded(int(logLevels.size()))];
+		QString module = logModules[random.bounded(int(logModules.size()))];
+		QString address = QString("10.%1.%2.%3").arg(random.bounded(256)).arg(random.bounded(256)).arg(random.bounded(256));
+		return cat({ timestamp, " ", level.leftJustified(5), " [", module, "] ", sentence(5), " client=", address, " id=", QString::number(random.bounded(1000000)), " took=",
+		             QString::number(random.bounded(5000)), "ms" });
+	}
+
+	qint64 parseSize(const QString& text)
+	{
+		QString trimmed = text.trimmed().toUpper();
+		qint64 unit = 1;
+		if (trimmed.endsWith(u'K'))
+		{
+			unit = 1024;
+		}
+		else if (trimmed.endsWith(u'M'))
+		{
+			unit = 1024 * 1024;
+		}
+		else if (trimmed.endsWith(u'G'))
+		{
+			unit = 1024 * 1024 * 1024;
+		}
+		if (unit != 1)
+		{
+			trimmed.chop(1);
+		}
+
+		bool ok = false;
+		qint64 value = trimmed.toLongLong(&ok);
+		return ok && value > 0 ? value * unit : -1;
+	}
+
+	QString ensureFile(const QString& directory, Kind kind, const QString& sizeLabel, qint64 bytes, quint32 seed)
+	{
+		QString path = QDir(directory).filePath(QString("%1-%2-s%3-v%4%5").arg(kindName(kind), sizeLabel).arg(seed).arg(generatorVersion).arg(extensionOf(kind)));
+		if (QFileInfo(path).size() >= bytes)
+		{
+			return path;
+		}
+
+		QDir().mkpath(directory);
+		QSaveFile file(path);
+		if (!file.open(QIODeviceBase::WriteOnly))
+		{
+			qDebug() << "Failed to create corpus:" << path << file.errorString();
+			return QString();
+		}
+
+		Generator generator(kind, seed);
+		QByteArray buffer;
+		buffer.reserve(writeBufferSize + 4096);
+		qint64 written = 0;
+		while (written + buffer.size() < bytes)
+		{
+			buffer += generator.nextLine().toUtf8();
+			buffer += '\n';
+			if (buffer.size() >= writeBufferSize)
+			{
+				if (file.write(buffer) != buffer.size())
+				{
+					break;
+				}
+				written += buffer.size();
+				buffer.clear();
+			}
+		}
+		file.write(buffer);
+
+		if (!file.commit())
+		{
+			qDebug() << "Failed to write corpus:" << path << file.errorString();
+			return QString();
+		}
+		return path;
+	}
+
+	bool forEachChunk(const QString& path, qint64 chunkBytes, const std::function<void(const QByteArray&)>& visitor)
+	{
+		QFile file(path);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			qDebug() << "Failed to open corpus:" << path << file.errorString();
+			return false;
+		}
+
+		QByteArray carry;
+		while (!file.atEnd())
+		{
+			QByteArray chunk = carry + file.read(chunkBytes);
+			qsizetype end = chunk.lastIndexOf('\n') + 1;
+			if (end == 0 && !file.atEnd())
+			{
+				carry = chunk;
+				continue;
+			}
+			if (end == 0)
+			{
+				end = chunk.size();
+			}
+			carry = chunk.mid(end);
+			chunk.truncate(end);
+			visitor(chunk);
+		}
+		if (!carry.isEmpty())
+		{
+			visitor(carry);
+		}
+		return true;
+	}
+
+}; // namespace corpus
@@ -0,0 +1,65 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+#include <functional>
+
+// Synthetic benchmark inputs. A generator only depends on its kind and seed, so a corpus of
+// a given size is the same file on every machine and every run.
+namespace corpus
+{
+	enum class Kind
+	{
+		Cpp,
+		Python,
+		JavaScript,
+		Log
+	};
+
+	QList<Kind> allKinds();
+	QString kindName(Kind kind);
+	// Language of the built-in lexer for the kind, empty for logs
+	QString languageOf(Kind kind);
+	QString extensionOf(Kind kind);
+	// A word that occurs throughout the corpus, used by the search benchmarks
+	QString searchTermOf(Kind kind);
+
+	class Generator
+	{
+	  private:
+		Kind kind;
+		QRandomGenerator random;
+		qint64 lineNumber;
+		int indent;
+		bool inBlockComment;
+
+		QString word();
+		QString identifier();
+		QString typeName();
+		QString number();
+		QString sentence(int words);
+		QString tabs() const;
+
+		QString cppLine();
+		QString pythonLine();
+		QString javaScriptLine();
+		QString logLine();
+
+	  public:
+		Generator(Kind kind, quint32 seed);
+
+		// One line without its line break
+		QString nextLine();
+	};
+
+	// "1M", "100M", "1G" (binary units); -1 if the text is not a size
+	qint64 parseSize(const QString& text);
+
+	// Path of the corpus file in directory, generated on first use; empty if it could not be written
+	QString ensureFile(const QString& directory, Kind kind, const QString& sizeLabel, qint64 bytes, quint32 seed);
+
+	// Reads a file in pieces of about chunkBytes that end at a line break
+	bool forEachChunk(const QString& path, qint64 chunkBytes, const std::function<void(const QByteArray&)>& visitor);
+
+}; // namespace corpus
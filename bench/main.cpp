@@ -0,0 +1,516 @@
+#include "benchrunner.hpp"
+#include "corpus.hpp"
+#include "core/filesearcher.hpp"
+#include "core/lexer.hpp"
+#include "core/matchfinder.hpp"
+#include "core/piecetable.hpp"
+#include "core/replaceengine.hpp"
+#include "core/searchindex.hpp"
+#include "core/simd.hpp"
+#include "core/syntaxhighlighter.hpp"
+#include "core/textcodec.hpp"
+#include "core/textstats.hpp"
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QSysInfo>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+
+namespace
+{
+	constexpr quint32 defaultSeed = 20240301;
+	// Streamed benchmarks read and decode the corpus in pieces of this size outside the timed part
+	constexpr qint64 chunkBytes = 16 * 1024 * 1024;
+
+	// C++ keywords of the highlighter before the DFA lexer, which ran one expression per keyword
+	const QStringList baselineKeywords = {
+		"char", "class", "const", "double", "enum", "explicit", "friend", "inline", "int", "long",
+		"namespace", "operator", "private", "protected", "public", "short", "signals", "signed", "slots", "static",
+		"struct", "template", "typedef", "typename", "union", "unsigned", "virtual", "void", "volatile", "bool",
+		"if", "else", "for", "while", "do", "switch", "case", "break", "continue", "return",
+		"goto", "try", "catch", "throw", "new", "delete", "sizeof", "this", "true", "false",
+		"nullptr", "null", "auto", "using"
+	};
+
+	struct Corpus
+	{
+		corpus::Kind kind;
+		QString name; // "cpp-1M"
+		QString path;
+		qint64 bytes;
+	};
+
+	QString decodeChunk(const QByteArray& bytes)
+	{
+		QString text;
+		if (!textcodec::decodeUtf8(bytes, text))
+		{
+			text = QString::fromUtf8(bytes);
+		}
+		return text;
+	}
+
+	template <typename Visitor>
+	void forEachLine(QStringView text, Visitor&& visitor)
+	{
+		qsizetype start = 0;
+		while (start < text.size())
+		{
+			qsizetype end = text.indexOf(u'\n', start);
+			if (end < 0)
+			{
+				end = text.size();
+			}
+			visitor(text.sliced(start, end - start));
+			start = end + 1;
+		}
+	}
+
+	void benchDecode(BenchRunner& runner, const Corpus& input)
+	{
+		runner.run("decode/utf8/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           qint64 chars = 0;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                QString text;
+				                                stopwatch.start();
+				                                textcodec::decodeUtf8(bytes, text);
+				                                stopwatch.stop();
+				                                chars += text.size();
+			                                });
+			           return QVariantMap{ { "chars", chars } };
+		           });
+
+		// Baseline: Qt's own decoder
+		runner.run("decode/qt/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           qint64 chars = 0;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                stopwatch.start();
+				                                QString text = QString::fromUtf8(bytes);
+				                                stopwatch.stop();
+				                                chars += text.size();
+			                                });
+			           return QVariantMap{ { "chars", chars } };
+		           });
+	}
+
+	void benchWords(BenchRunner& runner, const Corpus& input)
+	{
+		runner.run("words/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           qint64 words = 0;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                PieceTable text(decodeChunk(bytes));
+				                                stopwatch.start();
+				                                words += textstats::countWords(text);
+				                                stopwatch.stop();
+			                                });
+			           return QVariantMap{ { "words", words } };
+		           });
+
+		// The same counts straight from the file's bytes, without decoding
+		runner.run("words-utf8/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           textstats::Counts total;
+			           textstats::ScanState state;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                stopwatch.start();
+				                                textstats::Counts counts = textstats::countUtf8(bytes, state);
+				                                stopwatch.stop();
+				                                total.words += counts.words;
+				                                total.chars += counts.chars;
+			                                });
+			           return QVariantMap{ { "words", total.words }, { "chars", total.chars } };
+		           });
+
+		// Baseline: the regular expression word count the status bar used to run
+		runner.run("words-regex/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           const QRegularExpression expression("\\b\\w+\\b", QRegularExpression::UseUnicodePropertiesOption);
+			           qint64 words = 0;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                QString text = decodeChunk(bytes);
+				                                stopwatch.start();
+				                                QRegularExpressionMatchIterator it = expression.globalMatch(text);
+				                                while (it.hasNext())
+				                                {
+					                                it.next();
+					                                ++words;
+				                                }
+				                                stopwatch.stop();
+			                                });
+			           return QVariantMap{ { "words", words } };
+		           });
+	}
+
+	void benchLexer(BenchRunner& runner, const Corpus& input)
+	{
+		const Lexer* lexer = Lexer::forLanguage(corpus::languageOf(input.kind));
+		if (lexer == nullptr)
+		{
+			return;
+		}
+
+		runner.run("lexer/" + input.name, input.name, input.bytes,
+		           [&input, lexer](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           qint64 tokens = 0;
+			           int state = 0;
+			           QVector<syntax::Token> lineTokens;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                QString text = decodeChunk(bytes);
+				                                stopwatch.start();
+				                                forEachLine(text,
+				                                            [&](QStringView line)
+				                                            {
+					                                            lineTokens.clear();
+					                                            state = lexer->tokenize(line, state, lineTokens);
+					                                            tokens += lineTokens.size();
+				                                            });
+				                                stopwatch.stop();
+			                                });
+			           return QVariantMap{ { "tokens", tokens } };
+		           });
+	}
+
+	// Baseline for the lexer: the keyword pass of the old regex highlighter
+	void benchKeywordRegex(BenchRunner& runner, const Corpus& input)
+	{
+		if (input.kind != corpus::Kind::Cpp)
+		{
+			return;
+		}
+
+		runner.run("keywords-regex/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           QList<QRegularExpression> expressions;
+			           for (const QString& keyword : baselineKeywords)
+			           {
+				           expressions.append(QRegularExpression("\\b" + keyword + "\\b"));
+			           }
+
+			           qint64 keywords = 0;
+			           corpus::forEachChunk(input.path, chunkBytes,
+			                                [&](const QByteArray& bytes)
+			                                {
+				                                QString text = decodeChunk(bytes);
+				                                stopwatch.start();
+				                                forEachLine(text,
+				                                            [&](QStringView line)
+				                                            {
+					                                            for (const QRegularExpression& expression : expressions)
+					                                            {
+						                                            QRegularExpressionMatchIterator it = expression.globalMatchView(line);
+						                                            while (it.hasNext())
+						                                            {
+							                                            it.next();
+							                                            ++keywords;
+						                                            }
+					                                            }
+				                                            });
+				                                stopwatch.stop();
+			                                });
+			           return QVariantMap{ { "keywords", keywords } };
+		           });
+	}
+
+	void benchOpen(BenchRunner& runner, const Corpus& input)
+	{
+		runner.run("open/" + input.name, input.name, input.bytes,
+		           [&input](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           FileSearcher searcher;
+			           qint64 chars = 0;
+			           stopwatch.start();
+			           // The same split as MainWindow::onOpenFile(): small files are read at once, large ones are mapped
+			           if (input.bytes < FileSearcher::lazyLoadThreshold)
+			           {
+				           chars = searcher.openFile(input.path).size();
+			           }
+			           else if (searcher.openFileMapped(input.path))
+			           {
+				           while (searcher.hasMoreChunks())
+				           {
+					           chars += searcher.readNextChunk().size();
+				           }
+			           }
+			           stopwatch.stop();
+			           return QVariantMap{ { "chars", chars } };
+		           });
+	}
+
+	void benchDocument(BenchRunner& runner, const Corpus& input, qint64 maxDocument)
+	{
+		QString language = corpus::languageOf(input.kind);
+		QString term = corpus::searchTermOf(input.kind);
+		QStringList names = { "search-document/" + input.name, "search-piecetable/" + input.name, "search-index-build/" + input.name,
+		                      "search-index/" + input.name, "search-parallel/" + input.name, "replace-all/" + input.name };
+		if (!language.isEmpty())
+		{
+			names.prepend("highlight/" + input.name);
+		}
+		if (std::none_of(names.begin(), names.end(), [&runner](const QString& name) { return runner.isSelected(name); }))
+		{
+			return;
+		}
+		if (input.bytes > maxDocument)
+		{
+			for (const QString& name : names)
+			{
+				runner.skip(name, input.name, "larger than --max-document");
+			}
+			return;
+		}
+
+		QFile file(input.path);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			return;
+		}
+		const QString text = decodeChunk(file.readAll());
+		QTextDocument document;
+		document.setPlainText(text);
+
+		if (!language.isEmpty())
+		{
+			runner.run("highlight/" + input.name, input.name, input.bytes,
+			           [&document, &language](BenchRunner::Stopwatch& stopwatch)
+			           {
+				           // A new highlighter each time, so nothing comes from the token cache of the previous run
+				           SyntaxHighlighter highlighter(nullptr);
+				           stopwatch.start();
+				           highlighter.setDocument(&document);
+				           highlighter.setLanguage(language);
+				           QCoreApplication::processEvents();
+				           while (highlighter.isBusy())
+				           {
+					           QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+				           }
+				           stopwatch.stop();
+				           return QVariantMap{ { "blocks", document.blockCount() }, { "cache_hits", highlighter.getTokenCache().hits() } };
+			           });
+		}
+
+		// What MainWindow::updateSearchHighlight() runs for every character typed in the search field
+		runner.run("search-document/" + input.name, input.name, input.bytes,
+		           [&document, &term](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           QRegularExpression re(QRegularExpression::escape(term), QRegularExpression::CaseInsensitiveOption);
+			           qint64 hits = 0;
+			           stopwatch.start();
+			           QTextCursor cursor(&document);
+			           while (true)
+			           {
+				           cursor = document.find(re, cursor);
+				           if (cursor.isNull())
+				           {
+					           break;
+				           }
+				           ++hits;
+			           }
+			           stopwatch.stop();
+			           return QVariantMap{ { "hits", hits } };
+		           });
+
+		runner.run("search-piecetable/" + input.name, input.name, input.bytes,
+		           [&text, &term](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           PieceTable table(text);
+			           stopwatch.start();
+			           qint64 hits = table.count(term, Qt::CaseInsensitive);
+			           stopwatch.stop();
+			           return QVariantMap{ { "hits", hits } };
+		           });
+
+		PieceTable table(text);
+		runner.run("search-index-build/" + input.name, input.name, input.bytes,
+		           [&table](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           SearchIndex index;
+			           stopwatch.start();
+			           index.reset(table);
+			           stopwatch.stop();
+			           return QVariantMap{ { "chars", table.length() } };
+		           });
+
+		// The same query as search-document/, answered from the trigram filters
+		runner.run("search-index/" + input.name, input.name, input.bytes,
+		           [&table, &term](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           SearchIndex index;
+			           index.reset(table);
+			           stopwatch.start();
+			           qint64 hits = index.findAll(table, term).size();
+			           stopwatch.stop();
+			           return QVariantMap{ { "hits", hits } };
+		           });
+
+		// What MainWindow::updateSearchHighlight() runs: the candidate segments verified on the thread pool
+		runner.run("search-parallel/" + input.name, input.name, input.bytes,
+		           [&table, &term](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           SearchIndex index;
+			           index.reset(table);
+			           MatchFinder finder;
+			           qint64 hits = -1;
+			           QObject::connect(&finder, &MatchFinder::found, [&hits](quint64, const QList<qsizetype>& starts) { hits = starts.size(); });
+			           stopwatch.start();
+			           finder.submit(table, term, Qt::CaseInsensitive, index.candidateRanges(term));
+			           while (hits < 0)
+			           {
+				           QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+			           }
+			           stopwatch.stop();
+			           return QVariantMap{ { "hits", hits } };
+		           });
+
+		// What MainWindow::onReplaceAll() runs: every match replaced in place as one edit block
+		runner.run("replace-all/" + input.name, input.name, input.bytes,
+		           [&text, &table, &term](BenchRunner::Stopwatch& stopwatch)
+		           {
+			           QTextDocument target;
+			           target.setPlainText(text);
+			           SearchIndex index;
+			           index.reset(table);
+			           const QList<SearchIndex::Range> matches = index.findAll(table, term, Qt::CaseSensitive);
+			           ReplaceEngine engine;
+			           stopwatch.start();
+			           qint64 replaced = engine.replaceAll(&target, matches, term.toUpper());
+			           stopwatch.stop();
+			           return QVariantMap{ { "replaced", replaced } };
+		           });
+	}
+
+	QString simdName()
+	{
+#if defined(NOTER_SIMD_AVX2)
+		return "avx2";
+#elif defined(NOTER_SIMD_SSE2)
+		return "sse2";
+#else
+		return "none";
+#endif
+	}
+
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+	// Documents and fonts need a GUI application, but no window is ever shown
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+	{
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+	QGuiApplication app(argc, argv);
+	QCoreApplication::setApplicationName("noter_bench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Noter benchmarks over generated corpora");
+	parser.addHelpOption();
+	QCommandLineOption sizesOption("sizes", "Comma-separated corpus sizes, e.g. 1M,100M,1G.", "sizes", "1M");
+	QCommandLineOption filterOption("filter", "Only run benchmarks whose name matches the regular expression.", "regex");
+	QCommandLineOption repetitionsOption("repetitions", "Runs of each benchmark; the median is reported.", "count", "3");
+	QCommandLineOption outOption("out", "Write the JSON report to a file instead of stdout.", "file");
+	QCommandLineOption corpusDirOption("corpus-dir", "Where generated corpora are kept between runs.", "dir", QDir(QDir::tempPath()).filePath("noter-bench"));
+	QCommandLineOption seedOption("seed", "Seed of the corpus generators.", "seed", QString::number(defaultSeed));
+	QCommandLineOption maxDocumentOption("max-document", "Largest corpus loaded into a QTextDocument.", "size", "100M");
+	parser.addOptions({ sizesOption, filterOption, repetitionsOption, outOption, corpusDirOption, seedOption, maxDocumentOption });
+	parser.process(app);
+
+	QTextStream log(stderr);
+	qint64 maxDocument = corpus::parseSize(parser.value(maxDocumentOption));
+	if (maxDocument < 0)
+	{
+		log << "Invalid --max-document size" << Qt::endl;
+		return 1;
+	}
+	quint32 seed = parser.value(seedOption).toUInt();
+	BenchRunner runner(parser.value(repetitionsOption).toInt(), parser.value(filterOption));
+
+	QJsonArray sizes;
+	for (const QString& label : parser.value(sizesOption).split(',', Qt::SkipEmptyParts))
+	{
+		qint64 bytes = corpus::parseSize(label);
+		if (bytes < 0)
+		{
+			log << "Invalid corpus size: " << label << Qt::endl;
+			return 1;
+		}
+		sizes.append(label.trimmed());
+
+		for (corpus::Kind kind : corpus::allKinds())
+		{
+			Corpus input;
+			input.kind = kind;
+			input.name = corpus::kindName(kind) + "-" + label.trimmed();
+			input.path = corpus::ensureFile(parser.value(corpusDirOption), kind, label.trimmed(), bytes, seed);
+			if (input.path.isEmpty())
+			{
+				return 1;
+			}
+			input.bytes = QFileInfo(input.path).size();
+
+			benchDecode(runner, input);
+			benchWords(runner, input);
+			benchLexer(runner, input);
+			benchKeywordRegex(runner, input);
+			benchOpen(runner, input);
+			benchDocument(runner, input, maxDocument);
+		}
+	}
+
+	QJsonObject context;
+	context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+	context["host_name"] = QSysInfo::machineHostName();
+	context["executable"] = QCoreApplication::applicationFilePath();
+	context["num_cpus"] = QThread::idealThreadCount();
+	context["os"] = QSysInfo::prettyProductName();
+	context["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+	context["qt_version"] = qVersion();
+	context["library_build_type"] = NOTER_BENCH_BUILD_TYPE;
+	context["simd"] = simdName();
+	context["seed"] = qint64(seed);
+	context["sizes"] = sizes;
+
+	QByteArray json = QJsonDocument(runner.report(context)).toJson();
+	if (parser.isSet(outOption))
+	{
+		QFile out(parser.value(outOption));
+		if (!out.open(QIODeviceBase::WriteOnly) || out.write(json) != json.size())
+		{
+			log << "Failed to write " << out.fileName() << ": " << out.errorString() << Qt::endl;
+			return 1;
+		}
+		return 0;
+	}
+	QTextStream(stdout) << json;
+	return 0;
+}
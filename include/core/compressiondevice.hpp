@@ -0,0 +1,64 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QIODevice>
+#include <QString>
+#include <memory>
+
+struct z_stream_s;
+
+namespace compression
+{
+	enum class Format
+	{
+		None,
+		Gzip,
+		Zlib
+	};
+
+	// Recognizes gzip and zlib streams by their magic bytes
+	Format detectFormat(QByteArrayView header);
+	Format detectFile(const QString& filePath);
+
+	// Reads a whole file, decompressing it if needed
+	bool readFile(const QString& filePath, QByteArray& bytes);
+
+	QString formatName(Format format);
+
+}; // namespace compression
+
+// Sequential QIODevice that inflates data read from another device, or deflates data written to it.
+// Both directions go through fixed-size buffers, so compressed files of any size are streamed.
+// Reading accepts gzip and zlib alike and continues across concatenated gzip members.
+class CompressionDevice : public QIODevice
+{
+	Q_OBJECT
+
+  private:
+	QIODevice* device;
+	compression::Format format;
+	std::unique_ptr<z_stream_s> stream;
+	QByteArray buffer;
+	bool streamEnd;
+	bool finished;
+
+	bool writeOutput(qsizetype length);
+
+  protected:
+	qint64 readData(char* data, qint64 maxSize) override;
+	qint64 writeData(const char* data, qint64 maxSize) override;
+
+  public:
+	static constexpr qsizetype bufferSize = 64 * 1024;
+
+	// The underlying device must already be open; format only matters for writing
+	explicit CompressionDevice(QIODevice* device, compression::Format format = compression::Format::Gzip, QObject* parent = nullptr);
+	~CompressionDevice();
+
+	bool open(OpenMode mode) override;
+	void close() override;
+	bool isSequential() const override;
+
+	// Writes the end of the compressed stream; close() does it too, but cannot report failure
+	bool finish();
+};
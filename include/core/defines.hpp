@@ -3,6 +3,6 @@
 
 namespace defines
 {
-	QString projectName = "Noter";
+	inline QString projectName = "Noter";
 
 }; // namespace defines
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <QList>
+#include <QString>
+
+// Undo history of the edits made in the editor, kept apart from QTextDocument's own.
+// Text appended from the file (chunks of a mapped file, follow mode) is never recorded, so
+// it can arrive at any time without clearing the user's steps or joining one of them: the
+// steps only cover text before it. Runs of single-character typing or deleting merge into
+// one step, as they do in QTextDocument.
+class EditHistory
+{
+  public:
+	// Replace length characters at position with text
+	struct Change
+	{
+		qsizetype position;
+		qsizetype length;
+		QString text;
+	};
+
+  private:
+	struct Step
+	{
+		qsizetype position;
+		QString removed;
+		QString inserted;
+	};
+
+	QList<Step> steps;
+	qsizetype current; // steps before this one are done, the ones from it on can be redone
+	bool open;         // the latest step may still take the next keystroke
+
+	bool merge(qsizetype position, const QString& removed, const QString& inserted);
+
+  public:
+	EditHistory();
+
+	void clear();
+	// Records an edit that replaced removed by inserted at position, dropping the steps that could be redone
+	void record(qsizetype position, const QString& removed, const QString& inserted);
+	// The next edit starts a step of its own
+	void closeStep();
+
+	bool canUndo() const;
+	bool canRedo() const;
+	// The change that reverts the latest step, or reapplies the next one; it is applied by the caller
+	// and must not be recorded again
+	Change undo();
+	Change redo();
+};
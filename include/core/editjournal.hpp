@@ -0,0 +1,77 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QLockFile>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include "core/piecetable.hpp"
+#include <memory>
+
+// Append-only journal of edit operations kept next to the edited file.
+// Each keystroke costs a few bytes; once the journal grows past compactionThreshold the
+// current text is written to a snapshot and the journal starts over from it. Journals
+// left behind by a crash are listed by pendingRecoveries() and replayed with recover().
+// An open journal holds a lock file, so journals of running instances are never taken for crash leftovers.
+// A journal based on the file on disk records the file's size, modification time and checksum; once
+// the file has changed, the journal no longer applies to it and is not replayed.
+class EditJournal
+{
+  private:
+	enum class Base : quint8
+	{
+		Empty,
+		File,
+		Snapshot
+	};
+
+	QString filePath;
+	QFile journalFile;
+	std::unique_ptr<QLockFile> ownerLock;
+	QByteArray pending;
+	quint64 revisionCounter;
+	quint32 generation; // bumped by every compaction, ties the journal to its snapshot
+
+	bool start(Base base);
+	void appendRecord(quint8 op, qsizetype pos, qsizetype count, QStringView text);
+
+	static void registerRecovery(const QString& filePath, bool active);
+
+  public:
+	static constexpr qint64 compactionThreshold = 16 * 1024 * 1024;
+
+	EditJournal();
+	~EditJournal();
+
+	EditJournal(const EditJournal&) = delete;
+	EditJournal& operator=(const EditJournal&) = delete;
+
+	static QString journalPathFor(const QString& filePath);
+	static QString snapshotPathFor(const QString& filePath);
+
+	static QStringList pendingRecoveries();
+	// Fails if the journal is unreadable or its base file was changed since; a damaged tail is left out
+	static bool recover(const QString& filePath, QString& text);
+	static void discardRecovery(const QString& filePath);
+	// Renames a journal that could not be replayed so no new journal overwrites it; returns its new path
+	static QString setAsideRecovery(const QString& filePath);
+
+	// Starts a fresh journal whose base is the file as it is on disk (an empty document if it does not exist).
+	// Fails if another running instance journals the same file
+	bool open(const QString& filePath);
+	// Removes the journal and its snapshot; used once the edits are no longer needed
+	void close();
+
+	bool isOpen() const;
+	QString getFilePath() const;
+
+	void recordInsert(qsizetype pos, QStringView text);
+	void recordRemove(qsizetype pos, qsizetype count);
+	bool flush();
+
+	qint64 size() const;
+	// Increases with every recorded edit and is never reset
+	quint64 revision() const;
+
+	bool compact(const PieceTable& text);
+};
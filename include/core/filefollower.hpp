@@ -0,0 +1,43 @@
+#pragma once
+#include <QFileSystemWatcher>
+#include <QDateTime>
+#include <QObject>
+#include <QString>
+#include "core/textcodec.hpp"
+
+// Follows a growing file (tail -f) by remembering how many bytes have already been shown.
+// When the file changes only the bytes past that offset are read, and only complete lines are
+// passed on; a partial last line waits for the writer to finish it. A file that shrinks or is
+// replaced (log rotation) is read again from the start after reset() is emitted.
+class FileFollower : public QObject
+{
+	Q_OBJECT
+
+  private:
+	QFileSystemWatcher watcher;
+	QString filePath;
+	qint64 offset;
+	textcodec::Detection encoding;
+	QDateTime birthTime;
+
+	void readAppended();
+	void restart();
+
+  private slots:
+	void onFileChanged(const QString& path);
+	void onDirectoryChanged(const QString& path);
+
+  public:
+	explicit FileFollower(QObject* parent = nullptr);
+
+	// offset is the number of bytes of the file that are already in the document
+	bool follow(const QString& filePath, qint64 offset, const textcodec::Detection& encoding);
+	void stop();
+
+	bool isFollowing() const;
+	QString getFilePath() const;
+
+  signals:
+	void appended(const QString& text);
+	void reset();
+};
@@ -1,8 +1,15 @@
 #pragma once
 #include <QObject>
 #include <QString>
+#include <QThread>
 
 #include <QFileDialog>
+#include "core/compressiondevice.hpp"
+#include "core/loadworker.hpp"
+#include "core/mappedfile.hpp"
+#include "core/piecetable.hpp"
+#include "core/saveworker.hpp"
+#include "core/textcodec.hpp"
 
 class FileSearcher : public QObject
 {
@@ -11,19 +18,57 @@ class FileSearcher : public QObject
   private:
 	QString workingDir;
 	QString filePath;
+	MappedFile mappedFile;
+	textcodec::Detection encoding;
+	compression::Format compression;
+	qint64 loadedBytes;
+	qint64 asyncLoadedBytes; // bytes read by the running load, committed once it succeeds
+	QThread saveThread;
+	SaveWorker* saveWorker;
+	QThread loadThread;
+	LoadWorker* loadWorker;
+	quint64 activeLoad;
 
 	bool removeAppDir();
 
+  private slots:
+	void onSaveFinished(bool success, const QString& filePath, const QString& error);
+	void onChunkLoaded(quint64 request, const QString& text, qint64 bytesRead, qint64 totalBytes);
+	void onLoadFinished(quint64 request, bool success, const QString& filePath, const QString& error, const textcodec::Detection& encoding);
+
   public:
+	// Files at least this large are memory-mapped and loaded chunk by chunk
+	static constexpr qint64 lazyLoadThreshold = 64 * 1024 * 1024;
+
 	explicit FileSearcher(QObject* parent = nullptr);
-	~FileSearcher() = default;
+	~FileSearcher();
 
   public slots:
-	bool saveFile(const QString& text);
-	bool saveFileAs(const QString& newFilePath, const QString& text);
+	bool saveFile(const PieceTable& text);
+	bool saveFileAs(const QString& newFilePath, const PieceTable& text);
 	QString openFile(const QString& filePath);
+	bool openFileMapped(const QString& filePath);
+	// Reads the file on the load thread; its text arrives through chunkLoaded() and ends with loadFinished().
+	// The current file, its mapping and encoding are only replaced once the load succeeds
+	void openFileAsync(const QString& filePath);
+	void cancelLoad();
+	bool isLoading() const;
+	QString readNextChunk();
+	bool hasMoreChunks() const;
+	void closeMappedFile();
 	void setFilePath(const QString& path);
 	QString getFilePath() const;
+	textcodec::Detection getEncoding() const;
+	// Size of the file as it was last read or written, including its BOM
+	qint64 getLoadedBytes() const;
+	void resetEncoding();
+	// Compression of the opened file, kept on save; names ending in .gz are always saved compressed
+	compression::Format getCompression() const;
 
   signals:
+	void saveProgress(qint64 written, qint64 total);
+	// Emitted exactly once for every saveFile() call
+	void saveFinished(bool success, const QString& filePath, const QString& error);
+	void chunkLoaded(const QString& text, qint64 bytesRead, qint64 totalBytes);
+	void loadFinished(bool success, const QString& filePath, const QString& error);
 };
@@ -0,0 +1,73 @@
+#pragma once
+#include <QVector>
+#include <memory>
+
+// Bracket outside of strings and comments, by its offset in the block
+struct Bracket
+{
+	int position;
+	char16_t ch;
+
+	bool isOpen() const { return ch == u'(' || ch == u'[' || ch == u'{'; }
+};
+
+// Bracket depth of one block relative to its start: the net change, and the lowest depth
+// at the block start or after any of its brackets (so never above 0)
+struct BracketSummary
+{
+	int delta = 0;
+	int minDepth = 0;
+};
+
+// Bracket summaries of all blocks of a document in an implicit treap ordered by block number.
+// Every node also sums up its subtree, so the depth at a block and the next or previous
+// block where the depth falls to a given level are found in O(log n). Matching brackets and
+// fold regions (a block's outermost unclosed bracket up to the block that closes it) are
+// looked up through it instead of scanning the document.
+class FoldIndex
+{
+  private:
+	struct Node
+	{
+		BracketSummary summary;
+		quint32 priority;
+		int count;    // blocks in the subtree
+		int delta;    // net depth change of the subtree
+		int minDepth; // lowest depth reached in the subtree, relative to its start
+		std::unique_ptr<Node> left;
+		std::unique_ptr<Node> right;
+	};
+	using NodePtr = std::unique_ptr<Node>;
+
+	NodePtr root;
+	quint32 seed;
+
+	static int countOf(const NodePtr& node);
+	static void update(Node* node);
+	static NodePtr merge(NodePtr left, NodePtr right);
+	static void split(NodePtr node, int index, NodePtr& left, NodePtr& right);
+	static void assign(Node* node, int index, const BracketSummary& summary);
+	static int findForward(const Node* node, int firstIndex, int startDepth, int after, int depth);
+	static int findBackward(const Node* node, int firstIndex, int startDepth, int before, int depth);
+
+	quint32 nextPriority();
+	NodePtr build(const QVector<BracketSummary>& summaries);
+
+  public:
+	FoldIndex();
+
+	void reset(const QVector<BracketSummary>& summaries);
+	int size() const;
+
+	// Inserts count blocks without brackets before index
+	void insert(int index, int count);
+	void remove(int index, int count);
+	void set(int index, const BracketSummary& summary);
+
+	// Depth at the start of the block
+	int depthAt(int index) const;
+	// First block after the given one in which the depth falls to depth or below; -1 if there is none
+	int findForward(int after, int depth) const;
+	// Last block before the given one whose depth at its start or after one of its brackets is depth or below
+	int findBackward(int before, int depth) const;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+// Set of keywords looked up through a perfect hash: the seed is chosen when the
+// matcher is built so that every keyword gets its own slot, and a lookup is one hash
+// of the word plus at most one comparison.
+class KeywordMatcher
+{
+  private:
+	QList<QString> table;
+	quint32 seed;
+	quint32 mask;
+	qsizetype minLength;
+	qsizetype maxLength;
+
+	quint32 slotFor(QStringView word, quint32 seed) const;
+
+  public:
+	KeywordMatcher();
+	explicit KeywordMatcher(const QStringList& keywords);
+
+	bool contains(QStringView word) const;
+	bool isEmpty() const;
+
+	// Calls visitor(start, length) for every keyword in text that is a whole \w+ run
+	template <typename Visitor>
+	void forEachKeyword(QStringView text, Visitor&& visitor) const;
+
+	static bool isWordChar(QChar c);
+};
+
+inline bool KeywordMatcher::isWordChar(QChar c)
+{
+	// Same class as \w in QRegularExpression without Unicode properties
+	char16_t u = c.unicode();
+	return (u >= u'a' && u <= u'z') || (u >= u'A' && u <= u'Z') || (u >= u'0' && u <= u'9') || u == u'_';
+}
+
+template <typename Visitor>
+void KeywordMatcher::forEachKeyword(QStringView text, Visitor&& visitor) const
+{
+	if (isEmpty())
+	{
+		return;
+	}
+
+	const qsizetype length = text.size();
+	qsizetype i = 0;
+	while (i < length)
+	{
+		if (!isWordChar(text[i]))
+		{
+			++i;
+			continue;
+		}
+
+		qsizetype start = i;
+		while (i < length && isWordChar(text[i]))
+		{
+			++i;
+		}
+		if (contains(text.sliced(start, i - start)))
+		{
+			visitor(start, i - start);
+		}
+	}
+}
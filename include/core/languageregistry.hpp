@@ -0,0 +1,78 @@
+#pragma once
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "core/keywordmatcher.hpp"
+#include "core/lexer.hpp"
+
+namespace syntax
+{
+	struct HighlightingRule
+	{
+		QRegularExpression pattern;
+		Style style;
+	};
+
+	// Regular expression rules of a language without a lexer.
+	// Built once with every pattern compiled and optimized; never modified afterwards, so
+	// highlighters (and their worker threads) share it.
+	struct RuleSet
+	{
+		KeywordMatcher keywords;
+		QVector<HighlightingRule> rules;
+		QRegularExpression commentStart;
+		QRegularExpression commentEnd;
+	};
+
+	struct LanguageDefinition
+	{
+		QString name;
+		QStringList aliases;
+		QStringList extensions; // with the dot: ".cpp"
+		const Lexer* lexer = nullptr;
+		std::shared_ptr<const RuleSet> rules;
+	};
+
+}; // namespace syntax
+
+// Process-wide list of the languages the highlighter knows.
+// The built-in languages are registered with their lexers; more are read from JSON
+// data files at startup (see loadFile() for the format). A definition is never changed
+// or removed once registered, a later one with the same name takes precedence, so the
+// pointers handed out stay valid and switching languages is a pointer swap.
+// Loading is meant to happen on the GUI thread before the first lookup.
+class LanguageRegistry
+{
+  private:
+	QList<std::shared_ptr<const syntax::LanguageDefinition>> languages;
+
+	LanguageRegistry();
+	void add(syntax::LanguageDefinition definition);
+
+  public:
+	static LanguageRegistry& instance();
+
+	LanguageRegistry(const LanguageRegistry&) = delete;
+	LanguageRegistry& operator=(const LanguageRegistry&) = delete;
+
+	// Directories searched by loadDataFiles(): "languages" next to the executable and in the app data locations
+	static QStringList searchPaths();
+	// Loads the *.json files of every search path; returns the number of languages added
+	int loadDataFiles();
+	int loadDirectory(const QString& path);
+	// {
+	//   "name": "sql", "aliases": [], "extensions": [".sql"],
+	//   "keywords": ["select", "from"],
+	//   "rules": [{ "pattern": "--[^\\n]*", "style": "comment" }],
+	//   "commentStart": "/\\*", "commentEnd": "\\*/"
+	// }
+	// Styles: keyword, type, function, string, comment, number, tag, entity
+	bool loadFile(const QString& path);
+
+	// Looks up a name or an alias; nullptr if unknown
+	const syntax::LanguageDefinition* find(const QString& name) const;
+	const syntax::LanguageDefinition* forFileName(const QString& fileName) const;
+};
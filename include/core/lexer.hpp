@@ -0,0 +1,175 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+#include <array>
+#include "core/keywordmatcher.hpp"
+
+namespace syntax
+{
+	enum class Style : quint8
+	{
+		Normal,
+		Keyword,
+		Type,
+		Function,
+		String,
+		Comment,
+		Number,
+		Tag,
+		Entity
+	};
+	constexpr int styleCount = 9;
+
+	// Block state word: the DFA state in the low byte, a nesting depth in the next one and a
+	// 15-bit payload above them, so the word is never negative. The depth counts nested block comments, or the open
+	// braces inside template literal interpolations, whose kinds the payload keeps as a bit
+	// stack; for raw strings the payload is the interned terminator.
+	struct LexState
+	{
+		quint8 dfa = 0;
+		quint8 depth = 0;
+		quint16 payload = 0;
+
+		static LexState unpack(int state)
+		{
+			quint32 word = state < 0 ? 0 : quint32(state);
+			return { quint8(word), quint8(word >> 8), quint16(word >> 16) };
+		}
+
+		int pack() const { return int(dfa | (quint32(depth) << 8) | (quint32(payload) << 16)); }
+	};
+
+	struct Token
+	{
+		int start;
+		int length;
+		Style style;
+	};
+
+	// Classes of characters the lexer tables are indexed by; everything past ASCII is NonAscii
+	enum CharClass : quint8
+	{
+		Other,
+		Space,
+		Letter, // [A-Za-z_], the \w class together with Digit
+		Digit,
+		Dot,
+		DoubleQuote,
+		SingleQuote,
+		Backtick,
+		Slash,
+		Star,
+		Hash,
+		Backslash,
+		Less,
+		Greater,
+		Bang,
+		Dash,
+		Amp,
+		Semicolon,
+		Equals,
+		Dollar,
+		LeftBrace,
+		RightBrace,
+		NonAscii,
+		CharClassCount
+	};
+
+}; // namespace syntax
+
+// Table-driven DFA lexer.
+// A block is split into tokens in one left-to-right pass: from a start state the
+// automaton runs as far as it has transitions and the longest accepted prefix becomes
+// the token (maximal munch). States that can continue on the next line (block comments,
+// triple-quoted strings, open tags) are carried over as the block state, together with
+// the nesting depth and raw string delimiter (see syntax::LexState), so that a block's end
+// state only changes when the following blocks really lex differently. Identifiers are
+// classified after the scan with a keyword hash and a few per-language rules.
+class Lexer
+{
+  public:
+	enum StateFlag : quint8
+	{
+		Accepting = 1,
+		Identifier = 2,
+		Whitespace = 4,
+		PushDepth = 8,           // entering the state opens a nested comment
+		PopDepth = 16,           // accepting the state closes one; while nested the scan goes on in its carry state
+		OpenBrace = 32,          // '{' inside an interpolation
+		CloseBrace = 64,         // '}' closing a brace or an interpolation; the latter goes back to the carry state
+		OpenInterpolation = 128  // "${" in a template literal
+	};
+
+	enum class TypeRule : quint8
+	{
+		None,
+		QPrefix,    // Qt classes: Q followed by letters
+		Capitalized // Java style: any identifier starting with an upper-case letter
+	};
+
+	enum class RawStrings : quint8
+	{
+		None,
+		Cpp, // R"delimiter( ... )delimiter", also with L, u, U and u8 prefixes
+		Rust // r"...", r#"..."#, br##"..."##
+	};
+
+	static constexpr quint8 reject = 0xFF;
+	static constexpr quint8 noCarry = 0xFF;
+
+  private:
+	struct State
+	{
+		syntax::Style style;
+		quint8 flags;
+		quint8 after; // state the next token starts from
+		quint8 carry; // state the next block starts from when the block ends here
+	};
+
+	QString name;
+	QVector<State> states;
+	QVector<quint8> transitions; // states.size() rows of CharClassCount entries
+	KeywordMatcher keywords;
+	QString definer;
+	TypeRule typeRule;
+	bool callsAreFunctions;
+	RawStrings rawStrings;
+	quint8 rawStringState;
+
+	syntax::Style classifyIdentifier(QStringView text, qsizetype start, qsizetype end, bool& expectFunctionName) const;
+	// Checks whether the identifier text[start, end) opens a raw string; returns the index its contents start at
+	qsizetype openRawString(QStringView text, qsizetype start, qsizetype end, QString& terminator) const;
+	// Finds the end of a raw string whose terminator was not remembered: the first text that closes some raw string
+	qsizetype findRawStringEnd(QStringView text, qsizetype from, qsizetype& length) const;
+
+  public:
+	explicit Lexer(const QString& name);
+
+	// Built-in lexers: "cpp", "python", "java", "javascript", "html", "rust"; nullptr for anything else
+	static const Lexer* forLanguage(const QString& language);
+
+	static syntax::CharClass classOf(QChar c);
+
+	QString getName() const;
+
+	// Returns the state of the block's end, to be passed in for the next block
+	int tokenize(QStringView text, int state, QVector<syntax::Token>& tokens) const;
+
+	// Table construction
+	quint8 addState(syntax::Style style, quint8 flags, quint8 after = 0);
+	void setCarry(quint8 state, quint8 carry);
+	void on(quint8 from, syntax::CharClass cls, quint8 to);
+	void onAny(quint8 from, quint8 to);
+	// Every class that has no transition yet
+	void onOther(quint8 from, quint8 to);
+	void copyTransitions(quint8 to, quint8 from);
+	void setKeywords(const QStringList& keywords);
+	// The identifier following this keyword is highlighted as a function name ("def", "function")
+	void setDefiner(const QString& keyword);
+	void setTypeRule(TypeRule rule);
+	// Identifiers directly followed by '(' are highlighted as functions
+	void setCallsAreFunctions(bool enabled);
+	void setRawStrings(RawStrings syntax);
+};
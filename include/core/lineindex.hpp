@@ -0,0 +1,51 @@
+#pragma once
+#include <QList>
+#include <QStringView>
+#include "core/piecetable.hpp"
+
+// Offsets of the first character of every line, kept alongside the text so that
+// line -> offset is a short lookup and the line count never needs the layout engine.
+// Newlines are found with a vectorized scan. The offsets are stored in chunks of about
+// chunkSize lines, each relative to the start of its chunk, so an edit only rewrites the
+// chunk it lands in. The shift of the chunks after it is stored as one pending delta and
+// only written out over the chunks between two consecutive edit positions, so typing in
+// one place costs O(chunkSize) per keystroke however long the document is.
+class LineIndex
+{
+  private:
+	struct Chunk
+	{
+		qsizetype firstLine;
+		qsizetype base;          // offset of firstLine
+		QList<qsizetype> starts; // relative to base, the first one is 0
+	};
+
+	QList<Chunk> chunks;      // never empty; chunks from pendingChunk on are missing the pending deltas
+	qsizetype pendingChunk;
+	qsizetype pendingDelta;
+	qsizetype pendingLines;
+
+	qsizetype chunkFirstLine(qsizetype chunk) const;
+	qsizetype chunkBase(qsizetype chunk) const;
+	qsizetype chunkOfLine(qsizetype line) const;
+	void movePending(qsizetype chunk);
+	void splitChunk(qsizetype chunk);
+	qsizetype firstLineAfter(qsizetype pos) const;
+
+  public:
+	static constexpr qsizetype chunkSize = 1024;
+
+	LineIndex();
+
+	void reset(const PieceTable& text);
+	void replace(qsizetype pos, qsizetype removed, QStringView inserted);
+
+	qsizetype lineCount() const;
+	// Offset of the first character of line (0-based)
+	qsizetype lineStart(qsizetype line) const;
+	// Line (0-based) containing the character at pos
+	qsizetype lineAt(qsizetype pos) const;
+
+	// Appends pos of every '\n' in text, offset by base
+	static void findNewlines(QStringView text, qsizetype base, QList<qsizetype>& positions);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include "core/textcodec.hpp"
+
+// Reads and decodes files on a background thread.
+// The file is split into line-aligned chunks that are sent to the GUI thread one by one,
+// so the document can be filled in gradually while the window stays responsive.
+// Compressed files are inflated on the fly and split the same way, except that a line
+// longer than a chunk is cut inside, on a character boundary, so memory stays bounded.
+// Every load is tagged with a request number; cancel() makes the running load stop
+// after its current chunk, and receivers drop anything still queued for an old request.
+class LoadWorker : public QObject
+{
+	Q_OBJECT
+
+  private:
+	std::atomic<quint64> activeRequest;
+
+	void loadCompressed(quint64 request, const QString& filePath);
+
+  public:
+	static constexpr qint64 chunkSize = 1024 * 1024;
+
+	explicit LoadWorker(QObject* parent = nullptr);
+
+	// Both are safe to call from any thread
+	quint64 nextRequest();
+	void cancel();
+
+  public slots:
+	void load(quint64 request, const QString& filePath);
+
+  signals:
+	void chunkLoaded(quint64 request, const QString& text, qint64 bytesRead, qint64 totalBytes);
+	void finished(quint64 request, bool success, const QString& filePath, const QString& error, const textcodec::Detection& encoding);
+};
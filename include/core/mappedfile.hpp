@@ -0,0 +1,42 @@
+#pragma once
+#include <QFile>
+#include <QString>
+#include "core/textcodec.hpp"
+
+// Read-only memory mapping of a file that is decoded chunk by chunk.
+// The encoding is detected from the start of the file when it is opened.
+// Chunks always end on a line boundary, so each one can be appended to the
+// document as-is while the rest of the file stays untouched in the page cache.
+class MappedFile
+{
+  private:
+	QFile file;
+	const uchar* data;
+	qint64 fileSize;
+	qint64 readOffset;
+	qint64 chunkSize;
+	textcodec::Detection detection;
+
+	qint64 findChunkEnd(qint64 from) const;
+	qint64 findUtf16ChunkEnd(qint64 from, qint64 end) const;
+
+  public:
+	static constexpr qint64 defaultChunkSize = 4 * 1024 * 1024;
+
+	explicit MappedFile(qint64 chunkSize = defaultChunkSize);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const QString& filePath);
+	void close();
+
+	bool isOpen() const;
+	bool atEnd() const;
+	qint64 size() const;
+	qint64 offset() const;
+	textcodec::Detection encoding() const;
+
+	QString readChunk();
+};
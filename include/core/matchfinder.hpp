@@ -0,0 +1,37 @@
+#pragma once
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+#include "core/piecetable.hpp"
+#include "core/searchindex.hpp"
+
+// Finds every match of a query on worker threads.
+// A search is a snapshot of the text and the ranges worth verifying, cut into batches of
+// about batchChars that are searched in parallel. The hits come back on the owner's thread
+// as one sorted list of match starts. Submitting a search cancels the one before it.
+class MatchFinder : public QObject
+{
+	Q_OBJECT
+
+  public:
+	static constexpr qsizetype batchChars = 1024 * 1024;
+
+	explicit MatchFinder(QObject* parent = nullptr);
+	~MatchFinder();
+
+	// Returns the id the results are reported with
+	quint64 submit(const PieceTable& text, const QString& needle, Qt::CaseSensitivity cs, const QList<SearchIndex::Range>& ranges);
+	// The running search stops early and is never reported
+	void cancel();
+
+  signals:
+	// Delivered on the thread that owns the finder; matches do not overlap
+	void found(quint64 search, const QList<qsizetype>& starts);
+
+  private:
+	QThreadPool pool;
+	std::atomic<quint64> activeSearch;
+	quint64 searchCounter;
+};
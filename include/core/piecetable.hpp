@@ -0,0 +1,114 @@
+#pragma once
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <algorithm>
+#include <memory>
+
+// Text buffer made of pieces of an immutable original buffer and append-only add buffers.
+// Pieces are kept in a persistent treap ordered by position, so insert, remove and slice
+// are O(log n) and copying a PieceTable is an O(1) snapshot that stays valid (and readable
+// from another thread) while the original keeps being edited.
+class PieceTable
+{
+  private:
+	struct Piece
+	{
+		int buffer;
+		qsizetype start;
+		qsizetype length;
+	};
+
+	struct Node;
+	using NodePtr = std::shared_ptr<const Node>;
+
+	struct Node
+	{
+		Piece piece;
+		quint32 priority;
+		qsizetype totalLength;
+		NodePtr left;
+		NodePtr right;
+	};
+
+	static constexpr qsizetype addBlockSize = 64 * 1024;
+
+	QVector<QString> buffers; // [0] is the original buffer, the rest are add blocks
+	NodePtr root;
+	quint32 seed;
+
+	static qsizetype lengthOf(const NodePtr& node);
+	static NodePtr makeNode(const Piece& piece, quint32 priority, const NodePtr& left, const NodePtr& right);
+	static NodePtr merge(const NodePtr& left, const NodePtr& right);
+	static void split(const NodePtr& node, qsizetype pos, NodePtr& left, NodePtr& right);
+	static NodePtr extendLast(const NodePtr& node, qsizetype extra);
+	static const Piece* lastPiece(const NodePtr& node);
+
+	quint32 nextPriority();
+	Piece appendToAddBuffer(QStringView text);
+
+	template <typename Visitor>
+	bool visit(const Node* node, qsizetype base, qsizetype from, qsizetype to, Visitor& visitor) const
+	{
+		if (node == nullptr)
+		{
+			return true;
+		}
+
+		qsizetype pieceStart = base + lengthOf(node->left);
+		qsizetype pieceEnd = pieceStart + node->piece.length;
+
+		if (from < pieceStart && !visit(node->left.get(), base, from, to, visitor))
+		{
+			return false;
+		}
+		if (from < pieceEnd && to > pieceStart)
+		{
+			qsizetype begin = std::max(from, pieceStart);
+			qsizetype end = std::min(to, pieceEnd);
+			QStringView text(buffers[node->piece.buffer]);
+			if (!visitor(text.sliced(node->piece.start + (begin - pieceStart), end - begin)))
+			{
+				return false;
+			}
+		}
+		if (to > pieceEnd)
+		{
+			return visit(node->right.get(), pieceEnd, from, to, visitor);
+		}
+		return true;
+	}
+
+  public:
+	PieceTable();
+	explicit PieceTable(const QString& original);
+
+	void reset(const QString& original = QString());
+
+	qsizetype length() const;
+	bool isEmpty() const;
+
+	void insert(qsizetype pos, QStringView text);
+	void remove(qsizetype pos, qsizetype count);
+
+	QChar at(qsizetype pos) const;
+	QString slice(qsizetype pos, qsizetype count) const;
+	QString toString() const;
+
+	qsizetype indexOf(QStringView needle, qsizetype from = 0, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+	qsizetype count(QStringView needle, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+
+	// Calls visitor(QStringView) for each stored run in document order without copying.
+	// The visitor returns false to stop early; the result tells whether the walk completed.
+	template <typename Visitor>
+	bool forEachChunk(qsizetype pos, qsizetype count, Visitor&& visitor) const
+	{
+		return visit(root.get(), 0, pos, pos + count, visitor);
+	}
+
+	template <typename Visitor>
+	bool forEachChunk(Visitor&& visitor) const
+	{
+		return visit(root.get(), 0, 0, length(), visitor);
+	}
+};
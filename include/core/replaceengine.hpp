@@ -0,0 +1,28 @@
+#pragma once
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTextDocument>
+#include "core/searchindex.hpp"
+
+// Replaces ranges of a document in place.
+// All edits go through one cursor inside a single edit block, back to front so the ranges
+// still to be replaced keep their positions. The block is one undo step, and the document
+// lays itself out and reports contentsChange once, for the span of all the edits.
+class ReplaceEngine : public QObject
+{
+	Q_OBJECT
+
+  public:
+	// Progress is reported after every this many replacements
+	static constexpr qsizetype progressStep = 16 * 1024;
+
+	explicit ReplaceEngine(QObject* parent = nullptr);
+
+	// Ranges must be sorted and must not overlap; returns how many were replaced
+	qsizetype replaceAll(QTextDocument* document, const QList<SearchIndex::Range>& ranges, const QString& replacement);
+
+  signals:
+	// Emitted while replaceAll() runs, before the document has been laid out again
+	void progress(qsizetype done, qsizetype total);
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include "core/compressiondevice.hpp"
+#include "core/piecetable.hpp"
+#include "core/textcodec.hpp"
+
+// Writes document snapshots on a background thread.
+// Output goes through QSaveFile: a temporary file that is flushed to disk and then
+// atomically renamed over the target, so a crash mid-write never truncates the original.
+class SaveWorker : public QObject
+{
+	Q_OBJECT
+
+  public:
+	explicit SaveWorker(QObject* parent = nullptr);
+
+  public slots:
+	void save(const QString& filePath, const PieceTable& text, const textcodec::Detection& encoding, compression::Format compression);
+
+  signals:
+	void progress(qint64 written, qint64 total);
+	void finished(bool success, const QString& filePath, const QString& error);
+};
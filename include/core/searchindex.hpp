@@ -0,0 +1,68 @@
+#pragma once
+#include <QList>
+#include <QStringView>
+#include <array>
+#include <memory>
+#include <vector>
+#include "core/piecetable.hpp"
+
+// Trigram filter of a document for find-as-you-type. The text is cut into segments of whole
+// lines, about segmentChars long, each with a Bloom filter of the case-folded trigrams on its
+// lines. A query only verifies the segments whose filter holds every trigram of the query,
+// so on a large document most of the text is never looked at. Edits rebuild the segments they
+// touch; the shift of the segments after them is kept as one pending delta, as in LineIndex.
+// Queries with a newline or shorter than three characters cannot be filtered and fall back to
+// a scan of the whole text.
+class SearchIndex
+{
+  public:
+	struct Range
+	{
+		qsizetype start;
+		qsizetype length;
+	};
+
+	static constexpr qsizetype segmentChars = 16 * 1024;
+	static constexpr int filterBits = 16 * 1024;
+
+  private:
+	using Filter = std::array<quint64, filterBits / 64>;
+
+	bool enabled;
+	qsizetype textLength;
+	QList<qsizetype> segmentStarts; // entries from pendingIndex on are missing pendingDelta
+	std::vector<std::unique_ptr<Filter>> filters;
+	qsizetype pendingIndex;
+	qsizetype pendingDelta;
+
+	void movePending(qsizetype index);
+	qsizetype segmentStart(qsizetype index) const;
+	qsizetype segmentEnd(qsizetype index) const;
+	qsizetype segmentAt(qsizetype pos) const;
+	// Appends the segments of text[from, to), which starts a line and ends one or the text
+	void build(const PieceTable& text, qsizetype from, qsizetype to, QList<qsizetype>& starts, std::vector<std::unique_ptr<Filter>>& built) const;
+	// False if the filters cannot tell where needle is, so the whole text has to be searched
+	bool queryBits(QStringView needle, QList<int>& bits) const;
+	bool mayContain(qsizetype index, const QList<int>& bits) const;
+	// Segments that may hold a match, in document order
+	QList<Range> candidates(const QList<int>& bits) const;
+
+	static void addBits(QStringView literal, QList<int>& bits);
+
+  public:
+	SearchIndex();
+
+	// A disabled index keeps no filters, every literal query scans the whole text
+	void setEnabled(bool enabled, const PieceTable& text);
+	bool isEnabled() const;
+
+	void reset(const PieceTable& text);
+	// Must be called after the edit is applied to text
+	void replace(const PieceTable& text, qsizetype pos, qsizetype removed, qsizetype added);
+
+	// First match at or after from, wrapping around to the start; start is -1 if there is none
+	Range findNext(const PieceTable& text, QStringView needle, qsizetype from, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
+	QList<Range> findAll(const PieceTable& text, QStringView needle, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
+	// Ranges of the text every match of needle lies in, in document order
+	QList<Range> candidateRanges(QStringView needle) const;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+// Instruction sets available to the vectorized text kernels.
+// SSE2 is part of every x86-64 target; AVX2 is enabled with the NOTER_ENABLE_AVX2 build option.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOTER_SIMD_AVX2 1
+#define NOTER_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOTER_SIMD_SSE2 1
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QStringEncoder>
+#include <QStringView>
+
+// Encodes text into a fixed-size output buffer and writes it to a device whenever it fills up,
+// so the memory needed to save a document does not depend on the document size.
+// Text the encoding cannot represent fails the write instead of being saved as '?'.
+class StreamingWriter
+{
+  private:
+	QIODevice* device;
+	QStringEncoder encoder;
+	QByteArray buffer;
+	qsizetype used;
+	bool failed;
+	QString error;
+
+	bool flushBuffer();
+
+  public:
+	static constexpr qsizetype bufferSize = 64 * 1024;
+
+	explicit StreamingWriter(QIODevice* device, QStringConverter::Encoding encoding = QStringConverter::Utf8, bool writeBom = false);
+
+	bool write(QStringView text);
+	bool flush();
+	bool hasError() const;
+	QString errorString() const;
+};
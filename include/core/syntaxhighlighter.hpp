@@ -1,43 +1,145 @@
 #pragma once
 
 #include <QSyntaxHighlighter>
+#include <QPointer>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QTextCursor>
+#include <QTextDocument>
 #include <QTextCharFormat>
-#include <QRegularExpression>
+#include <QTextEdit>
+#include <QTimer>
+#include <QHash>
 #include <QVector>
+#include "core/foldindex.hpp"
+#include "core/languageregistry.hpp"
+#include "core/lexer.hpp"
+#include "core/tokencache.hpp"
+#include "core/tokenizerpool.hpp"
 
+// Per-block bookkeeping of the highlighter
+class HighlightBlockData : public QTextBlockUserData
+{
+  public:
+	quint32 pass = 0; // background pass that last highlighted the block
+
+	// Last tokenizer result for the block
+	quint32 generation = 0;
+	int revision = -1;
+	int entryState = -1;
+	int exitState = -1;
+	QVector<syntax::Token> tokens;
+
+	// Job in the tokenizer pool that covers the block
+	quint64 queuedJob = 0;
+	int queuedIndex = -1; // position of the block in the job's run
+	int queuedRevision = -1;
+	int queuedState = -1; // -1 when the state is chained from an earlier block of the job
+	bool pending = false; // shown with stale formats until the result arrives
+
+	// Brackets of the tokenized text and their depth summary in the fold index
+	QVector<Bracket> brackets;
+	BracketSummary bracketSummary;
+	bool folded = false; // the blocks of its fold region are hidden
+};
+
+// Blocks of the built-in languages are tokenized by a pool of worker threads;
+// highlightBlock() only applies the token ranges cached in the block's data, keeping the
+// old formats and state until a result for the current text arrives.
+// Small documents are rehighlighted in one go. Large ones are highlighted in the
+// background: the blocks around the editor's viewport first, then the whole document
+// from the top in time-sliced batches, paused while the user is typing. The sweep runs
+// in document order, so block states carried across lines end up the same as with a
+// full rehighlight.
 class SyntaxHighlighter : public QSyntaxHighlighter
 {
 	Q_OBJECT
 
   public:
+	enum class Theme
+	{
+		Light,
+		Dark
+	};
+
 	explicit SyntaxHighlighter(QTextDocument* parent = nullptr);
+	// Name or alias of a language in the LanguageRegistry; unknown languages are left plain
 	void setLanguage(const QString& language);
+	// Editor whose visible blocks are highlighted first
+	void setEditor(QTextEdit* editor);
+	// Blocks keep their tokens as styles, so a new theme only reapplies formats and never runs the lexer
+	void setTheme(Theme theme);
+	Theme getTheme() const;
+
+	// Detaches from the document so bulk edits are not highlighted block by block;
+	// resume() reattaches and highlights the whole document once
+	void suspend();
+	void resume();
+
+	// Position of the bracket matching the one at position, or -1
+	int matchingBracket(int position) const;
+	// Block that closes the outermost bracket left open in the block; invalid if there is none
+	QTextBlock foldEnd(const QTextBlock& block) const;
+	// Hides or shows the blocks between the block and its fold end; false if the block has nothing to fold
+	bool toggleFold(const QTextBlock& block);
+
+	const TokenCache& getTokenCache() const;
+	// True while the background pass runs or blocks wait for the tokenizer
+	bool isBusy() const;
 
   protected:
 	void highlightBlock(const QString& text) override;
 
+  private slots:
+	void highlightViewport();
+	void sweepBatch();
+	void onContentsChange(int position, int charsRemoved, int charsAdded);
+	void onTokenized(quint64 job, int firstBlock, const QVector<TokenizerPool::TokenizedBlock>& results);
+	void syncFoldIndex(int position, int charsRemoved, int charsAdded);
+
   private:
-	struct HighlightingRule
-	{
-		QRegularExpression pattern;
-		QTextCharFormat format;
-	};
-	QVector<HighlightingRule> highlightingRules;
-
-	QTextCharFormat keywordFormat;
-	QTextCharFormat classFormat;
-	QTextCharFormat singleLineCommentFormat;
-	QTextCharFormat multiLineCommentFormat;
-	QTextCharFormat quotationFormat;
-	QTextCharFormat functionFormat;
-	QTextCharFormat numberFormat;
-
-	QRegularExpression commentStartExpression;
-	QRegularExpression commentEndExpression;
-
-	void setupCppHighlighting();
-	void setupPythonHighlighting();
-	void setupJavaHighlighting();
-	void setupJavaScriptHighlighting();
-	void setupHtmlHighlighting();
+	const Lexer* lexer;
+	TokenizerPool tokenizer;
+	TokenCache tokenCache;
+	QHash<quint64, QTextCursor> outstandingJobs; // at the start of the job's first block, moved along by edits
+	quint32 generation; // bumped whenever cached tokens stop being valid
+
+	const syntax::RuleSet* rules; // shared with the registry, used when there is no lexer
+
+	QPointer<QTextDocument> suspendedDocument;
+
+	QPointer<QTextEdit> editor;
+	QTimer sweepTimer;
+	QTextCursor sweepCursor; // every block before this one is highlighted with its final state
+	QTextBlock requestedBlock;
+	bool requestApplied;
+	bool sweepWaiting;
+	quint32 pass; // 0 when no background pass is running
+	quint32 passCounter;
+
+	// Bracket summaries by block number; blocks stored while its size lags behind an edit are refreshed by syncFoldIndex()
+	FoldIndex foldIndex;
+	int foldDirtyFirst;
+	int foldDirtyLast;
+
+	Theme theme;
+	std::array<QTextCharFormat, syntax::styleCount> formats; // by syntax::Style
+
+	const QTextCharFormat& formatFor(syntax::Style style) const;
+	int tokenizeWithRules(const QString& text, int previousState, QVector<syntax::Token>& tokens) const;
+	const void* languageKey() const;
+	void storeTokens(const QTextBlock& block, HighlightBlockData* data, const QString& text, int revision, int entryState, int exitState, const QVector<syntax::Token>& tokens);
+	void rebuildFoldIndex();
+	void unfold(const QTextBlock& block);
+
+	void restartHighlighting();
+	// Applies the formats of the current tokens again: at once in small documents, as a background pass in large ones
+	void highlightDocument();
+	void stopBackgroundPass();
+	// Returns true if the block got its final formats, false if it waits for the tokenizer
+	bool requestBlock(const QTextBlock& block);
+	bool highlightedInPass(const QTextBlock& block) const;
+	bool isQueued(const QTextBlock& block, const HighlightBlockData* data) const;
+	void submitRun(QTextBlock block, int entryState, int count);
+	static HighlightBlockData* blockData(QTextBlock block);
 };
@@ -0,0 +1,52 @@
+#pragma once
+#include <QByteArrayView>
+#include <QString>
+#include <QStringConverter>
+
+// Encoding detection and decoding for files opened in the editor.
+// UTF-8 decoding is vectorized (SSE2, or AVX2 when built with NOTER_ENABLE_AVX2):
+// pure-ASCII runs are validated and widened a register at a time and only the
+// multi-byte sequences go through the scalar decoder.
+namespace textcodec
+{
+	enum class Encoding
+	{
+		Utf8,
+		Utf16LE,
+		Utf16BE,
+		Latin1
+	};
+
+	struct Detection
+	{
+		Encoding encoding = Encoding::Utf8;
+		qsizetype bomLength = 0;
+	};
+
+	// Looks at a BOM first, then at the byte pattern of the sample
+	Detection detectEncoding(QByteArrayView sample);
+
+	qsizetype asciiPrefixLength(QByteArrayView data);
+	bool isValidUtf8(QByteArrayView data);
+
+	// Returns false (leaving out unspecified) when data is not valid UTF-8
+	bool decodeUtf8(QByteArrayView data, QString& out);
+
+	// Decodes data without its BOM; invalid input is replaced rather than rejected
+	QString decode(QByteArrayView data, Encoding encoding);
+
+	// Whole-file helper: detects the encoding, skips the BOM, decodes and normalizes CRLF to LF
+	QString decodeText(QByteArrayView bytes, Detection& detected);
+
+	// Length of the prefix that ends with the last complete line (0 if there is no newline yet)
+	qsizetype completeLinesLength(QByteArrayView data, Encoding encoding);
+	// Length of the prefix that ends with a complete character, for cutting a line that is too long to wait for.
+	// Never cuts between a surrogate pair or between a CR and the LF that may follow it
+	qsizetype completeCharactersLength(QByteArrayView data, Encoding encoding);
+
+	// Size of one code unit, chunk boundaries must be aligned to it
+	qsizetype codeUnitSize(Encoding encoding);
+	QStringConverter::Encoding converterEncoding(Encoding encoding);
+	QString encodingName(Encoding encoding);
+
+}; // namespace textcodec
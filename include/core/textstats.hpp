@@ -0,0 +1,55 @@
+#pragma once
+#include <QByteArrayView>
+#include <QStringView>
+#include "core/piecetable.hpp"
+
+// Statistics shown in the status bar
+namespace textstats
+{
+	struct Counts
+	{
+		qsizetype words = 0;  // \w+ runs over code points: letters, numbers, marks and '_'
+		qsizetype chars = 0;  // UTF-16 code units
+		qsizetype spaces = 0; // ' ' only
+	};
+
+	// Carried between consecutive pieces of one text
+	struct ScanState
+	{
+		bool inWord = false;
+		char16_t highSurrogate = 0; // ended the previous piece, classified with the next one
+	};
+
+	// Runs of ASCII are classified 16 or 32 at a time; other characters by their Unicode properties
+	Counts count(QStringView text, ScanState& state);
+	// The same counts straight from UTF-8; pieces must not split a multi-byte sequence.
+	// Malformed bytes count as one non-word character each.
+	Counts countUtf8(QByteArrayView text, ScanState& state);
+	// Large texts are split across the global thread pool
+	Counts count(const PieceTable& text);
+
+	qsizetype countWords(const PieceTable& text);
+
+}; // namespace textstats
+
+// Word, character and space counts of a text, kept up to date from its edits. A word is
+// counted at its first character, so an edit only rescans the removed and inserted text
+// and the characters on either side of it.
+class TextStats
+{
+  private:
+	qsizetype words;
+	qsizetype chars;
+	qsizetype spaces;
+
+  public:
+	TextStats();
+
+	void reset(const PieceTable& text);
+	// Must be called before the edit is applied to text
+	void replace(const PieceTable& text, qsizetype pos, qsizetype removed, QStringView inserted);
+
+	qsizetype wordCount() const;
+	qsizetype charCount() const;
+	qsizetype nonSpaceCount() const;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <QCache>
+#include <QString>
+#include <QVector>
+#include "core/lexer.hpp"
+
+// LRU cache of tokenized lines keyed by (text, entry state, language).
+// A line that has been tokenized in some state before, anywhere in the document, is
+// looked up instead of tokenized again; this is what keeps a comment that opens and
+// closes near the top of a file from re-tokenizing everything below it. The cost of an
+// entry is roughly its size in characters.
+class TokenCache
+{
+  public:
+	struct Entry
+	{
+		QString text;
+		int exitState;
+		QVector<syntax::Token> tokens;
+	};
+
+	static constexpr qsizetype defaultCapacity = 4 * 1024 * 1024;
+
+	explicit TokenCache(qsizetype capacity = defaultCapacity);
+
+	// language identifies the lexer or rule set the tokens came from
+	const Entry* find(const void* language, int entryState, const QString& text);
+	void insert(const void* language, int entryState, const QString& text, int exitState, const QVector<syntax::Token>& tokens);
+	void clear();
+
+	void setCapacity(qsizetype capacity);
+	qsizetype getCapacity() const;
+	qsizetype totalCost() const;
+
+	// Lookup statistics for tuning the capacity
+	quint64 hits() const;
+	quint64 misses() const;
+	void resetCounters();
+
+  private:
+	struct Key
+	{
+		const void* language;
+		int entryState;
+		size_t textHash;
+
+		bool operator==(const Key& other) const = default;
+	};
+	friend size_t qHash(const Key& key, size_t seed);
+
+	QCache<Key, Entry> cache;
+	quint64 hitCount;
+	quint64 missCount;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include "core/lexer.hpp"
+
+// Tokenizes runs of blocks on worker threads.
+// A job is an immutable snapshot: the text of consecutive blocks with their revisions and
+// the state the first block starts in; the states are chained through the run on the
+// worker. Results come back on the owner's thread tagged with the revisions they were
+// computed for, so the receiver can drop whatever has been edited in the meantime.
+class TokenizerPool : public QObject
+{
+	Q_OBJECT
+
+  public:
+	struct BlockSnapshot
+	{
+		int revision;
+		QString text;
+	};
+
+	struct TokenizedBlock
+	{
+		int revision;
+		QString text;
+		int entryState;
+		int exitState;
+		QVector<syntax::Token> tokens;
+	};
+
+	explicit TokenizerPool(QObject* parent = nullptr);
+	~TokenizerPool();
+
+	// Returns the id the job's results are reported with
+	quint64 submit(const Lexer* lexer, int firstBlock, int entryState, QVector<BlockSnapshot> blocks);
+
+  signals:
+	// Delivered on the thread that owns the pool
+	void tokenized(quint64 job, int firstBlock, const QVector<TokenizerPool::TokenizedBlock>& blocks);
+
+  private:
+	QThreadPool pool;
+	quint64 jobCounter;
+};
@@ -3,8 +3,22 @@
 #include <QMainWindow>
 #include <QTextEdit>
 #include <QStatusBar>
+#include <QTimer>
+#include <QQueue>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QLabel>
 #include "core/filesearcher.hpp"
 #include "core/syntaxhighlighter.hpp"
+#include "core/piecetable.hpp"
+#include "core/editjournal.hpp"
+#include "core/edithistory.hpp"
+#include "core/filefollower.hpp"
+#include "core/lineindex.hpp"
+#include "core/textstats.hpp"
+#include "core/searchindex.hpp"
+#include "core/matchfinder.hpp"
+#include "core/replaceengine.hpp"
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -21,15 +35,26 @@ class MainWindow : public QMainWindow
 	explicit MainWindow(QWidget* parent = nullptr);
 	~MainWindow();
 
+  protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
+
   private slots:
 	void onTextChanged();
+	void onContentsChange(int position, int charsRemoved, int charsAdded);
 	void updateStatistics();
 	void onOpenFile();
 	void onNewFile();
 	void onSearchText();
 	void onReplaceText();
 	void onReplaceAll();
+	void toggleSearchIndex(bool enabled);
+	void updateSearchHighlight();
+	void onMatchesFound(quint64 search, const QList<qsizetype>& starts);
+	void updateVisibleMatches();
 	void toggleSearchPanel();
+	void goToLine();
+	void toggleFold();
+	void updateBracketMatch();
 	void toggleDarkTheme();
 	void updateFont();
 	void setBold();
@@ -42,24 +67,83 @@ class MainWindow : public QMainWindow
 	void paste();
 	void selectAll();
 	void closeApplication();
+	void loadMoreChunks();
+	void onSaveProgress(qint64 written, qint64 total);
+	void onSaveFinished(bool success, const QString& filePath, const QString& error);
+	void onJournalTimer();
+	void onChunkLoaded(const QString& text, qint64 bytesRead, qint64 totalBytes);
+	void onLoadFinished(bool success, const QString& filePath, const QString& error);
+	void appendLoadedChunks();
+	void cancelLoading();
+	void toggleFollow(bool enabled);
+	void onFollowAppended(const QString& text);
+	void onFollowReset();
+	void recoverUnsavedChanges();
 
   private:
+	struct LoadedChunk
+	{
+		QString text;
+		int percent;
+	};
+
 	Ui::MainWindow* ui;
 	FileSearcher fileSearcher;
 	SyntaxHighlighter* syntaxHighlighter;
+	PieceTable textBuffer;
+	LineIndex lineIndex;
+	TextStats textStats;
+	SearchIndex searchIndex;
+	MatchFinder matchFinder;
+	ReplaceEngine replaceEngine;
+	QTimer statisticsTimer;
+	EditJournal journal;
+	EditHistory editHistory;
+	bool isApplyingHistory; // undo and redo are journaled but not recorded again
+	FileFollower fileFollower;
+	QTimer journalTimer;
+	QList<quint64> pendingSaveRevisions;
 	QString currentFilePath;
 	bool isDarkTheme;
+	bool isLoading;
+	QQueue<LoadedChunk> loadedChunks;
+	QTimer appendTimer;
+	QString loadingFilePath;
+	bool loadReadFinished;
+	bool loadReplacedDocument; // the first chunk has replaced the previous document
+	PieceTable previousText;
+	EditHistory previousHistory;
+	bool previousModified;
+	QProgressBar* loadProgressBar;
+	QPushButton* cancelLoadButton;
+	QLabel* searchCountLabel;
+	QString searchQuery;
+	quint64 activeSearch;
+	QList<qsizetype> searchMatches; // sorted starts of every match of searchQuery
+	QList<QTextEdit::ExtraSelection> searchSelections; // only the matches in the viewport
+	QList<QTextEdit::ExtraSelection> bracketSelections;
 
 	void setupUI();
 	void setupConnections();
-	void updateSearchHighlight();
+	void applyExtraSelections();
+	void applyHistoryChange(const EditHistory::Change& change);
+	void updateUndoActions();
+	void shiftSearchMatches(qsizetype position, qsizetype removed, qsizetype added);
 	QString detectLanguageFromExtension(const QString& filePath);
-	int countWords(const QString& text);
+	QString documentText(int position, int length) const;
 	QString getFileExtension() const;
 	QString buildFileName() const;
 	void updateExtensionFromFileName(const QString& fileName);
+	void setCurrentFile(const QString& filePath);
+	void appendNextChunk();
+	void appendFileText(const QString& text);
+	void loadRemainingChunks();
+	void beginLoading(const QString& filePath);
+	void replaceDocumentForLoading();
+	void endLoading();
+	void completeLoading();
 
   signals:
-	void onSaveFile(const QString& text);
-	void onSaveFileAs(const QString& newFilePath, const QString& text);
+	void onSaveFile(const PieceTable& text);
+	void onSaveFileAs(const QString& newFilePath, const PieceTable& text);
 };
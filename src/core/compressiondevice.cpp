@@ -0,0 +1,273 @@
+#include "core/compressiondevice.hpp"
+#include <QDebug>
+#include <QFile>
+#include <limits>
+#include <zlib.h>
+
+namespace
+{
+	// 15 bits of window; +16 writes a gzip wrapper, +32 detects gzip or zlib when reading
+	constexpr int windowBits = 15;
+
+}; // namespace
+
+namespace compression
+{
+	Format detectFormat(QByteArrayView header)
+	{
+		if (header.size() < 2)
+		{
+			return Format::None;
+		}
+
+		uchar first = uchar(header[0]);
+		uchar second = uchar(header[1]);
+		if (first == 0x1F && second == 0x8B)
+		{
+			return Format::Gzip;
+		}
+		// Deflate with a 32K window and a valid header checksum; "x^" still looks like text, so only the usual levels
+		if (first == 0x78 && (second == 0x01 || second == 0x9C || second == 0xDA))
+		{
+			return Format::Zlib;
+		}
+		return Format::None;
+	}
+
+	Format detectFile(const QString& filePath)
+	{
+		QFile file(filePath);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			return Format::None;
+		}
+		return detectFormat(file.read(2));
+	}
+
+	bool readFile(const QString& filePath, QByteArray& bytes)
+	{
+		QFile file(filePath);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			qDebug() << "Failed to open file:" << filePath;
+			return false;
+		}
+
+		if (detectFormat(file.peek(2)) == Format::None)
+		{
+			bytes = file.readAll();
+			return true;
+		}
+
+		CompressionDevice input(&file);
+		if (!input.open(QIODeviceBase::ReadOnly))
+		{
+			qDebug() << "Failed to open compressed file:" << filePath << input.errorString();
+			return false;
+		}
+
+		bytes.clear();
+		QByteArray block(CompressionDevice::bufferSize * 4, Qt::Uninitialized);
+		qint64 read = 0;
+		while ((read = input.read(block.data(), block.size())) > 0)
+		{
+			bytes.append(block.constData(), read);
+		}
+		if (read < 0)
+		{
+			qDebug() << "Failed to decompress file:" << filePath << input.errorString();
+			return false;
+		}
+		return true;
+	}
+
+	QString formatName(Format format)
+	{
+		switch (format)
+		{
+			case Format::None: return QString();
+			case Format::Gzip: return "gzip";
+			case Format::Zlib: return "zlib";
+		}
+		return QString();
+	}
+
+}; // namespace compression
+
+CompressionDevice::CompressionDevice(QIODevice* device, compression::Format format, QObject* parent)
+    : QIODevice(parent), device(device), format(format), stream(std::make_unique<z_stream_s>()), streamEnd(false), finished(false)
+{
+}
+
+CompressionDevice::~CompressionDevice()
+{
+	close();
+}
+
+bool CompressionDevice::open(OpenMode mode)
+{
+	if (isOpen() || (mode & ReadWrite) == ReadWrite || (mode & ReadWrite) == 0)
+	{
+		return false;
+	}
+
+	*stream = z_stream_s();
+	int result = Z_OK;
+	if (mode & ReadOnly)
+	{
+		result = inflateInit2(stream.get(), windowBits + 32);
+	}
+	else
+	{
+		int bits = format == compression::Format::Zlib ? windowBits : windowBits + 16;
+		result = deflateInit2(stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY);
+	}
+	if (result != Z_OK)
+	{
+		setErrorString("Failed to initialize zlib");
+		return false;
+	}
+
+	buffer.resize(bufferSize);
+	streamEnd = false;
+	finished = false;
+	return QIODevice::open(mode);
+}
+
+void CompressionDevice::close()
+{
+	if (!isOpen())
+	{
+		return;
+	}
+
+	if (openMode() & WriteOnly)
+	{
+		finish();
+		deflateEnd(stream.get());
+	}
+	else
+	{
+		inflateEnd(stream.get());
+	}
+	QIODevice::close();
+}
+
+bool CompressionDevice::isSequential() const
+{
+	return true;
+}
+
+qint64 CompressionDevice::readData(char* data, qint64 maxSize)
+{
+	stream->next_out = reinterpret_cast<Bytef*>(data);
+	stream->avail_out = uInt(std::min<qint64>(maxSize, std::numeric_limits<uInt>::max()));
+	const uInt requested = stream->avail_out;
+
+	while (stream->avail_out > 0 && !streamEnd)
+	{
+		if (stream->avail_in == 0)
+		{
+			qint64 read = device->read(buffer.data(), buffer.size());
+			if (read < 0)
+			{
+				setErrorString(device->errorString());
+				return -1;
+			}
+			if (read == 0)
+			{
+				// The input ended in the middle of a stream: keep what was decoded
+				if (requested == stream->avail_out)
+				{
+					setErrorString("Compressed data is truncated");
+					return -1;
+				}
+				break;
+			}
+			stream->next_in = reinterpret_cast<Bytef*>(buffer.data());
+			stream->avail_in = uInt(read);
+		}
+
+		int result = inflate(stream.get(), Z_NO_FLUSH);
+		if (result == Z_STREAM_END)
+		{
+			// Concatenated gzip members (as produced by appending to a .gz log) form one file
+			if (stream->avail_in == 0)
+			{
+				qint64 read = device->read(buffer.data(), buffer.size());
+				stream->next_in = reinterpret_cast<Bytef*>(buffer.data());
+				stream->avail_in = read > 0 ? uInt(read) : 0;
+			}
+			if (stream->avail_in == 0)
+			{
+				streamEnd = true;
+			}
+			else
+			{
+				inflateReset(stream.get());
+			}
+		}
+		else if (result != Z_OK && result != Z_BUF_ERROR)
+		{
+			setErrorString(stream->msg != nullptr ? QString::fromLatin1(stream->msg) : QString("Corrupt compressed data"));
+			return -1;
+		}
+	}
+
+	return requested - stream->avail_out;
+}
+
+qint64 CompressionDevice::writeData(const char* data, qint64 maxSize)
+{
+	qint64 written = 0;
+	while (written < maxSize)
+	{
+		uInt input = uInt(std::min<qint64>(maxSize - written, std::numeric_limits<uInt>::max()));
+		stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + written));
+		stream->avail_in = input;
+		do
+		{
+			stream->next_out = reinterpret_cast<Bytef*>(buffer.data());
+			stream->avail_out = uInt(buffer.size());
+			deflate(stream.get(), Z_NO_FLUSH);
+			if (!writeOutput(buffer.size() - stream->avail_out))
+			{
+				return -1;
+			}
+		} while (stream->avail_out == 0);
+		written += input;
+	}
+	return written;
+}
+
+bool CompressionDevice::finish()
+{
+	if (finished || !(openMode() & WriteOnly))
+	{
+		return true;
+	}
+	finished = true;
+
+	int result = Z_OK;
+	do
+	{
+		stream->next_out = reinterpret_cast<Bytef*>(buffer.data());
+		stream->avail_out = uInt(buffer.size());
+		result = deflate(stream.get(), Z_FINISH);
+		if (result == Z_STREAM_ERROR || !writeOutput(buffer.size() - stream->avail_out))
+		{
+			return false;
+		}
+	} while (result != Z_STREAM_END);
+	return true;
+}
+
+bool CompressionDevice::writeOutput(qsizetype length)
+{
+	if (length > 0 && device->write(buffer.constData(), length) != length)
+	{
+		setErrorString(device->errorString());
+		return false;
+	}
+	return true;
+}
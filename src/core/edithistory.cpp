@@ -0,0 +1,103 @@
+#include "core/edithistory.hpp"
+
+EditHistory::EditHistory() : current(0), open(false)
+{
+}
+
+void EditHistory::clear()
+{
+	steps.clear();
+	current = 0;
+	open = false;
+}
+
+void EditHistory::record(qsizetype position, const QString& removed, const QString& inserted)
+{
+	// Format changes report their range as removed and inserted again
+	if (removed == inserted)
+	{
+		return;
+	}
+
+	steps.resize(current);
+	if (!merge(position, removed, inserted))
+	{
+		steps.append({ position, removed, inserted });
+		current = steps.size();
+	}
+
+	// New lines and edits of more than one character are steps of their own
+	open = removed.size() + inserted.size() == 1 && !inserted.startsWith(u'\n');
+}
+
+bool EditHistory::merge(qsizetype position, const QString& removed, const QString& inserted)
+{
+	if (!open || steps.isEmpty() || removed.size() + inserted.size() != 1 || inserted.startsWith(u'\n'))
+	{
+		return false;
+	}
+
+	Step& step = steps.last();
+	if (removed.isEmpty() && step.removed.isEmpty() && position == step.position + step.inserted.size())
+	{
+		// Typing on at the end of the step
+		step.inserted += inserted;
+		return true;
+	}
+	if (inserted.isEmpty() && step.inserted.isEmpty())
+	{
+		if (position == step.position)
+		{
+			// Delete
+			step.removed += removed;
+			return true;
+		}
+		if (position + 1 == step.position)
+		{
+			// Backspace
+			step.removed.prepend(removed);
+			step.position = position;
+			return true;
+		}
+	}
+	return false;
+}
+
+void EditHistory::closeStep()
+{
+	open = false;
+}
+
+bool EditHistory::canUndo() const
+{
+	return current > 0;
+}
+
+bool EditHistory::canRedo() const
+{
+	return current < steps.size();
+}
+
+EditHistory::Change EditHistory::undo()
+{
+	open = false;
+	if (!canUndo())
+	{
+		return { 0, 0, QString() };
+	}
+
+	const Step& step = steps[--current];
+	return { step.position, step.inserted.size(), step.removed };
+}
+
+EditHistory::Change EditHistory::redo()
+{
+	open = false;
+	if (!canRedo())
+	{
+		return { 0, 0, QString() };
+	}
+
+	const Step& step = steps[current++];
+	return { step.position, step.removed.size(), step.inserted };
+}
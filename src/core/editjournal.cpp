@@ -0,0 +1,491 @@
+#include "core/editjournal.hpp"
+#include "core/compressiondevice.hpp"
+#include "core/defines.hpp"
+#include "core/streamingwriter.hpp"
+#include "core/textcodec.hpp"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace
+{
+	constexpr quint32 journalMagic = 0x4E4A524E;
+	constexpr quint32 snapshotMagic = 0x4E534E50;
+	constexpr quint16 journalVersion = 2;
+
+	constexpr quint8 insertOp = 'I';
+	constexpr quint8 removeOp = 'R';
+
+	// Records are buffered and written out in batches (or when flush() is called)
+	constexpr qsizetype pendingFlushSize = 64 * 1024;
+	// Inserted text is written and read in slices, QDataStream takes raw data lengths as int
+	constexpr qsizetype rawSliceSize = 64 * 1024 * 1024;
+
+	const QString recoveryKey = "recovery/journals";
+
+	QString journalBasePath(const QString& filePath)
+	{
+		if (filePath.isEmpty())
+		{
+			QString appDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/" + defines::projectName;
+			return appDir + "/.untitled";
+		}
+		QFileInfo fileInfo(filePath);
+		return fileInfo.absolutePath() + "/." + fileInfo.fileName();
+	}
+
+	QString lockPathFor(const QString& filePath)
+	{
+		return journalBasePath(filePath) + ".noter-lock";
+	}
+
+	// A journal whose lock is held belongs to a running instance; locks of crashed instances are stale and taken over
+	bool isJournalInUse(const QString& filePath)
+	{
+		QLockFile lock(lockPathFor(filePath));
+		lock.setStaleLockTime(0);
+		if (!lock.tryLock(0))
+		{
+			return lock.error() == QLockFile::LockFailedError;
+		}
+		lock.unlock();
+		return false;
+	}
+
+	// Bytes at each end of the base file that go into its checksum; the size and time of
+	// the last change cover the rest without reading a multi-gigabyte file on every open
+	constexpr qint64 checksumSampleSize = 64 * 1024;
+
+	// Identifies the version of the base file a journal was started from
+	struct BaseFile
+	{
+		qint64 size = -1;
+		qint64 modified = 0;
+		QByteArray checksum;
+
+		bool operator==(const BaseFile&) const = default;
+	};
+
+	QDataStream& operator<<(QDataStream& stream, const BaseFile& file)
+	{
+		return stream << file.size << file.modified << file.checksum;
+	}
+
+	QDataStream& operator>>(QDataStream& stream, BaseFile& file)
+	{
+		return stream >> file.size >> file.modified >> file.checksum;
+	}
+
+	BaseFile baseFileOf(const QString& filePath)
+	{
+		BaseFile base;
+		QFile file(filePath);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			return base;
+		}
+
+		base.size = file.size();
+		base.modified = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(file.read(checksumSampleSize));
+		if (base.size > checksumSampleSize)
+		{
+			file.seek(std::max(checksumSampleSize, base.size - checksumSampleSize));
+			hash.addData(file.read(checksumSampleSize));
+		}
+		base.checksum = hash.result();
+		return base;
+	}
+
+	bool readSnapshot(const QString& snapshotPath, quint32& generation, QString& text)
+	{
+		QFile file(snapshotPath);
+		if (!file.open(QIODeviceBase::ReadOnly))
+		{
+			return false;
+		}
+
+		QDataStream stream(&file);
+		quint32 magic = 0;
+		stream >> magic >> generation;
+		if (stream.status() != QDataStream::Ok || magic != snapshotMagic)
+		{
+			return false;
+		}
+
+		QByteArray bytes = file.readAll();
+		if (!textcodec::decodeUtf8(bytes, text))
+		{
+			text = QString::fromUtf8(bytes);
+		}
+		return true;
+	}
+
+}; // namespace
+
+EditJournal::EditJournal() : revisionCounter(0), generation(0)
+{
+}
+
+EditJournal::~EditJournal()
+{
+	flush();
+}
+
+QString EditJournal::journalPathFor(const QString& filePath)
+{
+	return journalBasePath(filePath) + ".noter-journal";
+}
+
+QString EditJournal::snapshotPathFor(const QString& filePath)
+{
+	return journalBasePath(filePath) + ".noter-snapshot";
+}
+
+QStringList EditJournal::pendingRecoveries()
+{
+	QStringList recoveries;
+	QSettings settings(defines::projectName, defines::projectName);
+	const QStringList registered = settings.value(recoveryKey).toStringList();
+	for (const QString& filePath : registered)
+	{
+		if (QFileInfo::exists(journalPathFor(filePath)) && !isJournalInUse(filePath))
+		{
+			recoveries.append(filePath);
+		}
+	}
+	return recoveries;
+}
+
+bool EditJournal::recover(const QString& filePath, QString& text)
+{
+	QFile file(journalPathFor(filePath));
+	if (!file.open(QIODeviceBase::ReadOnly))
+	{
+		return false;
+	}
+
+	QDataStream stream(&file);
+	quint32 magic = 0;
+	quint16 version = 0;
+	quint8 base = 0;
+	quint32 journalGeneration = 0;
+	BaseFile baseFile;
+	stream >> magic >> version >> base >> journalGeneration >> baseFile;
+	if (stream.status() != QDataStream::Ok || magic != journalMagic || version != journalVersion)
+	{
+		qDebug() << "Unreadable journal:" << file.fileName();
+		return false;
+	}
+
+	QString baseText;
+	if (Base(base) == Base::File)
+	{
+		// The edits were made to the file as it was then: replayed on other text they would scramble it
+		if (baseFileOf(filePath) != baseFile)
+		{
+			qDebug() << "Journal base file was changed on disk:" << filePath;
+			return false;
+		}
+
+		QByteArray bytes;
+		if (!compression::readFile(filePath, bytes))
+		{
+			qDebug() << "Journal base file is missing:" << filePath;
+			return false;
+		}
+		textcodec::Detection detected;
+		baseText = textcodec::decodeText(bytes, detected);
+	}
+	else if (Base(base) == Base::Snapshot)
+	{
+		quint32 snapshotGeneration = 0;
+		if (!readSnapshot(snapshotPathFor(filePath), snapshotGeneration, baseText))
+		{
+			qDebug() << "Journal snapshot is missing:" << snapshotPathFor(filePath);
+			return false;
+		}
+		// A crash between writing a snapshot and restarting the journal: the snapshot already has every edit
+		if (snapshotGeneration == journalGeneration + 1)
+		{
+			text = baseText;
+			return true;
+		}
+		if (snapshotGeneration != journalGeneration)
+		{
+			qDebug() << "Journal snapshot does not match the journal:" << snapshotPathFor(filePath);
+			return false;
+		}
+	}
+
+	PieceTable replayed(baseText);
+	while (!stream.atEnd())
+	{
+		quint8 op = 0;
+		qint64 pos = 0;
+		qint64 count = 0;
+		stream >> op >> pos >> count;
+		if (stream.status() != QDataStream::Ok)
+		{
+			break;
+		}
+
+		// A record cut off or garbled by the crash ends the replay, along with everything after it
+		if (pos < 0 || count < 0 || pos > replayed.length())
+		{
+			qDebug() << "Invalid journal record, stopping replay";
+			break;
+		}
+
+		if (op == insertOp)
+		{
+			// The tail of the journal was cut off by the crash
+			if (count > file.bytesAvailable() / qint64(sizeof(QChar)))
+			{
+				break;
+			}
+			QString inserted(count, Qt::Uninitialized);
+			char* data = reinterpret_cast<char*>(inserted.data());
+			qint64 bytes = count * qint64(sizeof(QChar));
+			bool complete = true;
+			for (qint64 offset = 0; complete && offset < bytes; offset += rawSliceSize)
+			{
+				int slice = int(std::min<qint64>(rawSliceSize, bytes - offset));
+				complete = stream.readRawData(data + offset, slice) == slice;
+			}
+			if (!complete)
+			{
+				break;
+			}
+			replayed.insert(pos, inserted);
+		}
+		else if (op == removeOp)
+		{
+			if (count > replayed.length() - pos)
+			{
+				qDebug() << "Invalid journal record, stopping replay";
+				break;
+			}
+			replayed.remove(pos, count);
+		}
+		else
+		{
+			qDebug() << "Unknown journal record, stopping replay";
+			break;
+		}
+	}
+
+	text = replayed.toString();
+	return true;
+}
+
+void EditJournal::discardRecovery(const QString& filePath)
+{
+	QFile::remove(journalPathFor(filePath));
+	QFile::remove(snapshotPathFor(filePath));
+	registerRecovery(filePath, false);
+}
+
+QString EditJournal::setAsideRecovery(const QString& filePath)
+{
+	QString suffix = "." + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+	QString journalPath = journalPathFor(filePath);
+	QString keptPath = journalPath + suffix;
+	if (!QFile::rename(journalPath, keptPath))
+	{
+		// Left in place and registered, the next start offers it again
+		qDebug() << "Failed to set aside journal:" << journalPath;
+		return journalPath;
+	}
+	QFile::rename(snapshotPathFor(filePath), snapshotPathFor(filePath) + suffix);
+	registerRecovery(filePath, false);
+	return keptPath;
+}
+
+bool EditJournal::open(const QString& filePath)
+{
+	close();
+
+	this->filePath = filePath;
+	generation = 0;
+
+	QString lockPath = lockPathFor(filePath);
+	QDir().mkpath(QFileInfo(lockPath).absolutePath());
+	ownerLock = std::make_unique<QLockFile>(lockPath);
+	ownerLock->setStaleLockTime(0);
+	if (!ownerLock->tryLock(0))
+	{
+		qDebug() << "Journal is in use by another instance:" << journalPathFor(filePath);
+		ownerLock.reset();
+		return false;
+	}
+
+	bool hasFile = !filePath.isEmpty() && QFileInfo::exists(filePath);
+	return start(hasFile ? Base::File : Base::Empty);
+}
+
+void EditJournal::close()
+{
+	if (!journalFile.isOpen())
+	{
+		ownerLock.reset();
+		return;
+	}
+
+	journalFile.close();
+	pending.clear();
+	discardRecovery(filePath);
+	ownerLock.reset();
+	filePath.clear();
+}
+
+bool EditJournal::isOpen() const
+{
+	return journalFile.isOpen();
+}
+
+QString EditJournal::getFilePath() const
+{
+	return filePath;
+}
+
+void EditJournal::recordInsert(qsizetype pos, QStringView text)
+{
+	if (!text.isEmpty())
+	{
+		appendRecord(insertOp, pos, text.size(), text);
+	}
+}
+
+void EditJournal::recordRemove(qsizetype pos, qsizetype count)
+{
+	if (count > 0)
+	{
+		appendRecord(removeOp, pos, count, QStringView());
+	}
+}
+
+bool EditJournal::flush()
+{
+	if (!journalFile.isOpen() || pending.isEmpty())
+	{
+		return true;
+	}
+
+	bool written = journalFile.write(pending) == pending.size() && journalFile.flush();
+	if (!written)
+	{
+		qDebug() << "Failed to write journal:" << journalFile.fileName() << journalFile.errorString();
+	}
+	pending.clear();
+	return written;
+}
+
+qint64 EditJournal::size() const
+{
+	return journalFile.isOpen() ? journalFile.size() + pending.size() : 0;
+}
+
+quint64 EditJournal::revision() const
+{
+	return revisionCounter;
+}
+
+bool EditJournal::compact(const PieceTable& text)
+{
+	if (!journalFile.isOpen())
+	{
+		return false;
+	}
+
+	QSaveFile snapshot(snapshotPathFor(filePath));
+	if (!snapshot.open(QIODeviceBase::WriteOnly))
+	{
+		qDebug() << "Failed to create journal snapshot:" << snapshot.fileName() << snapshot.errorString();
+		return false;
+	}
+
+	QDataStream header(&snapshot);
+	header << snapshotMagic << quint32(generation + 1);
+
+	StreamingWriter writer(&snapshot);
+	bool written = text.forEachChunk([&writer](QStringView chunk) { return writer.write(chunk); });
+	if (!written || !writer.flush() || !snapshot.commit())
+	{
+		qDebug() << "Failed to write journal snapshot:" << snapshot.fileName() << snapshot.errorString();
+		return false;
+	}
+
+	++generation;
+	return start(Base::Snapshot);
+}
+
+bool EditJournal::start(Base base)
+{
+	journalFile.close();
+	pending.clear();
+
+	QString journalPath = journalPathFor(filePath);
+	QDir().mkpath(QFileInfo(journalPath).absolutePath());
+
+	journalFile.setFileName(journalPath);
+	if (!journalFile.open(QIODeviceBase::WriteOnly | QIODeviceBase::Truncate))
+	{
+		qDebug() << "Failed to open journal:" << journalPath << journalFile.errorString();
+		return false;
+	}
+
+	QDataStream header(&journalFile);
+	header << journalMagic << journalVersion << quint8(base) << generation << (base == Base::File ? baseFileOf(filePath) : BaseFile());
+	journalFile.flush();
+
+	if (base != Base::Snapshot)
+	{
+		QFile::remove(snapshotPathFor(filePath));
+	}
+	registerRecovery(filePath, true);
+	return true;
+}
+
+void EditJournal::appendRecord(quint8 op, qsizetype pos, qsizetype count, QStringView text)
+{
+	if (!journalFile.isOpen())
+	{
+		return;
+	}
+
+	QDataStream record(&pending, QIODeviceBase::WriteOnly | QIODeviceBase::Append);
+	record << op << qint64(pos) << qint64(count);
+	const char* data = reinterpret_cast<const char*>(text.utf16());
+	qint64 bytes = text.size() * qint64(sizeof(QChar));
+	for (qint64 offset = 0; offset < bytes; offset += rawSliceSize)
+	{
+		record.writeRawData(data + offset, int(std::min<qint64>(rawSliceSize, bytes - offset)));
+	}
+
+	++revisionCounter;
+	if (pending.size() >= pendingFlushSize)
+	{
+		flush();
+	}
+}
+
+void EditJournal::registerRecovery(const QString& filePath, bool active)
+{
+	QSettings settings(defines::projectName, defines::projectName);
+	QStringList registered = settings.value(recoveryKey).toStringList();
+	registered.removeAll(filePath);
+	if (active)
+	{
+		registered.append(filePath);
+	}
+	settings.setValue(recoveryKey, registered);
+}
@@ -0,0 +1,152 @@
+#include "core/filefollower.hpp"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+namespace
+{
+	constexpr qint64 detectionSampleSize = 64 * 1024;
+
+}; // namespace
+
+FileFollower::FileFollower(QObject* parent) : QObject(parent), offset(0)
+{
+	connect(&watcher, &QFileSystemWatcher::fileChanged, this, &FileFollower::onFileChanged);
+	connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &FileFollower::onDirectoryChanged);
+}
+
+bool FileFollower::follow(const QString& filePath, qint64 offset, const textcodec::Detection& encoding)
+{
+	stop();
+
+	QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists())
+	{
+		qDebug() << "Cannot follow missing file:" << filePath;
+		return false;
+	}
+
+	this->filePath = fileInfo.absoluteFilePath();
+	this->offset = offset;
+	this->encoding = encoding;
+	birthTime = fileInfo.birthTime();
+
+	// The directory is watched as well: a rotated log reappears there under the same name
+	watcher.addPath(this->filePath);
+	watcher.addPath(fileInfo.absolutePath());
+
+	// Catch up on anything written since the file was loaded
+	readAppended();
+	return true;
+}
+
+void FileFollower::stop()
+{
+	if (!watcher.files().isEmpty())
+	{
+		watcher.removePaths(watcher.files());
+	}
+	if (!watcher.directories().isEmpty())
+	{
+		watcher.removePaths(watcher.directories());
+	}
+	filePath.clear();
+	offset = 0;
+}
+
+bool FileFollower::isFollowing() const
+{
+	return !filePath.isEmpty();
+}
+
+QString FileFollower::getFilePath() const
+{
+	return filePath;
+}
+
+void FileFollower::onFileChanged(const QString& path)
+{
+	if (path != filePath)
+	{
+		return;
+	}
+
+	if (!QFileInfo::exists(filePath))
+	{
+		// Moved away or deleted; onDirectoryChanged() picks up its replacement
+		return;
+	}
+
+	// The watcher drops files that were replaced, so a missing watch means a new file
+	if (!watcher.files().contains(filePath))
+	{
+		watcher.addPath(filePath);
+		restart();
+		return;
+	}
+
+	readAppended();
+}
+
+void FileFollower::onDirectoryChanged(const QString& path)
+{
+	Q_UNUSED(path);
+	if (filePath.isEmpty() || watcher.files().contains(filePath) || !QFileInfo::exists(filePath))
+	{
+		return;
+	}
+
+	watcher.addPath(filePath);
+	restart();
+}
+
+void FileFollower::restart()
+{
+	offset = 0;
+	birthTime = QFileInfo(filePath).birthTime();
+	emit reset();
+	readAppended();
+}
+
+void FileFollower::readAppended()
+{
+	QFile file(filePath);
+	if (!file.open(QIODeviceBase::ReadOnly))
+	{
+		return;
+	}
+
+	// Truncated in place, or a different file under the same name
+	QDateTime currentBirthTime = QFileInfo(filePath).birthTime();
+	bool replaced = birthTime.isValid() && currentBirthTime.isValid() && currentBirthTime != birthTime;
+	if (file.size() < offset || replaced)
+	{
+		offset = 0;
+		birthTime = currentBirthTime;
+		emit reset();
+	}
+
+	if (offset == 0)
+	{
+		encoding = textcodec::detectEncoding(file.peek(detectionSampleSize));
+		offset = encoding.bomLength;
+	}
+
+	qint64 available = file.size() - offset;
+	if (available <= 0 || !file.seek(offset))
+	{
+		return;
+	}
+
+	QByteArray bytes = file.read(available);
+	qsizetype length = textcodec::completeLinesLength(bytes, encoding.encoding);
+	if (length == 0)
+	{
+		return;
+	}
+
+	QString text = textcodec::decode(QByteArrayView(bytes).first(length), encoding.encoding);
+	text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+	offset += length;
+	emit appended(text);
+}
@@ -4,7 +4,7 @@
 #include <QDebug>
 #include <QRegularExpression>
 #include <QFile>
-#include <QTextStream>
+#include <QMetaObject>
 #include <QDir>
 #include <QFileInfo>
 
@@ -22,15 +22,40 @@ namespace
 
 }; // namespace
 
-FileSearcher::FileSearcher(QObject* parent) : QObject(parent), workingDir(getAppDirPath())
+FileSearcher::FileSearcher(QObject* parent)
+    : QObject(parent), workingDir(getAppDirPath()), compression(compression::Format::None), loadedBytes(0), asyncLoadedBytes(0), saveWorker(new SaveWorker), loadWorker(new LoadWorker), activeLoad(0)
 {
 	qDebug() << "Current path: " << workingDir;
+
+	saveWorker->moveToThread(&saveThread);
+	connect(&saveThread, &QThread::finished, saveWorker, &QObject::deleteLater);
+	connect(saveWorker, &SaveWorker::progress, this, &FileSearcher::saveProgress);
+	connect(saveWorker, &SaveWorker::finished, this, &FileSearcher::onSaveFinished);
+	saveThread.start();
+
+	loadWorker->moveToThread(&loadThread);
+	connect(&loadThread, &QThread::finished, loadWorker, &QObject::deleteLater);
+	connect(loadWorker, &LoadWorker::chunkLoaded, this, &FileSearcher::onChunkLoaded);
+	connect(loadWorker, &LoadWorker::finished, this, &FileSearcher::onLoadFinished);
+	loadThread.start();
+}
+
+FileSearcher::~FileSearcher()
+{
+	// Pending saves are still processed before the thread stops
+	saveThread.quit();
+	saveThread.wait();
+
+	cancelLoad();
+	loadThread.quit();
+	loadThread.wait();
 }
 
-bool FileSearcher::saveFile(const QString& text)
+bool FileSearcher::saveFile(const PieceTable& text)
 {
 	if (workingDir.isEmpty())
 	{
+		emit saveFinished(false, filePath, "No working directory");
 		return false;
 	}
 
@@ -43,7 +68,7 @@ bool FileSearcher::saveFile(const QString& text)
 	};
 	if (filePath.isEmpty())
 	{
-		filePath = workingDir + getFirstWord(text);
+		filePath = workingDir + getFirstWord(text.slice(0, 4096));
 	}
 
 	// Ensure directory exists
@@ -54,25 +79,30 @@ bool FileSearcher::saveFile(const QString& text)
 		if (!dir.mkpath("."))
 		{
 			qDebug() << "Failed to create directory:" << dir.absolutePath();
+			emit saveFinished(false, filePath, "Failed to create directory " + dir.absolutePath());
 			return false;
 		}
 	}
 
-	QFile fileToSave(filePath);
-	if (!fileToSave.open(QIODeviceBase::WriteOnly | QIODevice::Text))
-	{
-		return false;
-	}
+	compression::Format format = filePath.endsWith(".gz", Qt::CaseInsensitive) ? compression::Format::Gzip : compression;
 
-	QTextStream outputToFile(&fileToSave);
-	outputToFile << text;
-	fileToSave.close();
+	// The snapshot shares the buffers, so editing can go on while the worker writes it out
+	QMetaObject::invokeMethod(
+	    saveWorker,
+	    [worker = saveWorker, targetPath = filePath, snapshot = text, encoding = encoding, format]()
+	    { worker->save(targetPath, snapshot, encoding, format); },
+	    Qt::QueuedConnection);
 
 	return true;
 }
 
-bool FileSearcher::saveFileAs(const QString& newFilePath, const QString& text)
+bool FileSearcher::saveFileAs(const QString& newFilePath, const PieceTable& text)
 {
+	// A copy under a new name is compressed only if the name asks for it
+	if (newFilePath != filePath)
+	{
+		compression = compression::Format::None;
+	}
 	filePath = newFilePath;
 	if (!saveFile(text))
 	{
@@ -84,21 +114,126 @@ bool FileSearcher::saveFileAs(const QString& newFilePath, const QString& text)
 
 QString FileSearcher::openFile(const QString& filePath)
 {
-	QFile file(filePath);
-	if (!file.open(QIODeviceBase::ReadOnly | QIODevice::Text))
+	mappedFile.close();
+
+	QByteArray bytes;
+	if (!compression::readFile(filePath, bytes))
 	{
-		qDebug() << "Failed to open file:" << filePath;
 		return QString();
 	}
+	compression = compression::detectFile(filePath);
 
-	QTextStream inputFromFile(&file);
-	QString content = inputFromFile.readAll();
-	file.close();
+	QString content = textcodec::decodeText(bytes, encoding);
 
 	this->filePath = filePath;
+	loadedBytes = bytes.size();
 	return content;
 }
 
+bool FileSearcher::openFileMapped(const QString& filePath)
+{
+	// Probed first, so a file that cannot be mapped leaves the current mapping and its unread tail alone
+	MappedFile probe;
+	if (!probe.open(filePath))
+	{
+		return false;
+	}
+	probe.close();
+
+	if (!mappedFile.open(filePath))
+	{
+		return false;
+	}
+
+	encoding = mappedFile.encoding();
+	compression = compression::Format::None;
+	this->filePath = filePath;
+	return true;
+}
+
+void FileSearcher::openFileAsync(const QString& filePath)
+{
+	cancelLoad();
+
+	asyncLoadedBytes = 0;
+	activeLoad = loadWorker->nextRequest();
+	QMetaObject::invokeMethod(
+	    loadWorker, [worker = loadWorker, request = activeLoad, filePath]() { worker->load(request, filePath); }, Qt::QueuedConnection);
+}
+
+void FileSearcher::cancelLoad()
+{
+	if (activeLoad != 0)
+	{
+		loadWorker->cancel();
+		activeLoad = 0;
+	}
+}
+
+void FileSearcher::onSaveFinished(bool success, const QString& filePath, const QString& error)
+{
+	if (success && filePath == this->filePath)
+	{
+		loadedBytes = QFileInfo(filePath).size();
+	}
+	emit saveFinished(success, filePath, error);
+}
+
+bool FileSearcher::isLoading() const
+{
+	return activeLoad != 0;
+}
+
+void FileSearcher::onChunkLoaded(quint64 request, const QString& text, qint64 bytesRead, qint64 totalBytes)
+{
+	// Chunks of a cancelled load may still be queued
+	if (request == activeLoad)
+	{
+		asyncLoadedBytes = bytesRead;
+		emit chunkLoaded(text, bytesRead, totalBytes);
+	}
+}
+
+void FileSearcher::onLoadFinished(quint64 request, bool success, const QString& filePath, const QString& error, const textcodec::Detection& encoding)
+{
+	if (request != activeLoad)
+	{
+		return;
+	}
+
+	activeLoad = 0;
+	if (success)
+	{
+		mappedFile.close();
+		this->encoding = encoding;
+		this->filePath = filePath;
+		compression = compression::detectFile(filePath);
+		loadedBytes = asyncLoadedBytes;
+	}
+	emit loadFinished(success, filePath, error);
+}
+
+QString FileSearcher::readNextChunk()
+{
+	QString chunk = mappedFile.readChunk();
+	loadedBytes = mappedFile.offset();
+	if (mappedFile.atEnd())
+	{
+		mappedFile.close();
+	}
+	return chunk;
+}
+
+bool FileSearcher::hasMoreChunks() const
+{
+	return mappedFile.isOpen() && !mappedFile.atEnd();
+}
+
+void FileSearcher::closeMappedFile()
+{
+	mappedFile.close();
+}
+
 void FileSearcher::setFilePath(const QString& path)
 {
 	filePath = path;
@@ -109,6 +244,27 @@ QString FileSearcher::getFilePath() const
 	return filePath;
 }
 
+textcodec::Detection FileSearcher::getEncoding() const
+{
+	return encoding;
+}
+
+void FileSearcher::resetEncoding()
+{
+	encoding = textcodec::Detection();
+	compression = compression::Format::None;
+}
+
+compression::Format FileSearcher::getCompression() const
+{
+	return compression;
+}
+
+qint64 FileSearcher::getLoadedBytes() const
+{
+	return loadedBytes;
+}
+
 bool FileSearcher::removeAppDir()
 {
 	QString appDirPath = getAppDirPath();
@@ -0,0 +1,291 @@
+#include "core/foldindex.hpp"
+#include <algorithm>
+#include <vector>
+
+FoldIndex::FoldIndex() : seed(0x9E3779B9u)
+{
+}
+
+void FoldIndex::reset(const QVector<BracketSummary>& summaries)
+{
+	root = build(summaries);
+}
+
+int FoldIndex::size() const
+{
+	return countOf(root);
+}
+
+void FoldIndex::insert(int index, int count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	NodePtr left;
+	NodePtr right;
+	split(std::move(root), index, left, right);
+	root = merge(merge(std::move(left), build(QVector<BracketSummary>(count))), std::move(right));
+}
+
+void FoldIndex::remove(int index, int count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	NodePtr left;
+	NodePtr rest;
+	NodePtr removed;
+	NodePtr right;
+	split(std::move(root), index, left, rest);
+	split(std::move(rest), count, removed, right);
+	root = merge(std::move(left), std::move(right));
+}
+
+void FoldIndex::set(int index, const BracketSummary& summary)
+{
+	if (index >= 0 && index < size())
+	{
+		assign(root.get(), index, summary);
+	}
+}
+
+int FoldIndex::depthAt(int index) const
+{
+	int depth = 0;
+	const Node* node = root.get();
+	while (node != nullptr)
+	{
+		int leftCount = countOf(node->left);
+		if (index < leftCount)
+		{
+			node = node->left.get();
+			continue;
+		}
+
+		depth += node->left ? node->left->delta : 0;
+		if (index == leftCount)
+		{
+			break;
+		}
+		depth += node->summary.delta;
+		index -= leftCount + 1;
+		node = node->right.get();
+	}
+	return depth;
+}
+
+int FoldIndex::findForward(int after, int depth) const
+{
+	return findForward(root.get(), 0, 0, after, depth);
+}
+
+int FoldIndex::findBackward(int before, int depth) const
+{
+	return findBackward(root.get(), 0, 0, before, depth);
+}
+
+int FoldIndex::countOf(const NodePtr& node)
+{
+	return node ? node->count : 0;
+}
+
+void FoldIndex::update(Node* node)
+{
+	const Node* left = node->left.get();
+	const Node* right = node->right.get();
+
+	int depth = left != nullptr ? left->delta : 0;
+	int lowest = depth + node->summary.minDepth;
+	if (left != nullptr)
+	{
+		lowest = std::min(lowest, left->minDepth);
+	}
+	depth += node->summary.delta;
+	if (right != nullptr)
+	{
+		lowest = std::min(lowest, depth + right->minDepth);
+		depth += right->delta;
+	}
+
+	node->count = 1 + countOf(node->left) + countOf(node->right);
+	node->delta = depth;
+	node->minDepth = lowest;
+}
+
+FoldIndex::NodePtr FoldIndex::merge(NodePtr left, NodePtr right)
+{
+	if (!left)
+	{
+		return right;
+	}
+	if (!right)
+	{
+		return left;
+	}
+
+	if (left->priority > right->priority)
+	{
+		left->right = merge(std::move(left->right), std::move(right));
+		update(left.get());
+		return left;
+	}
+	right->left = merge(std::move(left), std::move(right->left));
+	update(right.get());
+	return right;
+}
+
+void FoldIndex::split(NodePtr node, int index, NodePtr& left, NodePtr& right)
+{
+	if (!node)
+	{
+		left.reset();
+		right.reset();
+		return;
+	}
+
+	int leftCount = countOf(node->left);
+	if (index <= leftCount)
+	{
+		split(std::move(node->left), index, left, node->left);
+		update(node.get());
+		right = std::move(node);
+	}
+	else
+	{
+		split(std::move(node->right), index - leftCount - 1, node->right, right);
+		update(node.get());
+		left = std::move(node);
+	}
+}
+
+void FoldIndex::assign(Node* node, int index, const BracketSummary& summary)
+{
+	int leftCount = countOf(node->left);
+	if (index < leftCount)
+	{
+		assign(node->left.get(), index, summary);
+	}
+	else if (index > leftCount)
+	{
+		assign(node->right.get(), index - leftCount - 1, summary);
+	}
+	else
+	{
+		node->summary = summary;
+	}
+	update(node);
+}
+
+int FoldIndex::findForward(const Node* node, int firstIndex, int startDepth, int after, int depth)
+{
+	// Subtrees that end before the range or never get down to depth are skipped whole
+	if (node == nullptr || firstIndex + node->count - 1 <= after || startDepth + node->minDepth > depth)
+	{
+		return -1;
+	}
+
+	int found = findForward(node->left.get(), firstIndex, startDepth, after, depth);
+	if (found >= 0)
+	{
+		return found;
+	}
+
+	int index = firstIndex + countOf(node->left);
+	int nodeDepth = startDepth + (node->left ? node->left->delta : 0);
+	if (index > after && nodeDepth + node->summary.minDepth <= depth)
+	{
+		return index;
+	}
+	return findForward(node->right.get(), index + 1, nodeDepth + node->summary.delta, after, depth);
+}
+
+int FoldIndex::findBackward(const Node* node, int firstIndex, int startDepth, int before, int depth)
+{
+	if (node == nullptr || firstIndex >= before || startDepth + node->minDepth > depth)
+	{
+		return -1;
+	}
+
+	int index = firstIndex + countOf(node->left);
+	int nodeDepth = startDepth + (node->left ? node->left->delta : 0);
+	int found = findBackward(node->right.get(), index + 1, nodeDepth + node->summary.delta, before, depth);
+	if (found >= 0)
+	{
+		return found;
+	}
+
+	if (index < before && nodeDepth + node->summary.minDepth <= depth)
+	{
+		return index;
+	}
+	return findBackward(node->left.get(), firstIndex, startDepth, before, depth);
+}
+
+quint32 FoldIndex::nextPriority()
+{
+	// xorshift32
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+FoldIndex::NodePtr FoldIndex::build(const QVector<BracketSummary>& summaries)
+{
+	// Cartesian tree in O(n): the right spine of the tree built so far is kept on a stack
+	std::vector<Node*> spine;
+	for (const BracketSummary& summary : summaries)
+	{
+		Node* node = new Node{ summary, nextPriority(), 1, 0, 0, nullptr, nullptr };
+		Node* last = nullptr;
+		while (!spine.empty() && spine.back()->priority < node->priority)
+		{
+			last = spine.back();
+			spine.pop_back();
+		}
+		if (last != nullptr)
+		{
+			if (!spine.empty())
+			{
+				spine.back()->right.release();
+			}
+			node->left.reset(last);
+		}
+		if (!spine.empty())
+		{
+			spine.back()->right.reset(node);
+		}
+		spine.push_back(node);
+	}
+	if (spine.empty())
+	{
+		return nullptr;
+	}
+
+	// Subtree sums are filled in bottom-up
+	NodePtr built(spine.front());
+	std::vector<Node*> order;
+	std::vector<Node*> pending{ built.get() };
+	while (!pending.empty())
+	{
+		Node* node = pending.back();
+		pending.pop_back();
+		order.push_back(node);
+		for (Node* child : { node->left.get(), node->right.get() })
+		{
+			if (child != nullptr)
+			{
+				pending.push_back(child);
+			}
+		}
+	}
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		update(*it);
+	}
+	return built;
+}
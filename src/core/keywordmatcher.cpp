@@ -0,0 +1,98 @@
+#include "core/keywordmatcher.hpp"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	constexpr quint32 maxSeedAttempts = 10000;
+
+}; // namespace
+
+KeywordMatcher::KeywordMatcher() : seed(0), mask(0), minLength(0), maxLength(0)
+{
+}
+
+KeywordMatcher::KeywordMatcher(const QStringList& keywords) : KeywordMatcher()
+{
+	QStringList unique = keywords;
+	unique.removeDuplicates();
+	if (unique.isEmpty())
+	{
+		return;
+	}
+
+	minLength = std::numeric_limits<qsizetype>::max();
+	for (const QString& keyword : unique)
+	{
+		minLength = std::min(minLength, keyword.size());
+		maxLength = std::max(maxLength, keyword.size());
+	}
+
+	// Four table slots per keyword make a collision-free seed easy to find
+	quint32 size = 1;
+	while (size < quint32(unique.size()) * 4)
+	{
+		size *= 2;
+	}
+	mask = size - 1;
+
+	for (quint32 attempt = 0; attempt < maxSeedAttempts; ++attempt)
+	{
+		table = QList<QString>(size);
+		bool collision = false;
+		for (const QString& keyword : unique)
+		{
+			QString& slot = table[slotFor(keyword, attempt)];
+			if (!slot.isNull())
+			{
+				collision = true;
+				break;
+			}
+			slot = keyword;
+		}
+
+		if (!collision)
+		{
+			seed = attempt;
+			return;
+		}
+
+		// Unlucky key set: retry with a sparser table
+		if (attempt % 1000 == 999)
+		{
+			size *= 2;
+			mask = size - 1;
+		}
+	}
+
+	qDebug() << "No perfect hash found for keywords" << unique;
+	table.clear();
+	mask = 0;
+}
+
+quint32 KeywordMatcher::slotFor(QStringView word, quint32 seed) const
+{
+	// FNV-1a over the UTF-16 code units
+	quint32 hash = 2166136261u ^ (seed * 0x9E3779B9u);
+	for (QChar c : word)
+	{
+		hash = (hash ^ c.unicode()) * 16777619u;
+	}
+	return (hash ^ (hash >> 15)) & mask;
+}
+
+bool KeywordMatcher::contains(QStringView word) const
+{
+	if (table.isEmpty() || word.size() < minLength || word.size() > maxLength)
+	{
+		return false;
+	}
+	const QString& slot = table[slotFor(word, seed)];
+	return slot.size() == word.size() && QStringView(slot) == word;
+}
+
+bool KeywordMatcher::isEmpty() const
+{
+	return table.isEmpty();
+}
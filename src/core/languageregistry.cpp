@@ -0,0 +1,206 @@
+#include "core/languageregistry.hpp"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+
+namespace
+{
+	QStringList toStringList(const QJsonValue& value)
+	{
+		QStringList list;
+		const QJsonArray array = value.toArray();
+		for (const QJsonValue& item : array)
+		{
+			list.append(item.toString());
+		}
+		return list;
+	}
+
+	bool styleFromName(const QString& name, syntax::Style& style)
+	{
+		static const QList<std::pair<QString, syntax::Style>> styles = {
+			{ "keyword", syntax::Style::Keyword }, { "type", syntax::Style::Type },     { "function", syntax::Style::Function },
+			{ "string", syntax::Style::String },   { "comment", syntax::Style::Comment }, { "number", syntax::Style::Number },
+			{ "tag", syntax::Style::Tag },         { "entity", syntax::Style::Entity },
+		};
+		for (const auto& [styleName, value] : styles)
+		{
+			if (styleName == name)
+			{
+				style = value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Compiles the pattern now instead of on the first match while typing
+	bool compilePattern(const QString& pattern, QRegularExpression& expression, const QString& path)
+	{
+		expression = QRegularExpression(pattern);
+		if (!expression.isValid())
+		{
+			qDebug() << "Invalid pattern in" << path << ":" << pattern << expression.errorString();
+			return false;
+		}
+		expression.optimize();
+		return true;
+	}
+
+	syntax::LanguageDefinition builtIn(const QString& name, const QStringList& aliases, const QStringList& extensions)
+	{
+		syntax::LanguageDefinition definition;
+		definition.name = name;
+		definition.aliases = aliases;
+		definition.extensions = extensions;
+		definition.lexer = Lexer::forLanguage(name);
+		return definition;
+	}
+
+}; // namespace
+
+LanguageRegistry::LanguageRegistry()
+{
+	add(builtIn("cpp", { "c", "h", "hpp" }, { ".cpp", ".cxx", ".cc", ".c", ".h", ".hpp", ".hxx" }));
+	add(builtIn("python", { "py" }, { ".py" }));
+	add(builtIn("java", {}, { ".java" }));
+	add(builtIn("javascript", { "js" }, { ".js" }));
+	add(builtIn("html", { "xml" }, { ".html", ".xml" }));
+	add(builtIn("rust", { "rs" }, { ".rs" }));
+}
+
+LanguageRegistry& LanguageRegistry::instance()
+{
+	static LanguageRegistry registry;
+	return registry;
+}
+
+QStringList LanguageRegistry::searchPaths()
+{
+	QStringList paths = { QCoreApplication::applicationDirPath() + "/languages" };
+	paths += QStandardPaths::locateAll(QStandardPaths::AppDataLocation, "languages", QStandardPaths::LocateDirectory);
+	paths.removeDuplicates();
+	return paths;
+}
+
+int LanguageRegistry::loadDataFiles()
+{
+	int loaded = 0;
+	for (const QString& path : searchPaths())
+	{
+		loaded += loadDirectory(path);
+	}
+	return loaded;
+}
+
+int LanguageRegistry::loadDirectory(const QString& path)
+{
+	int loaded = 0;
+	const QStringList files = QDir(path).entryList({ "*.json" }, QDir::Files, QDir::Name);
+	for (const QString& file : files)
+	{
+		loaded += loadFile(QDir(path).filePath(file)) ? 1 : 0;
+	}
+	return loaded;
+}
+
+bool LanguageRegistry::loadFile(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODeviceBase::ReadOnly))
+	{
+		qDebug() << "Failed to open language file:" << path << file.errorString();
+		return false;
+	}
+
+	QJsonParseError error;
+	QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+	if (error.error != QJsonParseError::NoError || !document.isObject())
+	{
+		qDebug() << "Invalid language file:" << path << error.errorString();
+		return false;
+	}
+
+	QJsonObject object = document.object();
+	syntax::LanguageDefinition definition;
+	definition.name = object.value("name").toString();
+	if (definition.name.isEmpty())
+	{
+		qDebug() << "Language file without a name:" << path;
+		return false;
+	}
+	definition.aliases = toStringList(object.value("aliases"));
+	definition.extensions = toStringList(object.value("extensions"));
+
+	auto rules = std::make_shared<syntax::RuleSet>();
+	rules->keywords = KeywordMatcher(toStringList(object.value("keywords")));
+
+	const QJsonArray ruleArray = object.value("rules").toArray();
+	for (const QJsonValue& value : ruleArray)
+	{
+		QJsonObject ruleObject = value.toObject();
+		syntax::HighlightingRule rule;
+		if (!styleFromName(ruleObject.value("style").toString(), rule.style))
+		{
+			qDebug() << "Unknown style in" << path << ":" << ruleObject.value("style").toString();
+			continue;
+		}
+		if (compilePattern(ruleObject.value("pattern").toString(), rule.pattern, path))
+		{
+			rules->rules.append(rule);
+		}
+	}
+
+	QString commentStart = object.value("commentStart").toString();
+	QString commentEnd = object.value("commentEnd").toString();
+	if (!commentStart.isEmpty() && !commentEnd.isEmpty())
+	{
+		if (!compilePattern(commentStart, rules->commentStart, path) || !compilePattern(commentEnd, rules->commentEnd, path))
+		{
+			rules->commentStart = QRegularExpression();
+			rules->commentEnd = QRegularExpression();
+		}
+	}
+
+	definition.rules = std::move(rules);
+	add(std::move(definition));
+	return true;
+}
+
+void LanguageRegistry::add(syntax::LanguageDefinition definition)
+{
+	languages.append(std::make_shared<const syntax::LanguageDefinition>(std::move(definition)));
+}
+
+const syntax::LanguageDefinition* LanguageRegistry::find(const QString& name) const
+{
+	// Newest first, so a data file can override a built-in language
+	for (auto it = languages.crbegin(); it != languages.crend(); ++it)
+	{
+		if ((*it)->name == name || (*it)->aliases.contains(name))
+		{
+			return it->get();
+		}
+	}
+	return nullptr;
+}
+
+const syntax::LanguageDefinition* LanguageRegistry::forFileName(const QString& fileName) const
+{
+	for (auto it = languages.crbegin(); it != languages.crend(); ++it)
+	{
+		for (const QString& extension : (*it)->extensions)
+		{
+			if (fileName.endsWith(extension, Qt::CaseInsensitive))
+			{
+				return it->get();
+			}
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,823 @@
+#include "core/lexer.hpp"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+
+using namespace syntax;
+
+namespace
+{
+	std::array<quint8, 128> buildClassTable()
+	{
+		std::array<quint8, 128> table;
+		table.fill(Other);
+		for (char c = 'a'; c <= 'z'; ++c)
+		{
+			table[c] = Letter;
+			table[c - 'a' + 'A'] = Letter;
+		}
+		for (char c = '0'; c <= '9'; ++c)
+		{
+			table[c] = Digit;
+		}
+		table['_'] = Letter;
+		table[' '] = Space;
+		table['\t'] = Space;
+		table['\r'] = Space;
+		table['\n'] = Space;
+		table['.'] = Dot;
+		table['"'] = DoubleQuote;
+		table['\''] = SingleQuote;
+		table['`'] = Backtick;
+		table['/'] = Slash;
+		table['*'] = Star;
+		table['#'] = Hash;
+		table['\\'] = Backslash;
+		table['<'] = Less;
+		table['>'] = Greater;
+		table['!'] = Bang;
+		table['-'] = Dash;
+		table['&'] = Amp;
+		table[';'] = Semicolon;
+		table['='] = Equals;
+		table['$'] = Dollar;
+		table['{'] = LeftBrace;
+		table['}'] = RightBrace;
+		return table;
+	}
+
+	const std::array<quint8, 128> classTable = buildClassTable();
+
+	// Payloads stay below 0x8000 so that packed states are never negative (-1 is "no state" to Qt).
+	// The last id is reserved for terminators that no longer fit into the table
+	constexpr quint16 unknownTerminator = 0x7FFF;
+	constexpr qsizetype maxTerminators = unknownTerminator - 1;
+	constexpr quint8 maxBraceDepth = 15;
+	constexpr quint8 maxDepth = 0xFF;
+
+	// Raw string terminators carried in block states, shared by every lexer and thread.
+	// Ids are never reused, since block states of open documents keep referring to them; 0 is
+	// "no terminator". Real code has a handful of distinct delimiters, so the table only fills
+	// up on pathological input; after that new ones are carried as unknownTerminator.
+	QMutex terminatorMutex;
+	QStringList terminators;
+	QHash<QString, quint16> terminatorIds;
+
+	quint16 internTerminator(const QString& terminator)
+	{
+		QMutexLocker locker(&terminatorMutex);
+		quint16 id = terminatorIds.value(terminator);
+		if (id == 0)
+		{
+			if (terminators.size() >= maxTerminators)
+			{
+				return unknownTerminator;
+			}
+			terminators.append(terminator);
+			id = quint16(terminators.size());
+			terminatorIds.insert(terminator, id);
+		}
+		return id;
+	}
+
+	// Empty for unknownTerminator
+	QString terminatorFor(quint16 id)
+	{
+		QMutexLocker locker(&terminatorMutex);
+		return id > 0 && id <= terminators.size() ? terminators[id - 1] : QString();
+	}
+
+	// Identifiers, numbers and whitespace, entered from start; returns the identifier state
+	quint8 addWords(Lexer& lexer, quint8 start, quint8 after = 0)
+	{
+		quint8 identifier = lexer.addState(Style::Normal, Lexer::Accepting | Lexer::Identifier, after);
+		lexer.on(start, Letter, identifier);
+		lexer.on(identifier, Letter, identifier);
+		lexer.on(identifier, Digit, identifier);
+
+		// Suffixes, hex digits and exponents stay part of the number
+		quint8 number = lexer.addState(Style::Number, Lexer::Accepting, after);
+		lexer.on(start, Digit, number);
+		lexer.on(number, Digit, number);
+		lexer.on(number, Letter, number);
+		lexer.on(number, Dot, number);
+
+		quint8 space = lexer.addState(Style::Normal, Lexer::Accepting | Lexer::Whitespace, after);
+		lexer.on(start, Space, space);
+		lexer.on(space, Space, space);
+		return identifier;
+	}
+
+	// A literal between two quote characters with backslash escapes; returns the state inside it
+	quint8 addQuoted(Lexer& lexer, quint8 start, CharClass quote, bool multiLine, quint8 after = 0)
+	{
+		quint8 body = lexer.addState(Style::String, 0, after);
+		quint8 escape = lexer.addState(Style::String, 0, after);
+		quint8 end = lexer.addState(Style::String, Lexer::Accepting, after);
+		if (multiLine)
+		{
+			lexer.setCarry(body, body);
+			lexer.setCarry(escape, body);
+		}
+
+		lexer.on(start, quote, body);
+		lexer.onAny(body, body);
+		lexer.on(body, quote, end);
+		lexer.on(body, Backslash, escape);
+		lexer.onAny(escape, body);
+		return body;
+	}
+
+	// Python strings: "..." on one line, or """...""" across lines
+	void addTripleQuoted(Lexer& lexer, quint8 start, CharClass quote)
+	{
+		quint8 open = lexer.addState(Style::String, 0);
+		quint8 body = lexer.addState(Style::String, 0);
+		quint8 escape = lexer.addState(Style::String, 0);
+		quint8 end = lexer.addState(Style::String, Lexer::Accepting);
+		quint8 empty = lexer.addState(Style::String, Lexer::Accepting);
+
+		lexer.on(start, quote, open);
+		lexer.onAny(open, body);
+		lexer.on(open, quote, empty);
+		lexer.on(open, Backslash, escape);
+		lexer.onAny(body, body);
+		lexer.on(body, quote, end);
+		lexer.on(body, Backslash, escape);
+		lexer.onAny(escape, body);
+
+		quint8 triple = lexer.addState(Style::String, 0);
+		quint8 tripleEscape = lexer.addState(Style::String, 0);
+		quint8 oneQuote = lexer.addState(Style::String, 0);
+		quint8 twoQuotes = lexer.addState(Style::String, 0);
+		quint8 tripleEnd = lexer.addState(Style::String, Lexer::Accepting);
+		for (quint8 state : { triple, tripleEscape, oneQuote, twoQuotes })
+		{
+			lexer.setCarry(state, triple);
+		}
+
+		lexer.on(empty, quote, triple);
+		lexer.onAny(triple, triple);
+		lexer.on(triple, quote, oneQuote);
+		lexer.on(triple, Backslash, tripleEscape);
+		lexer.onAny(tripleEscape, triple);
+		lexer.onAny(oneQuote, triple);
+		lexer.on(oneQuote, quote, twoQuotes);
+		lexer.onAny(twoQuotes, triple);
+		lexer.on(twoQuotes, quote, tripleEnd);
+	}
+
+	// Comment running to the end of the line
+	void addLineComment(Lexer& lexer, quint8 from, CharClass cls)
+	{
+		quint8 comment = lexer.addState(Style::Comment, Lexer::Accepting);
+		lexer.on(from, cls, comment);
+		lexer.onAny(comment, comment);
+	}
+
+	// "//" and "/* */" comments; a lone slash is an operator
+	void addSlashComments(Lexer& lexer, quint8 start, bool nested = false)
+	{
+		quint8 slash = lexer.addState(Style::Normal, Lexer::Accepting);
+		lexer.on(start, Slash, slash);
+		addLineComment(lexer, slash, Slash);
+
+		quint8 block = lexer.addState(Style::Comment, 0);
+		quint8 star = lexer.addState(Style::Comment, 0);
+		quint8 end = lexer.addState(Style::Comment, nested ? Lexer::Accepting | Lexer::PopDepth : Lexer::Accepting);
+		lexer.setCarry(block, block);
+		lexer.setCarry(star, block);
+
+		lexer.on(slash, Star, block);
+		lexer.onAny(block, block);
+		lexer.on(block, Star, star);
+		lexer.onAny(star, block);
+		lexer.on(star, Star, star);
+		lexer.on(star, Slash, end);
+
+		if (nested)
+		{
+			// "/*" inside the comment opens another level and "*/" closes it
+			quint8 innerSlash = lexer.addState(Style::Comment, 0);
+			quint8 innerOpen = lexer.addState(Style::Comment, Lexer::PushDepth);
+			lexer.setCarry(innerSlash, block);
+			lexer.setCarry(innerOpen, block);
+			lexer.setCarry(end, block);
+			lexer.on(block, Slash, innerSlash);
+			lexer.copyTransitions(innerSlash, block);
+			lexer.copyTransitions(innerOpen, block);
+			lexer.on(innerSlash, Star, innerOpen);
+			lexer.on(star, Slash, end);
+		}
+	}
+
+	// Any other character is a one-character token
+	void addPunctuation(Lexer& lexer, quint8 start, quint8 after = 0, Style style = Style::Normal)
+	{
+		quint8 punctuation = lexer.addState(style, Lexer::Accepting, after);
+		lexer.onOther(start, punctuation);
+	}
+
+	Lexer buildCLike(const QString& name, bool templateLiterals)
+	{
+		Lexer lexer(name);
+		quint8 start = lexer.addState(Style::Normal, 0);
+		quint8 identifier = addWords(lexer, start);
+		addSlashComments(lexer, start);
+		addQuoted(lexer, start, DoubleQuote, false);
+		addQuoted(lexer, start, SingleQuote, false);
+		if (templateLiterals)
+		{
+			lexer.on(start, Dollar, identifier);
+			lexer.on(identifier, Dollar, identifier);
+
+			// `text ${expression} text`: the expression is lexed as code until its closing brace
+			quint8 body = addQuoted(lexer, start, Backtick, true);
+			quint8 dollar = lexer.addState(Style::String, 0);
+			quint8 interpolation = lexer.addState(Style::String, Lexer::Accepting | Lexer::OpenInterpolation);
+			lexer.setCarry(dollar, body);
+			lexer.on(body, Dollar, dollar);
+			lexer.copyTransitions(dollar, body);
+			lexer.on(dollar, LeftBrace, interpolation);
+
+			quint8 openBrace = lexer.addState(Style::Normal, Lexer::Accepting | Lexer::OpenBrace);
+			quint8 closeBrace = lexer.addState(Style::Normal, Lexer::Accepting | Lexer::CloseBrace);
+			lexer.setCarry(closeBrace, body);
+			lexer.on(start, LeftBrace, openBrace);
+			lexer.on(start, RightBrace, closeBrace);
+		}
+		addPunctuation(lexer, start);
+		lexer.setCallsAreFunctions(true);
+		return lexer;
+	}
+
+	Lexer buildCpp()
+	{
+		Lexer lexer = buildCLike("cpp", false);
+		lexer.setKeywords({
+			"char", "class", "const", "double", "enum", "explicit", "friend", "inline", "int", "long",
+			"namespace", "operator", "private", "protected", "public", "short", "signals", "signed", "slots", "static",
+			"struct", "template", "typedef", "typename", "union", "unsigned", "virtual", "void", "volatile", "bool",
+			"if", "else", "for", "while", "do", "switch", "case", "break", "continue", "return",
+			"goto", "try", "catch", "throw", "new", "delete", "sizeof", "this", "true", "false",
+			"nullptr", "null", "auto", "using"
+		});
+		lexer.setTypeRule(Lexer::TypeRule::QPrefix);
+		lexer.setRawStrings(Lexer::RawStrings::Cpp);
+		return lexer;
+	}
+
+	Lexer buildJava()
+	{
+		Lexer lexer = buildCLike("java", false);
+		lexer.setKeywords({
+			"public", "private", "protected", "static", "final", "class", "interface", "extends", "implements", "package",
+			"import", "if", "else", "for", "while", "do", "switch", "case", "break", "continue",
+			"return", "try", "catch", "finally", "throw", "throws", "new", "this", "super", "true",
+			"false", "null", "int", "void", "boolean", "char", "double", "float", "long", "short",
+			"byte"
+		});
+		lexer.setTypeRule(Lexer::TypeRule::Capitalized);
+		return lexer;
+	}
+
+	Lexer buildJavaScript()
+	{
+		Lexer lexer = buildCLike("javascript", true);
+		lexer.setKeywords({
+			"function", "var", "let", "const", "if", "else", "for", "while", "do", "switch",
+			"case", "break", "continue", "return", "try", "catch", "finally", "throw", "new", "this",
+			"true", "false", "null", "undefined", "typeof", "instanceof", "in", "class", "extends", "super",
+			"import", "export", "default", "async", "await"
+		});
+		lexer.setDefiner("function");
+		lexer.setCallsAreFunctions(false);
+		return lexer;
+	}
+
+	Lexer buildPython()
+	{
+		Lexer lexer("python");
+		quint8 start = lexer.addState(Style::Normal, 0);
+		addWords(lexer, start);
+		addLineComment(lexer, start, Hash);
+		addTripleQuoted(lexer, start, DoubleQuote);
+		addTripleQuoted(lexer, start, SingleQuote);
+		addPunctuation(lexer, start);
+
+		lexer.setKeywords({
+			"def", "class", "if", "else", "elif", "for", "while", "return", "import", "from",
+			"as", "try", "except", "finally", "raise", "with", "pass", "break", "continue", "True",
+			"False", "None", "and", "or", "not", "in", "is", "lambda", "yield", "global",
+			"nonlocal"
+		});
+		lexer.setDefiner("def");
+		return lexer;
+	}
+
+	Lexer buildRust()
+	{
+		Lexer lexer("rust");
+		quint8 start = lexer.addState(Style::Normal, 0);
+		addWords(lexer, start);
+		addSlashComments(lexer, start, true);
+		addQuoted(lexer, start, DoubleQuote, true);
+
+		// 'c', '\n', '\u{1F600}' and lifetimes ('a, 'static)
+		quint8 quote = lexer.addState(Style::String, 0);
+		quint8 character = lexer.addState(Style::String, 0);
+		quint8 escape = lexer.addState(Style::String, 0);
+		quint8 escaped = lexer.addState(Style::String, 0);
+		quint8 lifetime = lexer.addState(Style::Type, Lexer::Accepting);
+		quint8 end = lexer.addState(Style::String, Lexer::Accepting);
+		lexer.on(start, SingleQuote, quote);
+		lexer.onAny(quote, character);
+		lexer.on(quote, Letter, lifetime);
+		lexer.on(quote, Backslash, escape);
+		lexer.on(character, NonAscii, character);
+		lexer.on(character, SingleQuote, end);
+		lexer.onAny(escape, escaped);
+		lexer.onAny(escaped, escaped);
+		lexer.on(escaped, SingleQuote, end);
+		lexer.on(lifetime, Letter, lifetime);
+		lexer.on(lifetime, Digit, lifetime);
+		lexer.on(lifetime, SingleQuote, end);
+		addPunctuation(lexer, start);
+
+		lexer.setKeywords({
+			"as", "async", "await", "break", "const", "continue", "crate", "dyn", "else", "enum",
+			"extern", "false", "fn", "for", "if", "impl", "in", "let", "loop", "match",
+			"mod", "move", "mut", "pub", "ref", "return", "self", "Self", "static", "struct",
+			"super", "trait", "true", "type", "unsafe", "use", "where", "while"
+		});
+		lexer.setDefiner("fn");
+		lexer.setTypeRule(Lexer::TypeRule::Capitalized);
+		lexer.setCallsAreFunctions(true);
+		lexer.setRawStrings(Lexer::RawStrings::Rust);
+		return lexer;
+	}
+
+	Lexer buildHtml()
+	{
+		Lexer lexer("html");
+		quint8 text = lexer.addState(Style::Normal, 0);
+		quint8 inTag = lexer.addState(Style::Normal, 0);
+
+		// Text between tags
+		quint8 textRun = lexer.addState(Style::Normal, Lexer::Accepting, text);
+		lexer.onAny(text, textRun);
+		lexer.onAny(textRun, textRun);
+		lexer.on(textRun, Less, Lexer::reject);
+		lexer.on(textRun, Amp, Lexer::reject);
+
+		// Entities: &name; or &#123;
+		quint8 amp = lexer.addState(Style::Normal, 0, text);
+		quint8 entityName = lexer.addState(Style::Normal, 0, text);
+		quint8 entity = lexer.addState(Style::Entity, Lexer::Accepting, text);
+		lexer.on(text, Amp, amp);
+		lexer.on(amp, Letter, entityName);
+		lexer.on(amp, Hash, entityName);
+		lexer.on(entityName, Letter, entityName);
+		lexer.on(entityName, Digit, entityName);
+		lexer.on(entityName, Semicolon, entity);
+
+		// "<name", "</name" and "<!DOCTYPE" switch to the tag context
+		quint8 tagOpen = lexer.addState(Style::Tag, Lexer::Accepting, inTag);
+		quint8 tagName = lexer.addState(Style::Tag, Lexer::Accepting, inTag);
+		quint8 bang = lexer.addState(Style::Tag, Lexer::Accepting, inTag);
+		lexer.on(text, Less, tagOpen);
+		lexer.on(tagOpen, Slash, tagOpen);
+		lexer.on(tagOpen, Letter, tagName);
+		lexer.on(tagOpen, Bang, bang);
+		lexer.on(tagName, Letter, tagName);
+		lexer.on(tagName, Digit, tagName);
+		lexer.on(tagName, Dash, tagName);
+		lexer.on(bang, Letter, tagName);
+
+		// <!-- ... -->
+		quint8 bangDash = lexer.addState(Style::Tag, 0, inTag);
+		quint8 comment = lexer.addState(Style::Comment, 0, text);
+		quint8 commentDash = lexer.addState(Style::Comment, 0, text);
+		quint8 commentDashes = lexer.addState(Style::Comment, 0, text);
+		quint8 commentEnd = lexer.addState(Style::Comment, Lexer::Accepting, text);
+		for (quint8 state : { comment, commentDash, commentDashes })
+		{
+			lexer.setCarry(state, comment);
+		}
+		lexer.on(bang, Dash, bangDash);
+		lexer.on(bangDash, Dash, comment);
+		lexer.onAny(comment, comment);
+		lexer.on(comment, Dash, commentDash);
+		lexer.onAny(commentDash, comment);
+		lexer.on(commentDash, Dash, commentDashes);
+		lexer.onAny(commentDashes, comment);
+		lexer.on(commentDashes, Dash, commentDashes);
+		lexer.on(commentDashes, Greater, commentEnd);
+
+		// Inside a tag: attributes, quoted values, and the closing ">" back to text
+		quint8 tagSpace = lexer.addState(Style::Normal, Lexer::Accepting | Lexer::Whitespace, inTag);
+		quint8 attribute = lexer.addState(Style::Tag, Lexer::Accepting, inTag);
+		quint8 tagSlash = lexer.addState(Style::Tag, Lexer::Accepting, inTag);
+		quint8 tagClose = lexer.addState(Style::Tag, Lexer::Accepting, text);
+		lexer.on(inTag, Space, tagSpace);
+		lexer.on(tagSpace, Space, tagSpace);
+		lexer.on(inTag, Letter, attribute);
+		lexer.on(attribute, Letter, attribute);
+		lexer.on(attribute, Digit, attribute);
+		lexer.on(attribute, Dash, attribute);
+		lexer.on(inTag, Slash, tagSlash);
+		lexer.on(tagSlash, Greater, tagClose);
+		lexer.on(inTag, Greater, tagClose);
+		addQuoted(lexer, inTag, DoubleQuote, false, inTag);
+		addQuoted(lexer, inTag, SingleQuote, false, inTag);
+		addPunctuation(lexer, inTag, inTag, Style::Tag);
+		return lexer;
+	}
+
+}; // namespace
+
+Lexer::Lexer(const QString& name)
+	: name(name), typeRule(TypeRule::None), callsAreFunctions(false), rawStrings(RawStrings::None), rawStringState(0)
+{
+}
+
+const Lexer* Lexer::forLanguage(const QString& language)
+{
+	// Built once and never modified, so they can be shared between threads
+	static const Lexer cpp = buildCpp();
+	static const Lexer python = buildPython();
+	static const Lexer java = buildJava();
+	static const Lexer javaScript = buildJavaScript();
+	static const Lexer html = buildHtml();
+	static const Lexer rust = buildRust();
+
+	for (const Lexer* lexer : { &cpp, &python, &java, &javaScript, &html, &rust })
+	{
+		if (lexer->name == language)
+		{
+			return lexer;
+		}
+	}
+	return nullptr;
+}
+
+CharClass Lexer::classOf(QChar c)
+{
+	char16_t u = c.unicode();
+	return u < 128 ? CharClass(classTable[u]) : NonAscii;
+}
+
+QString Lexer::getName() const
+{
+	return name;
+}
+
+int Lexer::tokenize(QStringView text, int state, QVector<Token>& tokens) const
+{
+	LexState lex = LexState::unpack(state);
+	if (lex.dfa >= states.size())
+	{
+		lex = {};
+	}
+	quint8 current = lex.dfa;
+	const qsizetype length = text.size();
+	bool expectFunctionName = false;
+
+	qsizetype pos = 0;
+	while (pos < length)
+	{
+		const qsizetype start = pos;
+		QString terminator;
+		qsizetype rawFrom = -1;
+		if (rawStrings != RawStrings::None && current == rawStringState)
+		{
+			terminator = terminatorFor(lex.payload);
+			rawFrom = pos;
+		}
+		else
+		{
+			quint8 scan = current;
+			quint8 depth = lex.depth;
+			qsizetype acceptEnd = -1;
+			quint8 acceptState = 0;
+			quint8 acceptDepth = depth;
+			while (pos < length)
+			{
+				quint8 next = transitions[scan * CharClassCount + classOf(text[pos])];
+				if (next == reject)
+				{
+					break;
+				}
+				++pos;
+				const State& entered = states[next];
+				if ((entered.flags & PushDepth) && depth < maxDepth)
+				{
+					++depth;
+				}
+				else if ((entered.flags & PopDepth) && depth > 0)
+				{
+					// Only an inner level was closed, the outer one goes on
+					--depth;
+					next = entered.carry;
+				}
+				scan = next;
+				if (states[scan].flags & Accepting)
+				{
+					acceptEnd = pos;
+					acceptState = scan;
+					acceptDepth = depth;
+				}
+			}
+
+			// An open comment or string at the end of the block continues in the next one
+			if (pos == length && !(states[scan].flags & Accepting) && states[scan].carry != noCarry)
+			{
+				if (states[scan].style != Style::Normal)
+				{
+					tokens.append({ int(start), int(length - start), states[scan].style });
+				}
+				return LexState{ states[scan].carry, depth, lex.payload }.pack();
+			}
+
+			if (acceptEnd < 0)
+			{
+				if (pos == start)
+				{
+					// No transition for this character at all
+					++pos;
+					continue;
+				}
+				// Unterminated literal: highlight what there is
+				acceptEnd = pos;
+				acceptState = scan;
+				acceptDepth = depth;
+			}
+
+			pos = acceptEnd;
+			lex.depth = acceptDepth;
+			const State& accepted = states[acceptState];
+			Style style = accepted.style;
+			quint8 next = accepted.after;
+			if (accepted.flags & Identifier)
+			{
+				if (rawStrings != RawStrings::None)
+				{
+					rawFrom = openRawString(text, start, acceptEnd, terminator);
+				}
+				if (rawFrom < 0)
+				{
+					style = classifyIdentifier(text, start, acceptEnd, expectFunctionName);
+				}
+			}
+			else if (!(accepted.flags & Whitespace))
+			{
+				expectFunctionName = false;
+			}
+
+			// Braces are only counted inside interpolations, one payload bit each: set for "${"
+			if ((accepted.flags & (OpenInterpolation | OpenBrace)) && lex.depth < maxBraceDepth)
+			{
+				if (accepted.flags & OpenInterpolation)
+				{
+					lex.payload |= quint16(1u << lex.depth);
+					++lex.depth;
+				}
+				else if (lex.depth > 0)
+				{
+					++lex.depth;
+				}
+			}
+			else if ((accepted.flags & CloseBrace) && lex.depth > 0)
+			{
+				--lex.depth;
+				const quint16 bit = quint16(1u << lex.depth);
+				if (lex.payload & bit)
+				{
+					lex.payload &= quint16(~bit);
+					style = Style::String;
+					next = accepted.carry;
+				}
+			}
+
+			if (rawFrom < 0)
+			{
+				if (style != Style::Normal)
+				{
+					tokens.append({ int(start), int(acceptEnd - start), style });
+				}
+				current = next;
+				continue;
+			}
+		}
+
+		// Raw string: no escapes, it only ends at its terminator
+		qsizetype closeLength = terminator.size();
+		qsizetype close = terminator.isEmpty() ? findRawStringEnd(text, rawFrom, closeLength) : text.indexOf(terminator, rawFrom);
+		if (close < 0)
+		{
+			tokens.append({ int(start), int(length - start), Style::String });
+			quint16 id = terminator.isEmpty() ? unknownTerminator : internTerminator(terminator);
+			return LexState{ rawStringState, 0, id }.pack();
+		}
+		pos = close + closeLength;
+		if (pos > start)
+		{
+			tokens.append({ int(start), int(pos - start), Style::String });
+		}
+		current = 0;
+		lex.payload = 0;
+		expectFunctionName = false;
+	}
+
+	lex.dfa = current;
+	return lex.pack();
+}
+
+qsizetype Lexer::openRawString(QStringView text, qsizetype start, qsizetype end, QString& terminator) const
+{
+	QStringView prefix = text.sliced(start, end - start);
+	switch (rawStrings)
+	{
+		case RawStrings::None: break;
+		case RawStrings::Cpp:
+		{
+			if (end >= text.size() || text[end] != u'"' || !(prefix == u"R" || prefix == u"LR" || prefix == u"uR" || prefix == u"UR" || prefix == u"u8R"))
+			{
+				break;
+			}
+			// The delimiter is at most 16 characters long and ends at '('
+			for (qsizetype i = end + 1; i < text.size() && i <= end + 17; ++i)
+			{
+				QChar c = text[i];
+				if (c == u'(')
+				{
+					terminator = ')' + text.sliced(end + 1, i - end - 1).toString() + '"';
+					return i + 1;
+				}
+				if (c == u')' || c == u'\\' || c.isSpace())
+				{
+					break;
+				}
+			}
+			break;
+		}
+		case RawStrings::Rust:
+		{
+			if (prefix != u"r" && prefix != u"br")
+			{
+				break;
+			}
+			qsizetype i = end;
+			while (i < text.size() && text[i] == u'#')
+			{
+				++i;
+			}
+			if (i < text.size() && text[i] == u'"')
+			{
+				terminator = '"' + text.sliced(end, i - end).toString();
+				return i + 1;
+			}
+			break;
+		}
+	}
+	return -1;
+}
+
+qsizetype Lexer::findRawStringEnd(QStringView text, qsizetype from, qsizetype& length) const
+{
+	for (qsizetype i = from; i < text.size(); ++i)
+	{
+		if (rawStrings == RawStrings::Cpp && text[i] == u')')
+		{
+			// Any delimiter: up to 16 characters other than parentheses, backslash and spaces, then '"'
+			for (qsizetype j = i + 1; j < text.size() && j <= i + 17; ++j)
+			{
+				QChar c = text[j];
+				if (c == u'"')
+				{
+					length = j + 1 - i;
+					return i;
+				}
+				if (c == u'(' || c == u')' || c == u'\\' || c.isSpace())
+				{
+					break;
+				}
+			}
+		}
+		else if (rawStrings == RawStrings::Rust && text[i] == u'"')
+		{
+			qsizetype j = i + 1;
+			while (j < text.size() && text[j] == u'#')
+			{
+				++j;
+			}
+			length = j - i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+Style Lexer::classifyIdentifier(QStringView text, qsizetype start, qsizetype end, bool& expectFunctionName) const
+{
+	QStringView word = text.sliced(start, end - start);
+	if (keywords.contains(word))
+	{
+		expectFunctionName = !definer.isEmpty() && word == definer;
+		return Style::Keyword;
+	}
+
+	if (expectFunctionName)
+	{
+		expectFunctionName = false;
+		return Style::Function;
+	}
+
+	if (callsAreFunctions && end < text.size() && text[end] == u'(')
+	{
+		return Style::Function;
+	}
+
+	switch (typeRule)
+	{
+		case TypeRule::None: break;
+		case TypeRule::QPrefix:
+			if (word.size() > 1 && word[0] == u'Q' && std::all_of(word.begin() + 1, word.end(), [](QChar c) { return c.isLetter(); }))
+			{
+				return Style::Type;
+			}
+			break;
+		case TypeRule::Capitalized:
+			if (word[0] >= u'A' && word[0] <= u'Z')
+			{
+				return Style::Type;
+			}
+			break;
+	}
+	return Style::Normal;
+}
+
+quint8 Lexer::addState(Style style, quint8 flags, quint8 after)
+{
+	Q_ASSERT(states.size() < reject);
+	states.append({ style, flags, after, noCarry });
+	transitions.resize(states.size() * CharClassCount, reject);
+	return quint8(states.size() - 1);
+}
+
+void Lexer::setCarry(quint8 state, quint8 carry)
+{
+	states[state].carry = carry;
+}
+
+void Lexer::on(quint8 from, CharClass cls, quint8 to)
+{
+	transitions[from * CharClassCount + cls] = to;
+}
+
+void Lexer::onAny(quint8 from, quint8 to)
+{
+	std::fill_n(transitions.begin() + from * CharClassCount, CharClassCount, to);
+}
+
+void Lexer::onOther(quint8 from, quint8 to)
+{
+	auto row = transitions.begin() + from * CharClassCount;
+	std::replace(row, row + CharClassCount, reject, to);
+}
+
+void Lexer::copyTransitions(quint8 to, quint8 from)
+{
+	std::copy_n(transitions.begin() + from * CharClassCount, CharClassCount, transitions.begin() + to * CharClassCount);
+}
+
+void Lexer::setKeywords(const QStringList& keywords)
+{
+	this->keywords = KeywordMatcher(keywords);
+}
+
+void Lexer::setDefiner(const QString& keyword)
+{
+	definer = keyword;
+}
+
+void Lexer::setTypeRule(TypeRule rule)
+{
+	typeRule = rule;
+}
+
+void Lexer::setCallsAreFunctions(bool enabled)
+{
+	callsAreFunctions = enabled;
+}
+
+void Lexer::setRawStrings(RawStrings syntax)
+{
+	rawStrings = syntax;
+	if (syntax != RawStrings::None && rawStringState == 0)
+	{
+		// Has no transitions: tokenize() searches for the terminator instead
+		rawStringState = addState(Style::String, 0);
+	}
+}
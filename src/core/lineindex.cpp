@@ -0,0 +1,251 @@
+#include "core/lineindex.hpp"
+#include "core/simd.hpp"
+#include <algorithm>
+#include <bit>
+
+LineIndex::LineIndex() : chunks{ Chunk{ 0, 0, { 0 } } }, pendingChunk(1), pendingDelta(0), pendingLines(0)
+{
+}
+
+void LineIndex::reset(const PieceTable& text)
+{
+	QList<qsizetype> lineStarts = { 0 };
+	qsizetype base = 0;
+	text.forEachChunk(
+	    [&lineStarts, &base](QStringView chunk)
+	    {
+		    findNewlines(chunk, base, lineStarts);
+		    base += chunk.size();
+		    return true;
+	    });
+
+	// Each newline starts the line after it
+	for (qsizetype i = 1; i < lineStarts.size(); ++i)
+	{
+		++lineStarts[i];
+	}
+
+	chunks.clear();
+	for (qsizetype first = 0; first < lineStarts.size(); first += chunkSize)
+	{
+		Chunk chunk{ first, lineStarts[first], {} };
+		qsizetype count = std::min(chunkSize, lineStarts.size() - first);
+		chunk.starts.reserve(count);
+		for (qsizetype i = first; i < first + count; ++i)
+		{
+			chunk.starts.append(lineStarts[i] - chunk.base);
+		}
+		chunks.append(std::move(chunk));
+	}
+	pendingChunk = chunks.size();
+	pendingDelta = 0;
+	pendingLines = 0;
+}
+
+void LineIndex::replace(qsizetype pos, qsizetype removed, QStringView inserted)
+{
+	qsizetype first = firstLineAfter(pos);
+	qsizetype last = firstLineAfter(pos + removed);
+
+	// The chunk holding the line before the edit keeps that line, so it never runs empty
+	qsizetype chunk = chunkOfLine(first - 1);
+	qsizetype lastChunk = last > first ? chunkOfLine(last - 1) : chunk;
+	movePending(lastChunk + 1);
+
+	Chunk& head = chunks[chunk];
+	qsizetype local = first - head.firstLine;
+
+	// Lines that started inside the removed text are gone; those left in the last chunk they reached join the head
+	if (lastChunk == chunk)
+	{
+		head.starts.remove(local, last - first);
+	}
+	else
+	{
+		const Chunk& tail = chunks[lastChunk];
+		head.starts.resize(local);
+		for (qsizetype i = last - tail.firstLine; i < tail.starts.size(); ++i)
+		{
+			head.starts.append(tail.base + tail.starts[i] - head.base);
+		}
+		chunks.remove(chunk + 1, lastChunk - chunk);
+	}
+	Chunk& edited = chunks[chunk];
+
+	qsizetype delta = inserted.size() - removed;
+	for (qsizetype i = local; i < edited.starts.size(); ++i)
+	{
+		edited.starts[i] += delta;
+	}
+
+	QList<qsizetype> newlines;
+	findNewlines(inserted, pos + 1 - edited.base, newlines);
+	if (!newlines.isEmpty())
+	{
+		edited.starts.insert(local, newlines.size(), 0);
+		std::copy(newlines.cbegin(), newlines.cend(), edited.starts.begin() + local);
+	}
+
+	// Everything after the edited chunk is shifted through the pending deltas
+	pendingChunk = chunk + 1;
+	pendingDelta += delta;
+	pendingLines += newlines.size() - (last - first);
+
+	if (edited.starts.size() > 2 * chunkSize)
+	{
+		splitChunk(chunk);
+	}
+}
+
+qsizetype LineIndex::lineCount() const
+{
+	return chunkFirstLine(chunks.size() - 1) + chunks.last().starts.size();
+}
+
+qsizetype LineIndex::lineStart(qsizetype line) const
+{
+	qsizetype chunk = chunkOfLine(line);
+	return chunkBase(chunk) + chunks[chunk].starts[line - chunkFirstLine(chunk)];
+}
+
+qsizetype LineIndex::lineAt(qsizetype pos) const
+{
+	return firstLineAfter(pos) - 1;
+}
+
+qsizetype LineIndex::chunkFirstLine(qsizetype chunk) const
+{
+	return chunks[chunk].firstLine + (chunk >= pendingChunk ? pendingLines : 0);
+}
+
+qsizetype LineIndex::chunkBase(qsizetype chunk) const
+{
+	return chunks[chunk].base + (chunk >= pendingChunk ? pendingDelta : 0);
+}
+
+qsizetype LineIndex::chunkOfLine(qsizetype line) const
+{
+	// Last chunk starting at or before line
+	qsizetype low = 1;
+	qsizetype high = chunks.size();
+	while (low < high)
+	{
+		qsizetype middle = low + (high - low) / 2;
+		if (chunkFirstLine(middle) <= line)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low - 1;
+}
+
+void LineIndex::movePending(qsizetype chunk)
+{
+	// Writes the deltas out over the chunks between the old and the new edit position
+	for (qsizetype i = pendingChunk; i < chunk; ++i)
+	{
+		chunks[i].base += pendingDelta;
+		chunks[i].firstLine += pendingLines;
+	}
+	for (qsizetype i = chunk; i < pendingChunk; ++i)
+	{
+		chunks[i].base -= pendingDelta;
+		chunks[i].firstLine -= pendingLines;
+	}
+	pendingChunk = chunk;
+}
+
+void LineIndex::splitChunk(qsizetype chunk)
+{
+	// Called right after an edit, with the chunk written out and the ones after it pending
+	Chunk& large = chunks[chunk];
+	QList<Chunk> pieces;
+	for (qsizetype first = chunkSize; first < large.starts.size(); first += chunkSize)
+	{
+		Chunk piece{ large.firstLine + first, large.base + large.starts[first], {} };
+		qsizetype count = std::min(chunkSize, large.starts.size() - first);
+		piece.starts.reserve(count);
+		for (qsizetype i = first; i < first + count; ++i)
+		{
+			piece.starts.append(large.base + large.starts[i] - piece.base);
+		}
+		pieces.append(std::move(piece));
+	}
+	large.starts.resize(chunkSize);
+
+	chunks.insert(chunk + 1, pieces.size(), Chunk());
+	std::move(pieces.begin(), pieces.end(), chunks.begin() + chunk + 1);
+	pendingChunk += pieces.size();
+}
+
+qsizetype LineIndex::firstLineAfter(qsizetype pos) const
+{
+	// Last chunk whose first line starts at or before pos; line 0 starts at 0, so there is one
+	qsizetype low = 1;
+	qsizetype high = chunks.size();
+	while (low < high)
+	{
+		qsizetype middle = low + (high - low) / 2;
+		if (chunkBase(middle) <= pos)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	qsizetype chunk = low - 1;
+
+	const QList<qsizetype>& starts = chunks[chunk].starts;
+	auto after = std::upper_bound(starts.cbegin(), starts.cend(), pos - chunkBase(chunk));
+	return chunkFirstLine(chunk) + (after - starts.cbegin());
+}
+
+void LineIndex::findNewlines(QStringView text, qsizetype base, QList<qsizetype>& positions)
+{
+	const char16_t* data = text.utf16();
+	const qsizetype length = text.size();
+	qsizetype i = 0;
+
+	// Each matching code unit sets two adjacent bits of the byte mask
+#if defined(NOTER_SIMD_AVX2)
+	const __m256i newline256 = _mm256_set1_epi16('\n');
+	for (; i + 16 <= length; i += 16)
+	{
+		__m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		quint32 mask = quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi16(units, newline256)));
+		while (mask != 0)
+		{
+			positions.append(base + i + std::countr_zero(mask) / 2);
+			mask &= mask - 1;
+			mask &= mask - 1;
+		}
+	}
+#endif
+#if defined(NOTER_SIMD_SSE2)
+	const __m128i newline128 = _mm_set1_epi16('\n');
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		quint32 mask = quint32(_mm_movemask_epi8(_mm_cmpeq_epi16(units, newline128)));
+		while (mask != 0)
+		{
+			positions.append(base + i + std::countr_zero(mask) / 2);
+			mask &= mask - 1;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < length; ++i)
+	{
+		if (data[i] == u'\n')
+		{
+			positions.append(base + i);
+		}
+	}
+}
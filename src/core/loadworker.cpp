@@ -0,0 +1,122 @@
+#include "core/loadworker.hpp"
+#include "core/compressiondevice.hpp"
+#include "core/mappedfile.hpp"
+#include <QDebug>
+#include <QFile>
+#include <algorithm>
+
+namespace
+{
+	constexpr qsizetype detectionSampleSize = 64 * 1024;
+
+}; // namespace
+
+LoadWorker::LoadWorker(QObject* parent) : QObject(parent), activeRequest(0)
+{
+}
+
+quint64 LoadWorker::nextRequest()
+{
+	return ++activeRequest;
+}
+
+void LoadWorker::cancel()
+{
+	++activeRequest;
+}
+
+void LoadWorker::load(quint64 request, const QString& filePath)
+{
+	if (compression::detectFile(filePath) != compression::Format::None)
+	{
+		loadCompressed(request, filePath);
+		return;
+	}
+
+	MappedFile file(chunkSize);
+	if (!file.open(filePath))
+	{
+		emit finished(request, false, filePath, "Cannot read the file", textcodec::Detection());
+		return;
+	}
+
+	while (!file.atEnd())
+	{
+		if (activeRequest.load() != request)
+		{
+			qDebug() << "Load cancelled:" << filePath;
+			return;
+		}
+
+		QString chunk = file.readChunk();
+		emit chunkLoaded(request, chunk, file.offset(), file.size());
+	}
+
+	emit finished(request, true, filePath, QString(), file.encoding());
+}
+
+void LoadWorker::loadCompressed(quint64 request, const QString& filePath)
+{
+	QFile file(filePath);
+	CompressionDevice input(&file);
+	if (!file.open(QIODeviceBase::ReadOnly) || !input.open(QIODeviceBase::ReadOnly))
+	{
+		emit finished(request, false, filePath, "Cannot read the file", textcodec::Detection());
+		return;
+	}
+
+	// Inflated bytes are collected until they hold complete lines; progress follows the compressed input
+	textcodec::Detection detection;
+	bool detected = false;
+	QByteArray pending;
+	QByteArray block(chunkSize, Qt::Uninitialized);
+	while (true)
+	{
+		if (activeRequest.load() != request)
+		{
+			qDebug() << "Load cancelled:" << filePath;
+			return;
+		}
+
+		qint64 read = input.read(block.data(), block.size());
+		if (read < 0)
+		{
+			emit finished(request, false, filePath, input.errorString(), textcodec::Detection());
+			return;
+		}
+		pending.append(block.constData(), read);
+		bool atEnd = read == 0;
+
+		if (!detected && (pending.size() >= detectionSampleSize || atEnd))
+		{
+			detection = textcodec::detectEncoding(QByteArrayView(pending).first(std::min(pending.size(), detectionSampleSize)));
+			pending.remove(0, detection.bomLength);
+			detected = true;
+		}
+
+		qsizetype length = 0;
+		if (detected)
+		{
+			length = atEnd ? pending.size() : textcodec::completeLinesLength(pending, detection.encoding);
+			// A line longer than a chunk is cut inside instead of being collected whole
+			if (length == 0 && pending.size() >= chunkSize)
+			{
+				length = textcodec::completeCharactersLength(pending, detection.encoding);
+			}
+		}
+		if (length > 0)
+		{
+			QString chunk = textcodec::decode(QByteArrayView(pending).first(length), detection.encoding);
+			chunk.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+			pending.remove(0, length);
+			emit chunkLoaded(request, chunk, file.pos(), file.size());
+		}
+
+		if (atEnd)
+		{
+			break;
+		}
+	}
+
+	emit finished(request, true, filePath, QString(), detection);
+}
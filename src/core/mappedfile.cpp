@@ -0,0 +1,162 @@
+#include "core/mappedfile.hpp"
+#include <QDebug>
+#include <QByteArrayView>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr qint64 detectionSampleSize = 64 * 1024;
+
+}; // namespace
+
+MappedFile::MappedFile(qint64 chunkSize) : data(nullptr), fileSize(0), readOffset(0), chunkSize(chunkSize)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const QString& filePath)
+{
+	close();
+
+	file.setFileName(filePath);
+	if (!file.open(QIODeviceBase::ReadOnly))
+	{
+		qDebug() << "Failed to open file for mapping:" << filePath;
+		return false;
+	}
+
+	fileSize = file.size();
+	if (fileSize > 0)
+	{
+		data = file.map(0, fileSize);
+		if (data == nullptr)
+		{
+			qDebug() << "Failed to map file:" << filePath << file.errorString();
+			file.close();
+			fileSize = 0;
+			return false;
+		}
+	}
+
+	detection = textcodec::detectEncoding(QByteArrayView(data, std::min(fileSize, detectionSampleSize)));
+	readOffset = detection.bomLength;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != nullptr)
+	{
+		file.unmap(const_cast<uchar*>(data));
+		data = nullptr;
+	}
+	if (file.isOpen())
+	{
+		file.close();
+	}
+	fileSize = 0;
+	readOffset = 0;
+	detection = textcodec::Detection();
+}
+
+bool MappedFile::isOpen() const
+{
+	return file.isOpen();
+}
+
+bool MappedFile::atEnd() const
+{
+	return readOffset >= fileSize;
+}
+
+qint64 MappedFile::size() const
+{
+	return fileSize;
+}
+
+qint64 MappedFile::offset() const
+{
+	return readOffset;
+}
+
+textcodec::Detection MappedFile::encoding() const
+{
+	return detection;
+}
+
+qint64 MappedFile::findChunkEnd(qint64 from) const
+{
+	qint64 end = std::min(from + chunkSize, fileSize);
+	if (end == fileSize)
+	{
+		return end;
+	}
+	if (textcodec::codeUnitSize(detection.encoding) == 2)
+	{
+		return findUtf16ChunkEnd(from, end);
+	}
+
+	// Prefer cutting right after the last newline inside the window
+	const uchar* first = data + from;
+	const uchar* last = data + end;
+	auto newline = std::find(std::make_reverse_iterator(last), std::make_reverse_iterator(first), uchar('\n'));
+	if (newline != std::make_reverse_iterator(first))
+	{
+		return (newline.base() - data);
+	}
+
+	// A single line longer than the window: extend up to its end
+	const void* next = std::memchr(last, '\n', size_t(fileSize - end));
+	if (next != nullptr)
+	{
+		return (static_cast<const uchar*>(next) - data) + 1;
+	}
+	return fileSize;
+}
+
+qint64 MappedFile::findUtf16ChunkEnd(qint64 from, qint64 end) const
+{
+	// Code units are aligned to the start of the text, which is even (BOM or none)
+	uchar newlineFirst = detection.encoding == textcodec::Encoding::Utf16LE ? '\n' : 0;
+	uchar newlineSecond = detection.encoding == textcodec::Encoding::Utf16LE ? 0 : '\n';
+	auto isNewline = [&](qint64 pos) { return data[pos] == newlineFirst && data[pos + 1] == newlineSecond; };
+
+	end = from + ((end - from) & ~qint64(1));
+	for (qint64 pos = end - 2; pos >= from; pos -= 2)
+	{
+		if (isNewline(pos))
+		{
+			return pos + 2;
+		}
+	}
+	for (qint64 pos = end; pos + 1 < fileSize; pos += 2)
+	{
+		if (isNewline(pos))
+		{
+			return pos + 2;
+		}
+	}
+	return fileSize;
+}
+
+QString MappedFile::readChunk()
+{
+	if (atEnd())
+	{
+		return QString();
+	}
+
+	qint64 end = findChunkEnd(readOffset);
+	QByteArrayView bytes(data + readOffset, end - readOffset);
+	readOffset = end;
+
+	QString chunk = textcodec::decode(bytes, detection.encoding);
+	chunk.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+	return chunk;
+}
@@ -0,0 +1,150 @@
+#include "core/matchfinder.hpp"
+#include <QThread>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	using Range = SearchIndex::Range;
+
+	struct Search
+	{
+		PieceTable text;
+		QString needle;
+		Qt::CaseSensitivity cs;
+		QList<QList<Range>> batches;
+		std::vector<QList<qsizetype>> hits;
+		std::atomic<qsizetype> remaining;
+	};
+
+	// Ranges longer than a batch are cut; each piece is read past its end so no match is lost
+	QList<QList<Range>> makeBatches(const QList<Range>& ranges)
+	{
+		QList<QList<Range>> batches;
+		qsizetype size = MatchFinder::batchChars;
+		for (Range range : ranges)
+		{
+			while (range.length > 0)
+			{
+				if (size >= MatchFinder::batchChars)
+				{
+					batches.append(QList<Range>());
+					size = 0;
+				}
+				qsizetype length = std::min(range.length, MatchFinder::batchChars - size);
+				batches.last().append({ range.start, length });
+				size += length;
+				range.start += length;
+				range.length -= length;
+			}
+		}
+		return batches;
+	}
+
+	void searchBatch(Search& search, qsizetype index, const std::atomic<quint64>& activeSearch, quint64 id)
+	{
+		const QStringView needle(search.needle);
+		QList<qsizetype>& hits = search.hits[index];
+		for (const Range& range : search.batches[index])
+		{
+			if (activeSearch.load(std::memory_order_relaxed) != id)
+			{
+				return;
+			}
+
+			qsizetype length = std::min(range.length + needle.size() - 1, search.text.length() - range.start);
+			const QString slice = search.text.slice(range.start, length);
+			for (qsizetype hit = QStringView(slice).indexOf(needle, 0, search.cs); hit >= 0 && hit < range.length;
+			     hit = QStringView(slice).indexOf(needle, hit + 1, search.cs))
+			{
+				hits.append(range.start + hit);
+			}
+		}
+	}
+
+	// Batches report overlapping matches too; they are dropped here as a search from the start would
+	QList<qsizetype> mergeHits(const Search& search)
+	{
+		qsizetype total = 0;
+		for (const QList<qsizetype>& hits : search.hits)
+		{
+			total += hits.size();
+		}
+
+		QList<qsizetype> starts;
+		starts.reserve(total);
+		for (const QList<qsizetype>& hits : search.hits)
+		{
+			for (qsizetype hit : hits)
+			{
+				if (starts.isEmpty() || hit >= starts.last() + search.needle.size())
+				{
+					starts.append(hit);
+				}
+			}
+		}
+		return starts;
+	}
+
+}; // namespace
+
+MatchFinder::MatchFinder(QObject* parent) : QObject(parent), activeSearch(0), searchCounter(0)
+{
+	// One core stays free for the GUI thread
+	pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+MatchFinder::~MatchFinder()
+{
+	cancel();
+	pool.clear();
+	pool.waitForDone();
+}
+
+quint64 MatchFinder::submit(const PieceTable& text, const QString& needle, Qt::CaseSensitivity cs, const QList<SearchIndex::Range>& ranges)
+{
+	quint64 id = ++searchCounter;
+	activeSearch = id;
+	pool.clear();
+
+	auto search = std::make_shared<Search>();
+	search->text = text;
+	search->needle = needle;
+	search->cs = cs;
+	if (!needle.isEmpty())
+	{
+		search->batches = makeBatches(ranges);
+	}
+	search->hits.resize(search->batches.size());
+	search->remaining = search->batches.size();
+
+	if (search->batches.isEmpty())
+	{
+		QMetaObject::invokeMethod(this, [this, id]() { emit found(id, QList<qsizetype>()); }, Qt::QueuedConnection);
+		return id;
+	}
+
+	for (qsizetype index = 0; index < search->batches.size(); ++index)
+	{
+		pool.start(
+		    [this, search, index, id]()
+		    {
+			    searchBatch(*search, index, activeSearch, id);
+			    if (--search->remaining > 0 || activeSearch != id)
+			    {
+				    return;
+			    }
+
+			    QList<qsizetype> starts = mergeHits(*search);
+			    QMetaObject::invokeMethod(
+			        this, [this, id, starts = std::move(starts)]() { emit found(id, starts); }, Qt::QueuedConnection);
+		    });
+	}
+	return id;
+}
+
+void MatchFinder::cancel()
+{
+	activeSearch = 0;
+	pool.clear();
+}
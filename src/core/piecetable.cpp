@@ -0,0 +1,289 @@
+#include "core/piecetable.hpp"
+
+PieceTable::PieceTable() : seed(0x9E3779B9u)
+{
+	reset();
+}
+
+PieceTable::PieceTable(const QString& original) : seed(0x9E3779B9u)
+{
+	reset(original);
+}
+
+void PieceTable::reset(const QString& original)
+{
+	buffers.clear();
+	buffers.append(original);
+	root = original.isEmpty() ? nullptr : makeNode(Piece { 0, 0, original.size() }, nextPriority(), nullptr, nullptr);
+}
+
+qsizetype PieceTable::length() const
+{
+	return lengthOf(root);
+}
+
+bool PieceTable::isEmpty() const
+{
+	return root == nullptr;
+}
+
+void PieceTable::insert(qsizetype pos, QStringView text)
+{
+	if (text.isEmpty())
+	{
+		return;
+	}
+	pos = std::clamp<qsizetype>(pos, 0, length());
+
+	NodePtr left;
+	NodePtr right;
+	split(root, pos, left, right);
+
+	Piece piece = appendToAddBuffer(text);
+
+	// Typing produces runs of adjacent inserts: grow the previous piece instead of adding one
+	const Piece* previous = lastPiece(left);
+	if (previous != nullptr && previous->buffer == piece.buffer && previous->start + previous->length == piece.start)
+	{
+		left = extendLast(left, piece.length);
+	}
+	else
+	{
+		left = merge(left, makeNode(piece, nextPriority(), nullptr, nullptr));
+	}
+
+	root = merge(left, right);
+}
+
+void PieceTable::remove(qsizetype pos, qsizetype count)
+{
+	pos = std::clamp<qsizetype>(pos, 0, length());
+	count = std::min(count, length() - pos);
+	if (count <= 0)
+	{
+		return;
+	}
+
+	NodePtr left;
+	NodePtr rest;
+	NodePtr removed;
+	NodePtr right;
+	split(root, pos, left, rest);
+	split(rest, count, removed, right);
+	root = merge(left, right);
+}
+
+QChar PieceTable::at(qsizetype pos) const
+{
+	const Node* node = root.get();
+	while (node != nullptr)
+	{
+		qsizetype leftLength = lengthOf(node->left);
+		if (pos < leftLength)
+		{
+			node = node->left.get();
+		}
+		else if (pos < leftLength + node->piece.length)
+		{
+			return buffers[node->piece.buffer].at(node->piece.start + (pos - leftLength));
+		}
+		else
+		{
+			pos -= leftLength + node->piece.length;
+			node = node->right.get();
+		}
+	}
+	return QChar();
+}
+
+QString PieceTable::slice(qsizetype pos, qsizetype count) const
+{
+	QString result;
+	result.reserve(std::max<qsizetype>(0, std::min(count, length() - pos)));
+	forEachChunk(pos,
+	             count,
+	             [&result](QStringView chunk)
+	             {
+		             result.append(chunk);
+		             return true;
+	             });
+	return result;
+}
+
+QString PieceTable::toString() const
+{
+	return slice(0, length());
+}
+
+qsizetype PieceTable::indexOf(QStringView needle, qsizetype from, Qt::CaseSensitivity cs) const
+{
+	if (from < 0 || from > length())
+	{
+		return -1;
+	}
+	if (needle.isEmpty())
+	{
+		return from;
+	}
+
+	qsizetype result = -1;
+	qsizetype chunkStart = from;
+	qsizetype overlap = needle.size() - 1;
+	QString boundary; // tail of the previous runs where a match may still start
+
+	forEachChunk(from,
+	             length() - from,
+	             [&](QStringView chunk)
+	             {
+		             if (!boundary.isEmpty())
+		             {
+			             QString joined = boundary + chunk.first(std::min(overlap, chunk.size()));
+			             qsizetype hit = QStringView(joined).indexOf(needle, 0, cs);
+			             if (hit >= 0)
+			             {
+				             result = chunkStart - boundary.size() + hit;
+				             return false;
+			             }
+		             }
+
+		             qsizetype hit = chunk.indexOf(needle, 0, cs);
+		             if (hit >= 0)
+		             {
+			             result = chunkStart + hit;
+			             return false;
+		             }
+
+		             boundary.append(chunk.last(std::min(overlap, chunk.size())));
+		             boundary = boundary.right(overlap);
+		             chunkStart += chunk.size();
+		             return true;
+	             });
+
+	return result;
+}
+
+qsizetype PieceTable::count(QStringView needle, Qt::CaseSensitivity cs) const
+{
+	if (needle.isEmpty())
+	{
+		return 0;
+	}
+
+	qsizetype occurrences = 0;
+	qsizetype pos = indexOf(needle, 0, cs);
+	while (pos >= 0)
+	{
+		++occurrences;
+		pos = indexOf(needle, pos + needle.size(), cs);
+	}
+	return occurrences;
+}
+
+qsizetype PieceTable::lengthOf(const NodePtr& node)
+{
+	return node ? node->totalLength : 0;
+}
+
+PieceTable::NodePtr PieceTable::makeNode(const Piece& piece, quint32 priority, const NodePtr& left, const NodePtr& right)
+{
+	return std::make_shared<Node>(Node { piece, priority, lengthOf(left) + piece.length + lengthOf(right), left, right });
+}
+
+PieceTable::NodePtr PieceTable::merge(const NodePtr& left, const NodePtr& right)
+{
+	if (!left)
+	{
+		return right;
+	}
+	if (!right)
+	{
+		return left;
+	}
+
+	if (left->priority > right->priority)
+	{
+		return makeNode(left->piece, left->priority, left->left, merge(left->right, right));
+	}
+	return makeNode(right->piece, right->priority, merge(left, right->left), right->right);
+}
+
+void PieceTable::split(const NodePtr& node, qsizetype pos, NodePtr& left, NodePtr& right)
+{
+	if (!node)
+	{
+		left = nullptr;
+		right = nullptr;
+		return;
+	}
+
+	qsizetype leftLength = lengthOf(node->left);
+	const Piece& piece = node->piece;
+
+	if (pos <= leftLength)
+	{
+		NodePtr inner;
+		split(node->left, pos, left, inner);
+		right = makeNode(piece, node->priority, inner, node->right);
+	}
+	else if (pos >= leftLength + piece.length)
+	{
+		NodePtr inner;
+		split(node->right, pos - leftLength - piece.length, inner, right);
+		left = makeNode(piece, node->priority, node->left, inner);
+	}
+	else
+	{
+		// The cut falls inside this piece: both halves keep the node's priority
+		qsizetype offset = pos - leftLength;
+		NodePtr leftChild = node->left;
+		NodePtr rightChild = node->right;
+		left = makeNode(Piece { piece.buffer, piece.start, offset }, node->priority, leftChild, nullptr);
+		right = makeNode(Piece { piece.buffer, piece.start + offset, piece.length - offset }, node->priority, nullptr, rightChild);
+	}
+}
+
+PieceTable::NodePtr PieceTable::extendLast(const NodePtr& node, qsizetype extra)
+{
+	if (!node->right)
+	{
+		Piece piece = node->piece;
+		piece.length += extra;
+		return makeNode(piece, node->priority, node->left, nullptr);
+	}
+	return makeNode(node->piece, node->priority, node->left, extendLast(node->right, extra));
+}
+
+const PieceTable::Piece* PieceTable::lastPiece(const NodePtr& node)
+{
+	const Node* current = node.get();
+	while (current != nullptr && current->right)
+	{
+		current = current->right.get();
+	}
+	return current ? &current->piece : nullptr;
+}
+
+quint32 PieceTable::nextPriority()
+{
+	// xorshift32
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+PieceTable::Piece PieceTable::appendToAddBuffer(QStringView text)
+{
+	if (buffers.size() < 2 || buffers.last().size() + text.size() > addBlockSize)
+	{
+		QString block;
+		block.reserve(std::max(addBlockSize, text.size()));
+		buffers.append(block);
+	}
+
+	// Appending detaches the block if a snapshot still shares it, so snapshots never see it change
+	QString& block = buffers.last();
+	qsizetype start = block.size();
+	block.append(text);
+	return Piece { int(buffers.size() - 1), start, text.size() };
+}
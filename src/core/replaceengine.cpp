@@ -0,0 +1,34 @@
+#include "core/replaceengine.hpp"
+#include <QTextCursor>
+
+ReplaceEngine::ReplaceEngine(QObject* parent) : QObject(parent)
+{
+}
+
+qsizetype ReplaceEngine::replaceAll(QTextDocument* document, const QList<SearchIndex::Range>& ranges, const QString& replacement)
+{
+	if (document == nullptr || ranges.isEmpty())
+	{
+		return 0;
+	}
+
+	const qsizetype total = ranges.size();
+	QTextCursor cursor(document);
+	cursor.beginEditBlock();
+	for (qsizetype done = 0; done < total; ++done)
+	{
+		const SearchIndex::Range& range = ranges[total - 1 - done];
+		cursor.setPosition(int(range.start));
+		cursor.setPosition(int(range.start + range.length), QTextCursor::KeepAnchor);
+		cursor.insertText(replacement);
+
+		if ((done + 1) % progressStep == 0)
+		{
+			emit progress(done + 1, total);
+		}
+	}
+	cursor.endEditBlock();
+
+	emit progress(total, total);
+	return total;
+}
@@ -0,0 +1,88 @@
+#include "core/saveworker.hpp"
+#include "core/streamingwriter.hpp"
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	// Large pieces are written in slices so progress keeps moving
+	constexpr qsizetype writeSliceSize = 1024 * 1024;
+
+}; // namespace
+
+SaveWorker::SaveWorker(QObject* parent) : QObject(parent)
+{
+}
+
+void SaveWorker::save(const QString& filePath, const PieceTable& text, const textcodec::Detection& encoding, compression::Format compression)
+{
+	// Text mode would insert single-byte CRs into UTF-16 output
+	QIODevice::OpenMode textMode = QIODeviceBase::NotOpen;
+	if (textcodec::codeUnitSize(encoding.encoding) == 1)
+	{
+		textMode = QIODevice::Text;
+	}
+
+	// Line endings are converted before compression, the compressed file itself is binary
+	QSaveFile fileToSave(filePath);
+	if (!fileToSave.open(QIODeviceBase::WriteOnly | (compression == compression::Format::None ? textMode : QIODeviceBase::NotOpen)))
+	{
+		qDebug() << "Failed to open file for saving:" << filePath << fileToSave.errorString();
+		emit finished(false, filePath, fileToSave.errorString());
+		return;
+	}
+
+	QIODevice* output = &fileToSave;
+	std::unique_ptr<CompressionDevice> compressor;
+	if (compression != compression::Format::None)
+	{
+		compressor = std::make_unique<CompressionDevice>(&fileToSave, compression);
+		compressor->open(QIODeviceBase::WriteOnly | textMode);
+		output = compressor.get();
+	}
+
+	const qint64 total = text.length();
+	qint64 written = 0;
+	emit progress(written, total);
+
+	// Written back in the encoding (and with the BOM) the file was opened with
+	StreamingWriter writer(output, textcodec::converterEncoding(encoding.encoding), encoding.bomLength > 0);
+	bool completed = text.forEachChunk(
+	    [&](QStringView chunk)
+	    {
+		    for (qsizetype offset = 0; offset < chunk.size(); offset += writeSliceSize)
+		    {
+			    QStringView slice = chunk.sliced(offset, std::min(writeSliceSize, chunk.size() - offset));
+			    if (!writer.write(slice))
+			    {
+				    return false;
+			    }
+			    written += slice.size();
+			    emit progress(written, total);
+		    }
+		    return true;
+	    });
+
+	if (!completed || !writer.flush() || (compressor && !compressor->finish()))
+	{
+		QString error = writer.hasError() ? writer.errorString() : compressor ? compressor->errorString() : fileToSave.errorString();
+		qDebug() << "Failed to write file:" << filePath << error;
+		// Leaves the original file untouched
+		fileToSave.cancelWriting();
+		fileToSave.commit();
+		emit finished(false, filePath, error);
+		return;
+	}
+
+	// commit() syncs the temporary file to disk before renaming it into place
+	if (!fileToSave.commit())
+	{
+		qDebug() << "Failed to commit file:" << filePath << fileToSave.errorString();
+		emit finished(false, filePath, fileToSave.errorString());
+		return;
+	}
+
+	emit finished(true, filePath, QString());
+}
@@ -0,0 +1,296 @@
+#include "core/searchindex.hpp"
+
+namespace
+{
+	char16_t fold(char16_t c)
+	{
+		if (c < 0x80)
+		{
+			return c >= u'A' && c <= u'Z' ? char16_t(c | 0x20) : c;
+		}
+		return QChar(c).toCaseFolded().unicode();
+	}
+
+	int trigramBit(char16_t a, char16_t b, char16_t c)
+	{
+		quint32 h = quint32(a) * 0x9E3779B1u ^ quint32(b) * 0x85EBCA77u ^ quint32(c) * 0xC2B2AE3Du;
+		h ^= h >> 15;
+		h *= 0x2C1B3C6Du;
+		h ^= h >> 12;
+		return int(h & (SearchIndex::filterBits - 1));
+	}
+
+}; // namespace
+
+SearchIndex::SearchIndex() : enabled(true), textLength(0), segmentStarts{ 0 }, pendingIndex(1), pendingDelta(0)
+{
+	filters.push_back(std::make_unique<Filter>());
+}
+
+void SearchIndex::setEnabled(bool enabled, const PieceTable& text)
+{
+	this->enabled = enabled;
+	reset(text);
+}
+
+bool SearchIndex::isEnabled() const
+{
+	return enabled;
+}
+
+void SearchIndex::reset(const PieceTable& text)
+{
+	textLength = text.length();
+	segmentStarts.clear();
+	filters.clear();
+	pendingIndex = 1;
+	pendingDelta = 0;
+	if (enabled)
+	{
+		build(text, 0, textLength, segmentStarts, filters);
+	}
+	else
+	{
+		segmentStarts.append(0);
+	}
+}
+
+void SearchIndex::replace(const PieceTable& text, qsizetype pos, qsizetype removed, qsizetype added)
+{
+	qsizetype change = added - removed;
+	if (!enabled)
+	{
+		textLength += change;
+		return;
+	}
+
+	// Every segment the removed text touched is built again from the new text
+	qsizetype first = segmentAt(pos);
+	qsizetype last = segmentAt(pos + removed);
+	qsizetype from = segmentStart(first);
+	qsizetype oldEnd = segmentEnd(last);
+
+	movePending(first);
+	segmentStarts.remove(first, last - first + 1);
+	filters.erase(filters.begin() + first, filters.begin() + last + 1);
+	pendingDelta += change;
+	textLength += change;
+
+	QList<qsizetype> starts;
+	std::vector<std::unique_ptr<Filter>> built;
+	build(text, from, oldEnd + change, starts, built);
+	segmentStarts.insert(first, starts.size(), 0);
+	for (qsizetype i = 0; i < starts.size(); ++i)
+	{
+		segmentStarts[first + i] = starts[i] - pendingDelta;
+	}
+	filters.insert(filters.begin() + first, std::make_move_iterator(built.begin()), std::make_move_iterator(built.end()));
+}
+
+SearchIndex::Range SearchIndex::findNext(const PieceTable& text, QStringView needle, qsizetype from, Qt::CaseSensitivity cs) const
+{
+	if (needle.isEmpty())
+	{
+		return { -1, 0 };
+	}
+	from = qBound<qsizetype>(0, from, textLength);
+
+	QList<int> bits;
+	if (!queryBits(needle, bits))
+	{
+		qsizetype hit = text.indexOf(needle, from, cs);
+		if (hit < 0 && from > 0)
+		{
+			hit = text.indexOf(needle, 0, cs);
+		}
+		return { hit, hit >= 0 ? needle.size() : 0 };
+	}
+
+	// From the segment at from to the end, then around from the start back into it
+	qsizetype count = segmentStarts.size();
+	qsizetype firstSegment = segmentAt(from);
+	for (qsizetype k = 0; k <= count; ++k)
+	{
+		qsizetype index = (firstSegment + k) % count;
+		if (!mayContain(index, bits))
+		{
+			continue;
+		}
+
+		qsizetype start = segmentStart(index);
+		QString slice = text.slice(start, segmentEnd(index) - start);
+		qsizetype hit = QStringView(slice).indexOf(needle, k == 0 ? from - start : 0, cs);
+		if (hit >= 0 && (k < count || start + hit < from))
+		{
+			return { start + hit, needle.size() };
+		}
+	}
+	return { -1, 0 };
+}
+
+QList<SearchIndex::Range> SearchIndex::findAll(const PieceTable& text, QStringView needle, Qt::CaseSensitivity cs) const
+{
+	QList<Range> matches;
+	if (needle.isEmpty())
+	{
+		return matches;
+	}
+
+	QList<int> bits;
+	if (!queryBits(needle, bits))
+	{
+		for (qsizetype hit = text.indexOf(needle, 0, cs); hit >= 0; hit = text.indexOf(needle, hit + needle.size(), cs))
+		{
+			matches.append({ hit, needle.size() });
+		}
+		return matches;
+	}
+
+	for (const Range& range : candidates(bits))
+	{
+		QString slice = text.slice(range.start, range.length);
+		for (qsizetype hit = QStringView(slice).indexOf(needle, 0, cs); hit >= 0; hit = QStringView(slice).indexOf(needle, hit + needle.size(), cs))
+		{
+			matches.append({ range.start + hit, needle.size() });
+		}
+	}
+	return matches;
+}
+
+QList<SearchIndex::Range> SearchIndex::candidateRanges(QStringView needle) const
+{
+	QList<int> bits;
+	if (!queryBits(needle, bits))
+	{
+		return { { 0, textLength } };
+	}
+	return candidates(bits);
+}
+
+void SearchIndex::movePending(qsizetype index)
+{
+	for (qsizetype i = pendingIndex; i < index; ++i)
+	{
+		segmentStarts[i] += pendingDelta;
+	}
+	for (qsizetype i = index; i < pendingIndex; ++i)
+	{
+		segmentStarts[i] -= pendingDelta;
+	}
+	pendingIndex = index;
+}
+
+qsizetype SearchIndex::segmentStart(qsizetype index) const
+{
+	return segmentStarts[index] + (index >= pendingIndex ? pendingDelta : 0);
+}
+
+qsizetype SearchIndex::segmentEnd(qsizetype index) const
+{
+	return index + 1 < segmentStarts.size() ? segmentStart(index + 1) : textLength;
+}
+
+qsizetype SearchIndex::segmentAt(qsizetype pos) const
+{
+	qsizetype low = 1;
+	qsizetype high = segmentStarts.size();
+	while (low < high)
+	{
+		qsizetype middle = low + (high - low) / 2;
+		if (segmentStart(middle) <= pos)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low - 1;
+}
+
+void SearchIndex::build(const PieceTable& text, qsizetype from, qsizetype to, QList<qsizetype>& starts, std::vector<std::unique_ptr<Filter>>& built) const
+{
+	starts.append(from);
+	built.push_back(std::make_unique<Filter>());
+	Filter* filter = built.back().get();
+
+	// Trigrams do not cross lines, so a segment may end after any newline
+	qsizetype pos = from;
+	int run = 0;
+	char16_t first = 0;
+	char16_t second = 0;
+	text.forEachChunk(from, to - from,
+	                  [&](QStringView chunk)
+	                  {
+		                  for (QChar ch : chunk)
+		                  {
+			                  ++pos;
+			                  if (ch == u'\n')
+			                  {
+				                  run = 0;
+				                  if (pos - starts.last() >= segmentChars && pos < to)
+				                  {
+					                  starts.append(pos);
+					                  built.push_back(std::make_unique<Filter>());
+					                  filter = built.back().get();
+				                  }
+				                  continue;
+			                  }
+
+			                  char16_t c = fold(ch.unicode());
+			                  if (++run >= 3)
+			                  {
+				                  int bit = trigramBit(first, second, c);
+				                  (*filter)[bit / 64] |= quint64(1) << (bit % 64);
+			                  }
+			                  first = second;
+			                  second = c;
+		                  }
+		                  return true;
+	                  });
+}
+
+bool SearchIndex::queryBits(QStringView needle, QList<int>& bits) const
+{
+	if (!enabled || needle.contains(u'\n'))
+	{
+		return false;
+	}
+	addBits(needle, bits);
+	return !bits.isEmpty();
+}
+
+bool SearchIndex::mayContain(qsizetype index, const QList<int>& bits) const
+{
+	const Filter& filter = *filters[index];
+	for (int bit : bits)
+	{
+		if ((filter[bit / 64] & (quint64(1) << (bit % 64))) == 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+QList<SearchIndex::Range> SearchIndex::candidates(const QList<int>& bits) const
+{
+	QList<Range> ranges;
+	for (qsizetype i = 0; i < segmentStarts.size(); ++i)
+	{
+		if (mayContain(i, bits))
+		{
+			ranges.append({ segmentStart(i), segmentEnd(i) - segmentStart(i) });
+		}
+	}
+	return ranges;
+}
+
+void SearchIndex::addBits(QStringView literal, QList<int>& bits)
+{
+	for (qsizetype i = 2; i < literal.size(); ++i)
+	{
+		bits.append(trigramBit(fold(literal[i - 2].unicode()), fold(literal[i - 1].unicode()), fold(literal[i].unicode())));
+	}
+}
@@ -0,0 +1,80 @@
+#include "core/streamingwriter.hpp"
+#include <QDebug>
+#include <algorithm>
+
+namespace
+{
+	// Worst case output per UTF-16 code unit, including a pending surrogate from the previous call
+	constexpr qsizetype maxBytesPerCodeUnit = 4;
+
+}; // namespace
+
+StreamingWriter::StreamingWriter(QIODevice* device, QStringConverter::Encoding encoding, bool writeBom)
+    : device(device), encoder(encoding, writeBom ? QStringConverter::Flag::WriteBom : QStringConverter::Flag::Default), buffer(bufferSize, Qt::Uninitialized), used(0), failed(false)
+{
+}
+
+bool StreamingWriter::write(QStringView text)
+{
+	while (!failed && !text.isEmpty())
+	{
+		qsizetype room = buffer.size() - used;
+		qsizetype take = std::min(text.size(), room / maxBytesPerCodeUnit);
+		if (take == 0)
+		{
+			flushBuffer();
+			continue;
+		}
+
+		char* end = encoder.appendToBuffer(buffer.data() + used, text.first(take));
+		if (encoder.hasError())
+		{
+			error = QString("The text contains characters that cannot be encoded in %1").arg(encoder.name());
+			qDebug() << error;
+			failed = true;
+			break;
+		}
+		used = end - buffer.data();
+		text = text.sliced(take);
+	}
+	return !failed;
+}
+
+bool StreamingWriter::flush()
+{
+	return flushBuffer();
+}
+
+bool StreamingWriter::hasError() const
+{
+	return failed;
+}
+
+QString StreamingWriter::errorString() const
+{
+	return error;
+}
+
+bool StreamingWriter::flushBuffer()
+{
+	if (failed)
+	{
+		return false;
+	}
+
+	qsizetype offset = 0;
+	while (offset < used)
+	{
+		qint64 written = device->write(buffer.constData() + offset, used - offset);
+		if (written <= 0)
+		{
+			qDebug() << "Failed to write to device:" << device->errorString();
+			error = device->errorString();
+			failed = true;
+			return false;
+		}
+		offset += written;
+	}
+	used = 0;
+	return true;
+}
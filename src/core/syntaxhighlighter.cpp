@@ -1,277 +1,875 @@
 #include "core/syntaxhighlighter.hpp"
-#include <QTextDocument>
+#include <QColor>
+#include <QElapsedTimer>
 #include <QFont>
+#include <QScrollBar>
+#include <QTextDocument>
+#include <algorithm>
+#include <limits>
 
-SyntaxHighlighter::SyntaxHighlighter(QTextDocument* parent) : QSyntaxHighlighter(parent)
+namespace
 {
-	keywordFormat.setForeground(Qt::darkBlue);
-	keywordFormat.setFontWeight(QFont::Bold);
+	// Documents with fewer blocks are highlighted synchronously
+	constexpr int lazyBlockThreshold = 20000;
+	// Time spent highlighting per event-loop iteration
+	constexpr qint64 sweepBudgetMs = 8;
+	// Pause of the background pass after an edit
+	constexpr int sweepIdleDelayMs = 300;
+	// Blocks above and below the viewport highlighted along with it
+	constexpr int viewportMargin = 50;
+	// Blocks snapshotted into one tokenizer job when states have to be chained
+	constexpr int runBlocks = 1024;
+
+	char16_t partnerOf(char16_t ch)
+	{
+		switch (ch)
+		{
+			case u'(': return u')';
+			case u')': return u'(';
+			case u'[': return u']';
+			case u']': return u'[';
+			case u'{': return u'}';
+			case u'}': return u'{';
+			default: return 0;
+		}
+	}
 
-	classFormat.setForeground(Qt::darkMagenta);
-	classFormat.setFontWeight(QFont::Bold);
+	std::array<QTextCharFormat, syntax::styleCount> formatsFor(SyntaxHighlighter::Theme theme)
+	{
+		bool dark = theme == SyntaxHighlighter::Theme::Dark;
+		QTextCharFormat keyword;
+		keyword.setForeground(dark ? QColor(0x56, 0x9C, 0xD6) : QColor(Qt::darkBlue));
+		keyword.setFontWeight(QFont::Bold);
+
+		QTextCharFormat type;
+		type.setForeground(dark ? QColor(0x4E, 0xC9, 0xB0) : QColor(Qt::darkMagenta));
+		type.setFontWeight(QFont::Bold);
+
+		QTextCharFormat function;
+		function.setForeground(dark ? QColor(0xDC, 0xDC, 0xAA) : QColor(Qt::blue));
+		function.setFontItalic(true);
+
+		QTextCharFormat string;
+		string.setForeground(dark ? QColor(0xCE, 0x91, 0x78) : QColor(Qt::darkGreen));
+
+		QTextCharFormat comment;
+		comment.setForeground(dark ? QColor(0x6A, 0x99, 0x55) : QColor(Qt::red));
+
+		QTextCharFormat number;
+		number.setForeground(dark ? QColor(0xB5, 0xCE, 0xA8) : QColor(Qt::darkCyan));
+
+		std::array<QTextCharFormat, syntax::styleCount> formats;
+		formats[size_t(syntax::Style::Keyword)] = keyword;
+		formats[size_t(syntax::Style::Tag)] = keyword;
+		formats[size_t(syntax::Style::Type)] = type;
+		formats[size_t(syntax::Style::Entity)] = type;
+		formats[size_t(syntax::Style::Function)] = function;
+		formats[size_t(syntax::Style::String)] = string;
+		formats[size_t(syntax::Style::Comment)] = comment;
+		formats[size_t(syntax::Style::Number)] = number;
+		return formats;
+	}
 
-	singleLineCommentFormat.setForeground(Qt::red);
+	int stepOf(const Bracket& bracket)
+	{
+		return bracket.isOpen() ? 1 : -1;
+	}
 
-	multiLineCommentFormat.setForeground(Qt::red);
+	// Brackets of the text outside of string and comment tokens
+	void findBrackets(const QString& text, const QVector<syntax::Token>& tokens, QVector<Bracket>& brackets, BracketSummary& summary)
+	{
+		QVector<std::pair<int, int>> skipped;
+		for (const syntax::Token& token : tokens)
+		{
+			if (token.style == syntax::Style::String || token.style == syntax::Style::Comment)
+			{
+				skipped.append({ token.start, token.start + token.length });
+			}
+		}
+		std::sort(skipped.begin(), skipped.end());
+
+		brackets.clear();
+		summary = BracketSummary();
+		int depth = 0;
+		qsizetype next = 0;
+		int skipEnd = 0;
+		for (int i = 0; i < text.size(); ++i)
+		{
+			while (next < skipped.size() && skipped[next].first <= i)
+			{
+				skipEnd = std::max(skipEnd, skipped[next].second);
+				++next;
+			}
+			if (i < skipEnd)
+			{
+				i = skipEnd - 1;
+				continue;
+			}
+
+			char16_t ch = text[i].unicode();
+			if (partnerOf(ch) != 0)
+			{
+				brackets.append({ i, ch });
+				depth += stepOf(brackets.last());
+				summary.minDepth = std::min(summary.minDepth, depth);
+			}
+		}
+		summary.delta = depth;
+	}
 
-	quotationFormat.setForeground(Qt::darkGreen);
+	// Index of the first bracket from index first after which the depth is at target or below; -1 if there is none
+	qsizetype closingBracket(const QVector<Bracket>& brackets, qsizetype first, int depth, int target)
+	{
+		for (qsizetype i = first; i < brackets.size(); ++i)
+		{
+			depth += stepOf(brackets[i]);
+			if (depth <= target)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	// Index of the bracket that follows the last point before index end where the depth is at target or below; -1 if there is none
+	qsizetype openingBracket(const QVector<Bracket>& brackets, qsizetype end, int depth, int target)
+	{
+		qsizetype found = depth <= target ? 0 : -1;
+		for (qsizetype i = 0; i < end; ++i)
+		{
+			depth += stepOf(brackets[i]);
+			if (depth <= target)
+			{
+				found = i + 1;
+			}
+		}
+		return found < end ? found : -1;
+	}
 
-	functionFormat.setForeground(Qt::blue);
-	functionFormat.setFontItalic(true);
+}; // namespace
 
-	numberFormat.setForeground(Qt::darkCyan);
+SyntaxHighlighter::SyntaxHighlighter(QTextDocument* parent)
+    : QSyntaxHighlighter(parent), lexer(nullptr), generation(0), rules(nullptr), requestApplied(false), sweepWaiting(false), pass(0), passCounter(0), foldDirtyFirst(-1),
+      foldDirtyLast(-1), theme(Theme::Light)
+{
+	connect(&tokenizer, &TokenizerPool::tokenized, this, &SyntaxHighlighter::onTokenized);
+	sweepTimer.setSingleShot(true);
+	connect(&sweepTimer, &QTimer::timeout, this, &SyntaxHighlighter::sweepBatch);
 
+	formats = formatsFor(theme);
 	setLanguage("cpp");
 }
 
 void SyntaxHighlighter::setLanguage(const QString& language)
 {
-	highlightingRules.clear();
+	const syntax::LanguageDefinition* definition = LanguageRegistry::instance().find(language);
+	lexer = definition != nullptr ? definition->lexer : nullptr;
+	rules = definition != nullptr ? definition->rules.get() : nullptr;
+
+	restartHighlighting();
+}
+
+void SyntaxHighlighter::setEditor(QTextEdit* editor)
+{
+	this->editor = editor;
+	connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &SyntaxHighlighter::highlightViewport);
+}
+
+void SyntaxHighlighter::setTheme(Theme theme)
+{
+	if (theme == this->theme)
+	{
+		return;
+	}
+	this->theme = theme;
+	formats = formatsFor(theme);
+	if (document() != nullptr)
+	{
+		highlightDocument();
+	}
+}
 
-	if (language == "cpp" || language == "c" || language == "h" || language == "hpp")
+SyntaxHighlighter::Theme SyntaxHighlighter::getTheme() const
+{
+	return theme;
+}
+
+const TokenCache& SyntaxHighlighter::getTokenCache() const
+{
+	return tokenCache;
+}
+
+bool SyntaxHighlighter::isBusy() const
+{
+	return pass != 0 || !outstandingJobs.isEmpty();
+}
+
+int SyntaxHighlighter::matchingBracket(int position) const
+{
+	if (document() == nullptr || foldIndex.size() != document()->blockCount())
 	{
-		setupCppHighlighting();
+		return -1;
 	}
-	else if (language == "py" || language == "python")
+
+	QTextBlock block = document()->findBlock(position);
+	const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+	if (data == nullptr || data->revision != block.revision())
 	{
-		setupPythonHighlighting();
+		return -1;
 	}
-	else if (language == "java")
+	int offset = position - block.position();
+	auto it = std::find_if(data->brackets.begin(), data->brackets.end(), [offset](const Bracket& bracket) { return bracket.position == offset; });
+	if (it == data->brackets.end())
 	{
-		setupJavaHighlighting();
+		return -1;
 	}
-	else if (language == "js" || language == "javascript")
+
+	qsizetype index = it - data->brackets.begin();
+	int depth = 0;
+	for (qsizetype i = 0; i < index; ++i)
 	{
-		setupJavaScriptHighlighting();
+		depth += stepOf(data->brackets[i]);
 	}
-	else if (language == "html" || language == "xml")
+
+	// Within the block first; past it the fold index finds the block where the depth comes back
+	QTextBlock matchBlock = block;
+	const HighlightBlockData* matchData = data;
+	qsizetype match = it->isOpen() ? closingBracket(data->brackets, index + 1, depth + 1, depth) : openingBracket(data->brackets, index, 0, depth - 1);
+	if (match < 0)
 	{
-		setupHtmlHighlighting();
+		int number = block.blockNumber();
+		int target = foldIndex.depthAt(number) + (it->isOpen() ? depth : depth - 1);
+		int found = it->isOpen() ? foldIndex.findForward(number, target) : foldIndex.findBackward(number, target);
+		matchBlock = document()->findBlockByNumber(found);
+		matchData = static_cast<const HighlightBlockData*>(matchBlock.userData());
+		if (found < 0 || matchData == nullptr || matchData->revision != matchBlock.revision())
+		{
+			return -1;
+		}
+		int start = foldIndex.depthAt(found);
+		match = it->isOpen() ? closingBracket(matchData->brackets, 0, start, target) : openingBracket(matchData->brackets, matchData->brackets.size(), start, target);
 	}
 
-	rehighlight();
+	if (match < 0 || matchData->brackets[match].ch != partnerOf(it->ch))
+	{
+		return -1;
+	}
+	return matchBlock.position() + matchData->brackets[match].position;
 }
 
-void SyntaxHighlighter::highlightBlock(const QString& text)
+QTextBlock SyntaxHighlighter::foldEnd(const QTextBlock& block) const
 {
-	for (const HighlightingRule& rule : highlightingRules)
+	const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+	if (document() == nullptr || data == nullptr || data->revision != block.revision() || foldIndex.size() != document()->blockCount())
 	{
-		QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-		while (matchIterator.hasNext())
+		return QTextBlock();
+	}
+
+	// The outermost open bracket is the one after the last point where the depth is at the block's lowest
+	int depth = 0;
+	qsizetype outermost = 0;
+	for (qsizetype i = 0; i < data->brackets.size(); ++i)
+	{
+		depth += stepOf(data->brackets[i]);
+		if (depth == data->bracketSummary.minDepth)
 		{
-			QRegularExpressionMatch match = matchIterator.next();
-			setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+			outermost = i + 1;
 		}
 	}
+	if (outermost == data->brackets.size())
+	{
+		return QTextBlock();
+	}
 
-	setCurrentBlockState(0);
+	int number = block.blockNumber();
+	int found = foldIndex.findForward(number, foldIndex.depthAt(number) + data->bracketSummary.minDepth);
+	return found >= 0 ? document()->findBlockByNumber(found) : QTextBlock();
+}
 
-	int startIndex = 0;
-	if (previousBlockState() != 1)
+bool SyntaxHighlighter::toggleFold(const QTextBlock& block)
+{
+	HighlightBlockData* data = static_cast<HighlightBlockData*>(block.userData());
+	if (data != nullptr && data->folded)
 	{
-		startIndex = text.indexOf(commentStartExpression);
+		unfold(block);
+		return true;
 	}
 
-	while (startIndex >= 0)
+	QTextBlock end = foldEnd(block);
+	if (data == nullptr || !end.isValid() || end.blockNumber() <= block.blockNumber() + 1)
 	{
-		QRegularExpressionMatch match = commentEndExpression.match(text, startIndex);
-		int endIndex = match.capturedStart();
-		int commentLength = 0;
-		if (endIndex == -1)
+		return false;
+	}
+
+	// The lines between the two brackets are hidden; hidden blocks are not laid out
+	QTextBlock first = block.next();
+	for (QTextBlock hidden = first; hidden != end; hidden = hidden.next())
+	{
+		hidden.setVisible(false);
+	}
+	data->folded = true;
+	document()->markContentsDirty(first.position(), end.position() - first.position());
+	return true;
+}
+
+void SyntaxHighlighter::suspend()
+{
+	if (suspendedDocument.isNull() && document() != nullptr)
+	{
+		// The document is about to be replaced, results still in the pool are of no use
+		stopBackgroundPass();
+		++generation;
+		outstandingJobs.clear();
+		suspendedDocument = document();
+		setDocument(nullptr);
+	}
+}
+
+void SyntaxHighlighter::resume()
+{
+	if (!suspendedDocument.isNull())
+	{
+		setDocument(suspendedDocument);
+		suspendedDocument.clear();
+		rebuildFoldIndex();
+
+		// setDocument() schedules a full rehighlight; in a large document it only touches what the pass allows
+		if (document()->blockCount() >= lazyBlockThreshold)
 		{
-			setCurrentBlockState(1);
-			commentLength = text.length() - startIndex;
+			restartHighlighting();
 		}
-		else
+	}
+}
+
+void SyntaxHighlighter::highlightBlock(const QString& text)
+{
+	QTextBlock block = currentBlock();
+	int previousState = previousBlockState();
+	if (pass != 0)
+	{
+		int sweepBlock = sweepCursor.blockNumber();
+		if (block.blockNumber() >= sweepBlock)
 		{
-			commentLength = endIndex - startIndex + match.capturedLength();
+			// Past the sweep only requested blocks and blocks already highlighted in this pass are worked on.
+			// Anything else keeps its state, which stops QSyntaxHighlighter from cascading through the rest
+			// of the document; the sweep gets there later.
+			if (block != requestedBlock && !highlightedInPass(block))
+			{
+				return;
+			}
+			if (block.blockNumber() > sweepBlock && !highlightedInPass(block.previous()))
+			{
+				previousState = -1;
+			}
+		}
+	}
+
+	// "No state" is the initial state
+	previousState = qMax(previousState, 0);
+	HighlightBlockData* data = blockData(block);
+	bool current = data->generation == generation && data->revision == block.revision() && data->entryState == previousState;
+	if (!current)
+	{
+		// The same line in the same state has been tokenized before, here or elsewhere in the document
+		if (const TokenCache::Entry* entry = tokenCache.find(languageKey(), previousState, text))
+		{
+			storeTokens(block, data, text, block.revision(), previousState, entry->exitState, entry->tokens);
+			current = true;
+		}
+		else if (lexer == nullptr)
+		{
+			// Regex rule sets are run right here
+			QVector<syntax::Token> tokens;
+			int exitState = tokenizeWithRules(text, previousState, tokens);
+			tokenCache.insert(languageKey(), previousState, text, exitState, tokens);
+			storeTokens(block, data, text, block.revision(), previousState, exitState, tokens);
+			current = true;
 		}
-		setFormat(startIndex, commentLength, multiLineCommentFormat);
-		startIndex = text.indexOf(commentStartExpression, startIndex + commentLength);
+	}
+
+	if (current)
+	{
+		for (const syntax::Token& token : data->tokens)
+		{
+			setFormat(token.start, token.length, formatFor(token.style));
+		}
+		setCurrentBlockState(data->exitState);
+		data->pending = false;
+		data->pass = pass;
+		requestApplied = requestApplied || block == requestedBlock;
+		return;
+	}
+
+	// Until the tokenizer answers, the block keeps its old formats and state; the unchanged state
+	// also stops the cascade here, it resumes when the result is applied
+	for (const syntax::Token& token : data->tokens)
+	{
+		if (token.start < text.size())
+		{
+			setFormat(token.start, qMin(token.length, int(text.size()) - token.start), formatFor(token.style));
+		}
+	}
+	data->pending = true;
+
+	if (!isQueued(block, data) || (data->queuedState >= 0 && data->queuedState != previousState))
+	{
+		// A plain edit leaves the following blocks alone; a new entry state has to be carried forward
+		bool textOnly = data->generation == generation && data->entryState == previousState;
+		submitRun(block, previousState, textOnly ? 1 : runBlocks);
 	}
 }
 
-void SyntaxHighlighter::setupCppHighlighting()
+void SyntaxHighlighter::restartHighlighting()
 {
-	HighlightingRule rule;
+	stopBackgroundPass();
+	++generation;
+	outstandingJobs.clear();
+	if (document() == nullptr)
+	{
+		return;
+	}
+	connect(document(), &QTextDocument::contentsChange, this, &SyntaxHighlighter::syncFoldIndex, Qt::UniqueConnection);
+	rebuildFoldIndex();
+	highlightDocument();
+}
 
-	QStringList keywordPatterns = {
-		"\\bchar\\b",    "\\bclass\\b",    "\\bconst\\b",     "\\bdouble\\b",   "\\benum\\b",     "\\bexplicit\\b",  "\\bfriend\\b",   "\\binline\\b",
-		"\\bint\\b",     "\\blong\\b",     "\\bnamespace\\b", "\\boperator\\b", "\\bprivate\\b",  "\\bprotected\\b", "\\bpublic\\b",   "\\bshort\\b",
-		"\\bsignals\\b", "\\bsigned\\b",   "\\bslots\\b",     "\\bstatic\\b",   "\\bstruct\\b",   "\\btemplate\\b",  "\\btypedef\\b",  "\\btypename\\b",
-		"\\bunion\\b",   "\\bunsigned\\b", "\\bvirtual\\b",   "\\bvoid\\b",     "\\bvolatile\\b", "\\bbool\\b",      "\\bif\\b",       "\\belse\\b",
-		"\\bfor\\b",     "\\bwhile\\b",    "\\bdo\\b",        "\\bswitch\\b",   "\\bcase\\b",     "\\bbreak\\b",     "\\bcontinue\\b", "\\breturn\\b",
-		"\\bgoto\\b",    "\\btry\\b",      "\\bcatch\\b",     "\\bthrow\\b",    "\\bnew\\b",      "\\bdelete\\b",    "\\bsizeof\\b",   "\\bthis\\b",
-		"\\btrue\\b",    "\\bfalse\\b",    "\\bnullptr\\b",   "\\bnull\\b",     "\\bauto\\b",     "\\busing\\b",     "\\bnamespace\\b"
-	};
+void SyntaxHighlighter::highlightDocument()
+{
+	stopBackgroundPass();
+	if (document()->blockCount() < lazyBlockThreshold)
+	{
+		rehighlight();
+		return;
+	}
 
-	for (const QString& pattern : keywordPatterns)
+	pass = ++passCounter;
+	if (pass == 0)
 	{
-		rule.pattern = QRegularExpression(pattern);
-		rule.format = keywordFormat;
-		highlightingRules.append(rule);
+		pass = passCounter = 1;
 	}
+	connect(document(), &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange, Qt::UniqueConnection);
+
+	sweepCursor = QTextCursor(document());
+	sweepCursor.setKeepPositionOnInsert(true);
+	highlightViewport();
+	sweepTimer.start(0);
+}
+
+void SyntaxHighlighter::stopBackgroundPass()
+{
+	sweepTimer.stop();
+	sweepWaiting = false;
+	pass = 0;
+	sweepCursor = QTextCursor();
+}
 
-	rule.pattern = QRegularExpression("\\bQ[A-Za-z]+\\b");
-	rule.format = classFormat;
-	highlightingRules.append(rule);
+void SyntaxHighlighter::highlightViewport()
+{
+	if (editor.isNull() || editor->document() != document() || document() == nullptr)
+	{
+		return;
+	}
 
-	rule.pattern = QRegularExpression("\\b[A-Za-z0-9_]+(?=\\()");
-	rule.format = functionFormat;
-	highlightingRules.append(rule);
+	QTextBlock first = editor->cursorForPosition(QPoint(0, 0)).block();
+	QTextBlock last = editor->cursorForPosition(QPoint(0, editor->viewport()->height())).block();
+	for (int i = 0; i < viewportMargin && first.previous().isValid(); ++i)
+	{
+		first = first.previous();
+	}
+	for (int i = 0; i < viewportMargin && last.next().isValid(); ++i)
+	{
+		last = last.next();
+	}
 
-	rule.pattern = QRegularExpression("\".*\"");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+	// Blocks the pass has not reached yet, and blocks whose tokenizer result was lost to an edit that shifted them
+	int sweepBlock = pass != 0 ? sweepCursor.blockNumber() : std::numeric_limits<int>::max();
+	for (QTextBlock block = first; block.isValid(); block = block.next())
+	{
+		const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+		bool stale = data != nullptr && data->pending && !isQueued(block, data);
+		if ((block.blockNumber() >= sweepBlock && !highlightedInPass(block)) || stale)
+		{
+			requestBlock(block);
+		}
+		if (block == last)
+		{
+			break;
+		}
+	}
+}
 
-	rule.pattern = QRegularExpression("'.*'");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+void SyntaxHighlighter::sweepBatch()
+{
+	if (pass == 0)
+	{
+		return;
+	}
 
-	rule.pattern = QRegularExpression("//[^\n]*");
-	rule.format = singleLineCommentFormat;
-	highlightingRules.append(rule);
+	QElapsedTimer elapsed;
+	elapsed.start();
 
-	rule.pattern = QRegularExpression("\\b\\d+\\.?\\d*\\b");
-	rule.format = numberFormat;
-	highlightingRules.append(rule);
+	sweepWaiting = false;
+	QTextBlock block = sweepCursor.block();
+	while (block.isValid() && elapsed.elapsed() < sweepBudgetMs)
+	{
+		sweepCursor.setPosition(block.position());
+		if (!requestBlock(block))
+		{
+			// Its run is being tokenized; onTokenized() resumes the sweep
+			sweepWaiting = true;
+			return;
+		}
+		block = block.next();
+	}
 
-	commentStartExpression = QRegularExpression("/\\*");
-	commentEndExpression = QRegularExpression("\\*/");
+	if (!block.isValid())
+	{
+		stopBackgroundPass();
+		return;
+	}
+	sweepCursor.setPosition(block.position());
+	sweepTimer.start(0);
 }
 
-void SyntaxHighlighter::setupPythonHighlighting()
+void SyntaxHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded)
 {
-	HighlightingRule rule;
+	Q_UNUSED(charsRemoved);
+	if (pass == 0 || requestedBlock.isValid())
+	{
+		return;
+	}
 
-	QStringList keywordPatterns = { "\\bdef\\b",    "\\bclass\\b",  "\\bif\\b",      "\\belse\\b",  "\\belif\\b",     "\\bfor\\b",    "\\bwhile\\b",
-		                            "\\breturn\\b", "\\bimport\\b", "\\bfrom\\b",    "\\bas\\b",    "\\btry\\b",      "\\bexcept\\b", "\\bfinally\\b",
-		                            "\\braise\\b",  "\\bwith\\b",   "\\bpass\\b",    "\\bbreak\\b", "\\bcontinue\\b", "\\bTrue\\b",   "\\bFalse\\b",
-		                            "\\bNone\\b",   "\\band\\b",    "\\bor\\b",      "\\bnot\\b",   "\\bin\\b",       "\\bis\\b",     "\\blambda\\b",
-		                            "\\byield\\b",  "\\bglobal\\b", "\\bnonlocal\\b" };
+	// Typing pauses the sweep; edited blocks it has not reached yet are highlighted right away
+	sweepTimer.start(sweepIdleDelayMs);
+
+	int sweepBlock = sweepCursor.blockNumber();
+	QTextBlock last = document()->findBlock(position + charsAdded);
+	for (QTextBlock block = document()->findBlock(position); block.isValid(); block = block.next())
+	{
+		if (block.blockNumber() >= sweepBlock && !highlightedInPass(block))
+		{
+			requestBlock(block);
+		}
+		if (block == last)
+		{
+			break;
+		}
+	}
+}
 
-	for (const QString& pattern : keywordPatterns)
+void SyntaxHighlighter::onTokenized(quint64 job, int firstBlock, const QVector<TokenizerPool::TokenizedBlock>& results)
+{
+	Q_UNUSED(firstBlock);
+	// Jobs of an earlier language or of a suspended document are no longer tracked
+	QTextCursor anchor = outstandingJobs.take(job);
+	if (anchor.isNull() || document() == nullptr || anchor.document() != document())
 	{
-		rule.pattern = QRegularExpression(pattern);
-		rule.format = keywordFormat;
-		highlightingRules.append(rule);
+		return;
 	}
 
-	rule.pattern = QRegularExpression("\\bdef\\s+(\\w+)");
-	rule.format = functionFormat;
-	highlightingRules.append(rule);
+	// Block numbers and revisions do not tell blocks apart: lines inserted above the run shift the numbers, and
+	// all blocks of a freshly loaded document share one revision. A result is kept only on the block it was
+	// queued for, found from the job's cursor, and only while that block still has the text that was tokenized.
+	// Blocks edited since the snapshot are tokenized again when they are shown
+	for (const TokenizerPool::TokenizedBlock& result : results)
+	{
+		tokenCache.insert(lexer, result.entryState, result.text, result.exitState, result.tokens);
+	}
 
-	rule.pattern = QRegularExpression("\".*\"|'''.*'''");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+	QVector<QTextBlock> waiting;
+	qsizetype foreign = 0;
+	for (QTextBlock block = anchor.block(); block.isValid() && foreign <= results.size(); block = block.next())
+	{
+		HighlightBlockData* data = static_cast<HighlightBlockData*>(block.userData());
+		if (data == nullptr || data->queuedJob != job || data->queuedIndex < 0 || data->queuedIndex >= results.size())
+		{
+			// Inserted into the run, or queued again by a later job
+			++foreign;
+			continue;
+		}
 
-	rule.pattern = QRegularExpression("#[^\n]*");
-	rule.format = singleLineCommentFormat;
-	highlightingRules.append(rule);
+		const TokenizerPool::TokenizedBlock& result = results[data->queuedIndex];
+		if (block.revision() == result.revision && block.text() == result.text)
+		{
+			storeTokens(block, data, result.text, result.revision, result.entryState, result.exitState, result.tokens);
+			if (data->pending)
+			{
+				waiting.append(block);
+			}
+		}
+		if (data->queuedIndex == results.size() - 1)
+		{
+			break;
+		}
+	}
 
-	rule.pattern = QRegularExpression("\\b\\d+\\.?\\d*\\b");
-	rule.format = numberFormat;
-	highlightingRules.append(rule);
+	for (const QTextBlock& pendingBlock : waiting)
+	{
+		if (blockData(pendingBlock)->pending)
+		{
+			requestBlock(pendingBlock);
+		}
+	}
 
-	commentStartExpression = QRegularExpression("\"\"\"");
-	commentEndExpression = QRegularExpression("\"\"\"");
+	highlightViewport();
+	if (sweepWaiting && !sweepTimer.isActive())
+	{
+		sweepTimer.start(0);
+	}
 }
 
-void SyntaxHighlighter::setupJavaHighlighting()
+void SyntaxHighlighter::syncFoldIndex(int position, int charsRemoved, int charsAdded)
 {
-	HighlightingRule rule;
-
-	QStringList keywordPatterns = { "\\bpublic\\b",  "\\bprivate\\b",    "\\bprotected\\b", "\\bstatic\\b", "\\bfinal\\b",  "\\bclass\\b",    "\\binterface\\b",
-		                            "\\bextends\\b", "\\bimplements\\b", "\\bpackage\\b",   "\\bimport\\b", "\\bif\\b",     "\\belse\\b",     "\\bfor\\b",
-		                            "\\bwhile\\b",   "\\bdo\\b",         "\\bswitch\\b",    "\\bcase\\b",   "\\bbreak\\b",  "\\bcontinue\\b", "\\breturn\\b",
-		                            "\\btry\\b",     "\\bcatch\\b",      "\\bfinally\\b",   "\\bthrow\\b",  "\\bthrows\\b", "\\bnew\\b",      "\\bthis\\b",
-		                            "\\bsuper\\b",   "\\btrue\\b",       "\\bfalse\\b",     "\\bnull\\b",   "\\bint\\b",    "\\bvoid\\b",     "\\bboolean\\b",
-		                            "\\bchar\\b",    "\\bdouble\\b",     "\\bfloat\\b",     "\\blong\\b",   "\\bshort\\b",  "\\bbyte\\b" };
+	Q_UNUSED(charsRemoved);
+	if (document() == nullptr || sender() != document())
+	{
+		return;
+	}
 
-	for (const QString& pattern : keywordPatterns)
+	// Blocks were added or removed right after the first edited one
+	QTextBlock first = document()->findBlock(position);
+	QTextBlock last = document()->findBlock(position + charsAdded);
+	first = first.isValid() ? first : document()->lastBlock();
+	last = last.isValid() ? last : document()->lastBlock();
+	int change = document()->blockCount() - foldIndex.size();
+	if (change > 0)
+	{
+		foldIndex.insert(first.blockNumber() + 1, change);
+	}
+	else if (change < 0)
 	{
-		rule.pattern = QRegularExpression(pattern);
-		rule.format = keywordFormat;
-		highlightingRules.append(rule);
+		foldIndex.remove(first.blockNumber() + 1, -change);
 	}
 
-	rule.pattern = QRegularExpression("\\b[A-Z][a-zA-Z0-9_]*\\b");
-	rule.format = classFormat;
-	highlightingRules.append(rule);
+	auto refresh = [this](const QTextBlock& block)
+	{
+		const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+		foldIndex.set(block.blockNumber(), data != nullptr && data->revision == block.revision() ? data->bracketSummary : BracketSummary());
+	};
 
-	rule.pattern = QRegularExpression("\\b[a-zA-Z0-9_]+(?=\\()");
-	rule.format = functionFormat;
-	highlightingRules.append(rule);
+	// Edited blocks, and blocks highlighted before the index caught up with the edit
+	for (QTextBlock block = first; block.isValid(); block = block.next())
+	{
+		refresh(block);
+		if (block == last)
+		{
+			break;
+		}
+	}
+	if (foldDirtyFirst >= 0)
+	{
+		for (QTextBlock block = document()->findBlockByNumber(foldDirtyFirst); block.isValid() && block.blockNumber() <= foldDirtyLast; block = block.next())
+		{
+			refresh(block);
+		}
+		foldDirtyFirst = foldDirtyLast = -1;
+	}
 
-	rule.pattern = QRegularExpression("\".*\"");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+	// Folds the edit reaches into are opened, their extent may have changed
+	for (QTextBlock block = first; block.isValid(); block = block.next())
+	{
+		if (!block.isVisible())
+		{
+			QTextBlock header = block.previous();
+			while (header.isValid() && !header.isVisible())
+			{
+				header = header.previous();
+			}
+			if (header.isValid())
+			{
+				unfold(header);
+			}
+			block.setVisible(true);
+		}
+		const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+		if (data != nullptr && data->folded)
+		{
+			unfold(block);
+		}
+		if (block == last)
+		{
+			break;
+		}
+	}
+}
 
-	rule.pattern = QRegularExpression("//[^\n]*");
-	rule.format = singleLineCommentFormat;
-	highlightingRules.append(rule);
+bool SyntaxHighlighter::requestBlock(const QTextBlock& block)
+{
+	requestedBlock = block;
+	requestApplied = false;
+	rehighlightBlock(block);
+	requestedBlock = QTextBlock();
+	return requestApplied;
+}
 
-	rule.pattern = QRegularExpression("\\b\\d+\\.?\\d*\\b");
-	rule.format = numberFormat;
-	highlightingRules.append(rule);
+bool SyntaxHighlighter::highlightedInPass(const QTextBlock& block) const
+{
+	const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+	return data != nullptr && data->pass == pass;
+}
 
-	commentStartExpression = QRegularExpression("/\\*");
-	commentEndExpression = QRegularExpression("\\*/");
+bool SyntaxHighlighter::isQueued(const QTextBlock& block, const HighlightBlockData* data) const
+{
+	return outstandingJobs.contains(data->queuedJob) && data->queuedRevision == block.revision();
 }
 
-void SyntaxHighlighter::setupJavaScriptHighlighting()
+void SyntaxHighlighter::submitRun(QTextBlock block, int entryState, int count)
 {
-	HighlightingRule rule;
+	int firstBlock = block.blockNumber();
+	QTextCursor anchor(block);
+	QVector<TokenizerPool::BlockSnapshot> snapshots;
+	QVector<HighlightBlockData*> queued;
+	for (int i = 0; i < count && block.isValid(); ++i, block = block.next())
+	{
+		HighlightBlockData* data = blockData(block);
+		if (i > 0 && isQueued(block, data))
+		{
+			// The rest is already on its way
+			break;
+		}
+		snapshots.append({ block.revision(), block.text() });
+		queued.append(data);
+		data->queuedIndex = i;
+		data->queuedRevision = block.revision();
+		data->queuedState = i == 0 ? entryState : -1;
+	}
+
+	quint64 job = tokenizer.submit(lexer, firstBlock, entryState, std::move(snapshots));
+	outstandingJobs.insert(job, anchor);
+	for (HighlightBlockData* data : queued)
+	{
+		data->queuedJob = job;
+	}
+}
 
-	QStringList keywordPatterns = { "\\bfunction\\b", "\\bvar\\b",   "\\blet\\b",       "\\bconst\\b",  "\\bif\\b",         "\\belse\\b",     "\\bfor\\b",
-		                            "\\bwhile\\b",    "\\bdo\\b",    "\\bswitch\\b",    "\\bcase\\b",   "\\bbreak\\b",      "\\bcontinue\\b", "\\breturn\\b",
-		                            "\\btry\\b",      "\\bcatch\\b", "\\bfinally\\b",   "\\bthrow\\b",  "\\bnew\\b",        "\\bthis\\b",     "\\btrue\\b",
-		                            "\\bfalse\\b",    "\\bnull\\b",  "\\bundefined\\b", "\\btypeof\\b", "\\binstanceof\\b", "\\bin\\b",       "\\bclass\\b",
-		                            "\\bextends\\b",  "\\bsuper\\b", "\\bimport\\b",    "\\bexport\\b", "\\bdefault\\b",    "\\basync\\b",    "\\bawait\\b" };
+const void* SyntaxHighlighter::languageKey() const
+{
+	return lexer != nullptr ? static_cast<const void*>(lexer) : static_cast<const void*>(rules);
+}
 
-	for (const QString& pattern : keywordPatterns)
+void SyntaxHighlighter::storeTokens(const QTextBlock& block, HighlightBlockData* data, const QString& text, int revision, int entryState, int exitState, const QVector<syntax::Token>& tokens)
+{
+	data->generation = generation;
+	data->revision = revision;
+	data->entryState = entryState;
+	data->exitState = exitState;
+	data->tokens = tokens;
+
+	findBrackets(text, tokens, data->brackets, data->bracketSummary);
+	int number = block.blockNumber();
+	if (foldIndex.size() == document()->blockCount())
+	{
+		foldIndex.set(number, data->bracketSummary);
+	}
+	else
 	{
-		rule.pattern = QRegularExpression(pattern);
-		rule.format = keywordFormat;
-		highlightingRules.append(rule);
+		foldDirtyFirst = foldDirtyFirst < 0 ? number : qMin(foldDirtyFirst, number);
+		foldDirtyLast = qMax(foldDirtyLast, number);
 	}
+}
 
-	rule.pattern = QRegularExpression("\\bfunction\\s+(\\w+)|(\\w+)\\s*:\\s*function");
-	rule.format = functionFormat;
-	highlightingRules.append(rule);
+void SyntaxHighlighter::rebuildFoldIndex()
+{
+	QVector<BracketSummary> summaries;
+	summaries.reserve(document()->blockCount());
+	for (QTextBlock block = document()->begin(); block.isValid(); block = block.next())
+	{
+		const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+		summaries.append(data != nullptr && data->revision == block.revision() ? data->bracketSummary : BracketSummary());
+	}
+	foldIndex.reset(summaries);
+	foldDirtyFirst = foldDirtyLast = -1;
+}
 
-	rule.pattern = QRegularExpression("\".*\"|'.*'|`.*`");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+void SyntaxHighlighter::unfold(const QTextBlock& block)
+{
+	HighlightBlockData* data = static_cast<HighlightBlockData*>(block.userData());
+	if (data != nullptr)
+	{
+		data->folded = false;
+	}
 
-	rule.pattern = QRegularExpression("//[^\n]*");
-	rule.format = singleLineCommentFormat;
-	highlightingRules.append(rule);
+	// Folds nested in this one stay closed
+	QTextBlock first = block.next();
+	QTextBlock hidden = first;
+	while (hidden.isValid() && !hidden.isVisible())
+	{
+		hidden.setVisible(true);
+		const HighlightBlockData* hiddenData = static_cast<const HighlightBlockData*>(hidden.userData());
+		QTextBlock nestedEnd = hiddenData != nullptr && hiddenData->folded ? foldEnd(hidden) : QTextBlock();
+		hidden = nestedEnd.isValid() && nestedEnd.blockNumber() > hidden.blockNumber() ? nestedEnd : hidden.next();
+	}
+	if (first.isValid())
+	{
+		int end = hidden.isValid() ? hidden.position() : document()->characterCount() - 1;
+		document()->markContentsDirty(first.position(), end - first.position());
+	}
+}
 
-	rule.pattern = QRegularExpression("\\b\\d+\\.?\\d*\\b");
-	rule.format = numberFormat;
-	highlightingRules.append(rule);
+HighlightBlockData* SyntaxHighlighter::blockData(QTextBlock block)
+{
+	HighlightBlockData* data = static_cast<HighlightBlockData*>(block.userData());
+	if (data == nullptr)
+	{
+		data = new HighlightBlockData;
+		block.setUserData(data);
+	}
+	return data;
+}
 
-	commentStartExpression = QRegularExpression("/\\*");
-	commentEndExpression = QRegularExpression("\\*/");
+const QTextCharFormat& SyntaxHighlighter::formatFor(syntax::Style style) const
+{
+	return formats[size_t(style)];
 }
 
-void SyntaxHighlighter::setupHtmlHighlighting()
+int SyntaxHighlighter::tokenizeWithRules(const QString& text, int previousState, QVector<syntax::Token>& tokens) const
 {
-	HighlightingRule rule;
+	if (rules == nullptr)
+	{
+		return 0;
+	}
 
-	rule.pattern = QRegularExpression("<[^>]+>");
-	rule.format = keywordFormat;
-	highlightingRules.append(rule);
+	// Later tokens override earlier ones when they are applied, as the rules did with setFormat()
+	rules->keywords.forEachKeyword(text, [&tokens](qsizetype start, qsizetype length) { tokens.append({ int(start), int(length), syntax::Style::Keyword }); });
 
-	rule.pattern = QRegularExpression("&[a-zA-Z]+;");
-	rule.format = classFormat;
-	highlightingRules.append(rule);
+	for (const syntax::HighlightingRule& rule : rules->rules)
+	{
+		QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
+		while (matchIterator.hasNext())
+		{
+			QRegularExpressionMatch match = matchIterator.next();
+			tokens.append({ int(match.capturedStart()), int(match.capturedLength()), rule.style });
+		}
+	}
 
-	rule.pattern = QRegularExpression("\".*\"");
-	rule.format = quotationFormat;
-	highlightingRules.append(rule);
+	int state = 0;
+	if (rules->commentStart.pattern().isEmpty())
+	{
+		return state;
+	}
 
-	commentStartExpression = QRegularExpression("<!--");
-	commentEndExpression = QRegularExpression("-->");
+	int startIndex = 0;
+	if (previousState != 1)
+	{
+		startIndex = text.indexOf(rules->commentStart);
+	}
+
+	while (startIndex >= 0)
+	{
+		QRegularExpressionMatch match = rules->commentEnd.match(text, startIndex);
+		int endIndex = match.capturedStart();
+		int commentLength = 0;
+		if (endIndex == -1)
+		{
+			state = 1;
+			commentLength = text.length() - startIndex;
+		}
+		else
+		{
+			commentLength = endIndex - startIndex + match.capturedLength();
+		}
+		tokens.append({ startIndex, commentLength, syntax::Style::Comment });
+		startIndex = text.indexOf(rules->commentStart, startIndex + commentLength);
+	}
+	return state;
 }
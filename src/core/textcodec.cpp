@@ -0,0 +1,388 @@
+#include "core/textcodec.hpp"
+#include "core/simd.hpp"
+#include <QStringDecoder>
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+	// Length of the leading run of bytes below 0x80
+	qsizetype asciiRun(const uchar* src, qsizetype length)
+	{
+		qsizetype i = 0;
+#if defined(NOTER_SIMD_AVX2)
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			quint32 mask = quint32(_mm256_movemask_epi8(bytes));
+			if (mask != 0)
+			{
+				return i + std::countr_zero(mask);
+			}
+		}
+#endif
+#if defined(NOTER_SIMD_SSE2)
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			quint32 mask = quint32(_mm_movemask_epi8(bytes));
+			if (mask != 0)
+			{
+				return i + std::countr_zero(mask);
+			}
+		}
+#endif
+		for (; i < length; ++i)
+		{
+			if (src[i] & 0x80)
+			{
+				return i;
+			}
+		}
+		return length;
+	}
+
+	// Widens the leading ASCII run into UTF-16 and returns its length
+	qsizetype widenAscii(const uchar* src, qsizetype length, char16_t* dst)
+	{
+		qsizetype i = 0;
+#if defined(NOTER_SIMD_AVX2)
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			if (_mm256_movemask_epi8(bytes) != 0)
+			{
+				break;
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+		}
+#endif
+#if defined(NOTER_SIMD_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(bytes) != 0)
+			{
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(bytes, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+		}
+#endif
+		for (; i < length && src[i] < 0x80; ++i)
+		{
+			dst[i] = src[i];
+		}
+		return i;
+	}
+
+	// Decodes one multi-byte sequence; returns the bytes consumed, or 0 if it is malformed
+	int decodeSequence(const uchar* src, qsizetype available, char16_t*& dst)
+	{
+		uchar lead = src[0];
+		int length = 0;
+		char32_t codePoint = 0;
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+			codePoint = lead & 0x1F;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			codePoint = lead & 0x0F;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			codePoint = lead & 0x07;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (available < length)
+		{
+			return 0;
+		}
+		for (int k = 1; k < length; ++k)
+		{
+			if ((src[k] & 0xC0) != 0x80)
+			{
+				return 0;
+			}
+			codePoint = (codePoint << 6) | (src[k] & 0x3F);
+		}
+
+		// Overlong forms, surrogates and values past U+10FFFF
+		if (length == 3 && (codePoint < 0x800 || (codePoint >= 0xD800 && codePoint <= 0xDFFF)))
+		{
+			return 0;
+		}
+		if (length == 4 && (codePoint < 0x10000 || codePoint > 0x10FFFF))
+		{
+			return 0;
+		}
+
+		if (codePoint >= 0x10000)
+		{
+			codePoint -= 0x10000;
+			*dst++ = char16_t(0xD800 + (codePoint >> 10));
+			*dst++ = char16_t(0xDC00 + (codePoint & 0x3FF));
+		}
+		else
+		{
+			*dst++ = char16_t(codePoint);
+		}
+		return length;
+	}
+
+	// Drops a multi-byte sequence cut off by the end of a sample
+	QByteArrayView trimIncompleteSequence(QByteArrayView data)
+	{
+		for (qsizetype k = 1; k <= std::min<qsizetype>(3, data.size()); ++k)
+		{
+			uchar byte = uchar(data[data.size() - k]);
+			if ((byte & 0xC0) == 0xC0)
+			{
+				qsizetype expected = byte >= 0xF0 ? 4 : (byte >= 0xE0 ? 3 : 2);
+				return expected > k ? data.first(data.size() - k) : data;
+			}
+			if ((byte & 0x80) == 0)
+			{
+				break;
+			}
+		}
+		return data;
+	}
+
+}; // namespace
+
+namespace textcodec
+{
+	Detection detectEncoding(QByteArrayView sample)
+	{
+		const uchar* bytes = reinterpret_cast<const uchar*>(sample.data());
+		if (sample.size() >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+		{
+			return { Encoding::Utf8, 3 };
+		}
+		if (sample.size() >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+		{
+			return { Encoding::Utf16LE, 2 };
+		}
+		if (sample.size() >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF)
+		{
+			return { Encoding::Utf16BE, 2 };
+		}
+
+		// UTF-16 without a BOM: mostly-ASCII text leaves every other byte zero
+		qsizetype pairs = std::min<qsizetype>(sample.size(), 4096) / 2;
+		if (pairs > 0)
+		{
+			qsizetype zeroEven = 0;
+			qsizetype zeroOdd = 0;
+			for (qsizetype i = 0; i < pairs; ++i)
+			{
+				zeroEven += bytes[2 * i] == 0;
+				zeroOdd += bytes[2 * i + 1] == 0;
+			}
+			if (zeroOdd * 10 > pairs * 4 && zeroEven * 20 < pairs)
+			{
+				return { Encoding::Utf16LE, 0 };
+			}
+			if (zeroEven * 10 > pairs * 4 && zeroOdd * 20 < pairs)
+			{
+				return { Encoding::Utf16BE, 0 };
+			}
+		}
+
+		return { isValidUtf8(trimIncompleteSequence(sample)) ? Encoding::Utf8 : Encoding::Latin1, 0 };
+	}
+
+	qsizetype asciiPrefixLength(QByteArrayView data)
+	{
+		return asciiRun(reinterpret_cast<const uchar*>(data.data()), data.size());
+	}
+
+	bool isValidUtf8(QByteArrayView data)
+	{
+		const uchar* src = reinterpret_cast<const uchar*>(data.data());
+		const qsizetype length = data.size();
+		char16_t scratch[2];
+
+		qsizetype i = 0;
+		while (i < length)
+		{
+			i += asciiRun(src + i, length - i);
+			if (i == length)
+			{
+				break;
+			}
+
+			char16_t* dst = scratch;
+			int consumed = decodeSequence(src + i, length - i, dst);
+			if (consumed == 0)
+			{
+				return false;
+			}
+			i += consumed;
+		}
+		return true;
+	}
+
+	bool decodeUtf8(QByteArrayView data, QString& out)
+	{
+		const uchar* src = reinterpret_cast<const uchar*>(data.data());
+		const qsizetype length = data.size();
+
+		// UTF-16 never needs more code units than UTF-8 needs bytes
+		out.resize(length);
+		char16_t* begin = reinterpret_cast<char16_t*>(out.data());
+		char16_t* dst = begin;
+
+		qsizetype i = 0;
+		while (i < length)
+		{
+			qsizetype run = widenAscii(src + i, length - i, dst);
+			i += run;
+			dst += run;
+			if (i == length)
+			{
+				break;
+			}
+
+			int consumed = decodeSequence(src + i, length - i, dst);
+			if (consumed == 0)
+			{
+				return false;
+			}
+			i += consumed;
+		}
+
+		out.resize(dst - begin);
+		return true;
+	}
+
+	QString decode(QByteArrayView data, Encoding encoding)
+	{
+		switch (encoding)
+		{
+			case Encoding::Utf8:
+			{
+				QString out;
+				if (decodeUtf8(data, out))
+				{
+					return out;
+				}
+				return QString::fromUtf8(data);
+			}
+			case Encoding::Latin1: return QString::fromLatin1(data);
+			case Encoding::Utf16LE:
+			case Encoding::Utf16BE:
+			{
+				QStringDecoder decoder(converterEncoding(encoding), QStringConverter::Flag::Stateless);
+				return decoder.decode(data);
+			}
+		}
+		return QString();
+	}
+
+	QString decodeText(QByteArrayView bytes, Detection& detected)
+	{
+		detected = detectEncoding(bytes);
+		QString content = decode(bytes.sliced(detected.bomLength), detected.encoding);
+		content.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+		if (content.isNull())
+		{
+			content = QLatin1String("");
+		}
+		return content;
+	}
+
+	qsizetype completeLinesLength(QByteArrayView data, Encoding encoding)
+	{
+		if (codeUnitSize(encoding) == 2)
+		{
+			bool littleEndian = encoding == Encoding::Utf16LE;
+			for (qsizetype pos = (data.size() & ~qsizetype(1)) - 2; pos >= 0; pos -= 2)
+			{
+				char low = littleEndian ? data[pos] : data[pos + 1];
+				char high = littleEndian ? data[pos + 1] : data[pos];
+				if (low == '\n' && high == 0)
+				{
+					return pos + 2;
+				}
+			}
+			return 0;
+		}
+
+		auto newline = std::find(data.rbegin(), data.rend(), '\n');
+		return data.rend() - newline;
+	}
+
+	qsizetype completeCharactersLength(QByteArrayView data, Encoding encoding)
+	{
+		if (codeUnitSize(encoding) == 2)
+		{
+			bool littleEndian = encoding == Encoding::Utf16LE;
+			auto unitBefore = [&](qsizetype end)
+			{
+				uchar low = uchar(littleEndian ? data[end - 2] : data[end - 1]);
+				uchar high = uchar(littleEndian ? data[end - 1] : data[end - 2]);
+				return char16_t((high << 8) | low);
+			};
+
+			qsizetype length = data.size() & ~qsizetype(1);
+			if (length >= 2 && QChar::isHighSurrogate(unitBefore(length)))
+			{
+				length -= 2;
+			}
+			if (length >= 2 && unitBefore(length) == u'\r')
+			{
+				length -= 2;
+			}
+			return length;
+		}
+
+		qsizetype length = encoding == Encoding::Utf8 ? trimIncompleteSequence(data).size() : data.size();
+		if (length > 0 && data[length - 1] == '\r')
+		{
+			--length;
+		}
+		return length;
+	}
+
+	qsizetype codeUnitSize(Encoding encoding)
+	{
+		return (encoding == Encoding::Utf16LE || encoding == Encoding::Utf16BE) ? 2 : 1;
+	}
+
+	QStringConverter::Encoding converterEncoding(Encoding encoding)
+	{
+		switch (encoding)
+		{
+			case Encoding::Utf8: return QStringConverter::Utf8;
+			case Encoding::Utf16LE: return QStringConverter::Utf16LE;
+			case Encoding::Utf16BE: return QStringConverter::Utf16BE;
+			case Encoding::Latin1: return QStringConverter::Latin1;
+		}
+		return QStringConverter::Utf8;
+	}
+
+	QString encodingName(Encoding encoding)
+	{
+		switch (encoding)
+		{
+			case Encoding::Utf8: return "UTF-8";
+			case Encoding::Utf16LE: return "UTF-16 LE";
+			case Encoding::Utf16BE: return "UTF-16 BE";
+			case Encoding::Latin1: return "ISO-8859-1";
+		}
+		return QString();
+	}
+
+}; // namespace textcodec
@@ -0,0 +1,424 @@
+#include "core/textstats.hpp"
+#include "core/simd.hpp"
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <bit>
+
+namespace
+{
+	// Texts shorter than this are counted on the calling thread
+	constexpr qsizetype parallelThreshold = 4 * 1024 * 1024;
+
+	bool isWordCodePoint(char32_t c)
+	{
+		if (c < 0x80)
+		{
+			return (c | 0x20) - U'a' < 26 || c - U'0' < 10 || c == U'_';
+		}
+		return QChar::isLetterOrNumber(c) || QChar::isMark(c);
+	}
+
+	// The code unit at pos, paired with its surrogate partner if it has one
+	char32_t codePointAt(const PieceTable& text, qsizetype pos)
+	{
+		QChar c = text.at(pos);
+		if (c.isHighSurrogate() && pos + 1 < text.length() && text.at(pos + 1).isLowSurrogate())
+		{
+			return QChar::surrogateToUcs4(c, text.at(pos + 1));
+		}
+		if (c.isLowSurrogate() && pos > 0 && text.at(pos - 1).isHighSurrogate())
+		{
+			return QChar::surrogateToUcs4(text.at(pos - 1), c);
+		}
+		return c.unicode();
+	}
+
+	void countCodePoint(char32_t c, textstats::ScanState& state, textstats::Counts& counts)
+	{
+		bool word = isWordCodePoint(c);
+		counts.words += word && !state.inWord;
+		state.inWord = word;
+	}
+
+#if defined(NOTER_SIMD_SSE2)
+	// Lanes hold ASCII values, so signed compares work for bytes and code units alike
+	__m128i wordMask16(__m128i v)
+	{
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi16(0x20));
+		__m128i letter = _mm_and_si128(_mm_cmpgt_epi16(lower, _mm_set1_epi16('a' - 1)), _mm_cmplt_epi16(lower, _mm_set1_epi16('z' + 1)));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16('0' - 1)), _mm_cmplt_epi16(v, _mm_set1_epi16('9' + 1)));
+		return _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi16(v, _mm_set1_epi16('_')));
+	}
+
+	__m128i wordMask8(__m128i v)
+	{
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+		return _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+	}
+#endif
+#if defined(NOTER_SIMD_AVX2)
+	__m256i wordMask16(__m256i v)
+	{
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi16(0x20));
+		__m256i letter = _mm256_andnot_si256(_mm256_cmpgt_epi16(lower, _mm256_set1_epi16('z')), _mm256_cmpgt_epi16(lower, _mm256_set1_epi16('a' - 1)));
+		__m256i digit = _mm256_andnot_si256(_mm256_cmpgt_epi16(v, _mm256_set1_epi16('9')), _mm256_cmpgt_epi16(v, _mm256_set1_epi16('0' - 1)));
+		return _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi16(v, _mm256_set1_epi16('_')));
+	}
+
+	__m256i wordMask8(__m256i v)
+	{
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i letter = _mm256_andnot_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('z')), _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+		__m256i digit = _mm256_andnot_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)));
+		return _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+	}
+#endif
+
+	// Counts the leading all-ASCII blocks of UTF-16 and returns their length. Every code unit
+	// sets two bits of a byte mask, so word starts and spaces are counted twice over.
+	qsizetype countAsciiBlocks(const char16_t* src, qsizetype length, textstats::ScanState& state, textstats::Counts& counts)
+	{
+		qsizetype i = 0;
+#if defined(NOTER_SIMD_AVX2)
+		for (; i + 16 <= length; i += 16)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			if (!_mm256_testz_si256(v, _mm256_set1_epi16(short(0xFF80))))
+			{
+				return i;
+			}
+			quint32 word = quint32(_mm256_movemask_epi8(wordMask16(v)));
+			quint32 space = quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, _mm256_set1_epi16(' '))));
+			quint32 previous = (word << 2) | (state.inWord ? 3u : 0u);
+			counts.words += std::popcount(word & ~previous) / 2;
+			counts.spaces += std::popcount(space) / 2;
+			state.inWord = (word >> 31) != 0;
+		}
+#endif
+#if defined(NOTER_SIMD_SSE2)
+		const __m128i nonAscii = _mm_set1_epi16(short(0xFF80));
+		for (; i + 8 <= length; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), _mm_setzero_si128())) != 0xFFFF)
+			{
+				return i;
+			}
+			quint32 word = quint32(_mm_movemask_epi8(wordMask16(v)));
+			quint32 space = quint32(_mm_movemask_epi8(_mm_cmpeq_epi16(v, _mm_set1_epi16(' '))));
+			quint32 previous = (word << 2) | (state.inWord ? 3u : 0u);
+			counts.words += std::popcount(word & ~previous & 0xFFFF) / 2;
+			counts.spaces += std::popcount(space) / 2;
+			state.inWord = (word >> 15) != 0;
+		}
+#endif
+		return i;
+	}
+
+	qsizetype countAsciiBlocks(const uchar* src, qsizetype length, textstats::ScanState& state, textstats::Counts& counts)
+	{
+		qsizetype i = 0;
+#if defined(NOTER_SIMD_AVX2)
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			if (_mm256_movemask_epi8(v) != 0)
+			{
+				return i;
+			}
+			quint32 word = quint32(_mm256_movemask_epi8(wordMask8(v)));
+			quint32 space = quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+			quint32 previous = (word << 1) | (state.inWord ? 1u : 0u);
+			counts.words += std::popcount(word & ~previous);
+			counts.spaces += std::popcount(space);
+			state.inWord = (word >> 31) != 0;
+		}
+#endif
+#if defined(NOTER_SIMD_SSE2)
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(v) != 0)
+			{
+				return i;
+			}
+			quint32 word = quint32(_mm_movemask_epi8(wordMask8(v)));
+			quint32 space = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))));
+			quint32 previous = (word << 1) | (state.inWord ? 1u : 0u);
+			counts.words += std::popcount(word & ~previous & 0xFFFF);
+			counts.spaces += std::popcount(space);
+			state.inWord = (word >> 15) != 0;
+		}
+#endif
+		return i;
+	}
+
+	// Code point of the sequence at src and its length in bytes; malformed input is one byte of U+FFFD
+	char32_t decodeSequence(const uchar* src, qsizetype available, int& length)
+	{
+		uchar lead = src[0];
+		char32_t codePoint = 0;
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+			codePoint = lead & 0x1F;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			codePoint = lead & 0x0F;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			codePoint = lead & 0x07;
+		}
+		else
+		{
+			length = 1;
+			return 0xFFFD;
+		}
+
+		if (available < length)
+		{
+			length = 1;
+			return 0xFFFD;
+		}
+		for (int k = 1; k < length; ++k)
+		{
+			if ((src[k] & 0xC0) != 0x80)
+			{
+				length = 1;
+				return 0xFFFD;
+			}
+			codePoint = (codePoint << 6) | (src[k] & 0x3F);
+		}
+		return codePoint;
+	}
+
+	// Counts of text[from, to) with the boundary information needed to join neighbouring ranges
+	struct RangeCounts
+	{
+		textstats::Counts counts;
+		bool startsWithWord = false;
+		bool endsInWord = false;
+	};
+
+	RangeCounts countRange(const PieceTable& text, qsizetype from, qsizetype to)
+	{
+		RangeCounts range;
+		textstats::ScanState state;
+		text.forEachChunk(from, to - from,
+		                  [&range, &state](QStringView chunk)
+		                  {
+			                  textstats::Counts counts = textstats::count(chunk, state);
+			                  range.counts.words += counts.words;
+			                  range.counts.chars += counts.chars;
+			                  range.counts.spaces += counts.spaces;
+			                  return true;
+		                  });
+		range.startsWithWord = from < to && isWordCodePoint(codePointAt(text, from));
+		range.endsInWord = state.inWord && state.highSurrogate == 0;
+		return range;
+	}
+
+}; // namespace
+
+namespace textstats
+{
+	Counts count(QStringView text, ScanState& state)
+	{
+		const char16_t* src = text.utf16();
+		const qsizetype length = text.size();
+		Counts counts;
+		counts.chars = length;
+
+		qsizetype i = 0;
+		if (state.highSurrogate != 0 && length > 0)
+		{
+			if (QChar::isLowSurrogate(src[0]))
+			{
+				countCodePoint(QChar::surrogateToUcs4(state.highSurrogate, src[0]), state, counts);
+				i = 1;
+			}
+			else
+			{
+				state.inWord = false;
+			}
+			state.highSurrogate = 0;
+		}
+
+		while (i < length)
+		{
+			i += countAsciiBlocks(src + i, length - i, state, counts);
+			if (i == length)
+			{
+				break;
+			}
+
+			char16_t c = src[i];
+			if (QChar::isHighSurrogate(c))
+			{
+				if (i + 1 == length)
+				{
+					state.highSurrogate = c;
+					break;
+				}
+				if (QChar::isLowSurrogate(src[i + 1]))
+				{
+					countCodePoint(QChar::surrogateToUcs4(c, src[i + 1]), state, counts);
+					i += 2;
+					continue;
+				}
+			}
+			countCodePoint(c, state, counts);
+			counts.spaces += c == u' ';
+			++i;
+		}
+		return counts;
+	}
+
+	Counts countUtf8(QByteArrayView text, ScanState& state)
+	{
+		const uchar* src = reinterpret_cast<const uchar*>(text.data());
+		const qsizetype length = text.size();
+		Counts counts;
+
+		qsizetype i = 0;
+		while (i < length)
+		{
+			qsizetype run = countAsciiBlocks(src + i, length - i, state, counts);
+			counts.chars += run;
+			i += run;
+			if (i == length)
+			{
+				break;
+			}
+
+			int sequence = 1;
+			char32_t c = src[i] < 0x80 ? char32_t(src[i]) : decodeSequence(src + i, length - i, sequence);
+			countCodePoint(c, state, counts);
+			counts.chars += c >= 0x10000 ? 2 : 1;
+			counts.spaces += c == U' ';
+			i += sequence;
+		}
+		return counts;
+	}
+
+	Counts count(const PieceTable& text)
+	{
+		const qsizetype length = text.length();
+		int parts = int(std::min<qsizetype>(QThread::idealThreadCount(), length / parallelThreshold + 1));
+		if (parts <= 1)
+		{
+			return countRange(text, 0, length).counts;
+		}
+
+		// Range boundaries never split a surrogate pair
+		QVector<qsizetype> bounds;
+		for (int k = 0; k <= parts; ++k)
+		{
+			qsizetype bound = length / parts * k;
+			if (k == parts)
+			{
+				bound = length;
+			}
+			else if (bound > 0 && text.at(bound).isLowSurrogate() && text.at(bound - 1).isHighSurrogate())
+			{
+				++bound;
+			}
+			bounds.append(bound);
+		}
+
+		QVector<RangeCounts> ranges(parts);
+		RangeCounts* results = ranges.data();
+		const qsizetype* limits = bounds.constData();
+		QSemaphore done;
+		for (int k = 1; k < parts; ++k)
+		{
+			QThreadPool::globalInstance()->start(
+			    [&text, results, limits, &done, k]()
+			    {
+				    results[k] = countRange(text, limits[k], limits[k + 1]);
+				    done.release();
+			    });
+		}
+		ranges[0] = countRange(text, bounds[0], bounds[1]);
+		done.acquire(parts - 1);
+
+		// A word running across a boundary was counted by both ranges
+		Counts total;
+		for (int k = 0; k < parts; ++k)
+		{
+			total.words += ranges[k].counts.words - (k > 0 && ranges[k - 1].endsInWord && ranges[k].startsWithWord);
+			total.chars += ranges[k].counts.chars;
+			total.spaces += ranges[k].counts.spaces;
+		}
+		return total;
+	}
+
+	qsizetype countWords(const PieceTable& text)
+	{
+		return count(text).words;
+	}
+
+}; // namespace textstats
+
+TextStats::TextStats() : words(0), chars(0), spaces(0)
+{
+}
+
+void TextStats::reset(const PieceTable& text)
+{
+	textstats::Counts counts = textstats::count(text);
+	words = counts.words;
+	chars = counts.chars;
+	spaces = counts.spaces;
+}
+
+void TextStats::replace(const PieceTable& text, qsizetype pos, qsizetype removed, QStringView inserted)
+{
+	// Word starts inside the replaced range, and at the character after it, which may now
+	// continue or stop continuing a word; the character before the range is only context
+	bool wordBefore = pos > 0 && isWordCodePoint(codePointAt(text, pos - 1));
+	bool wordAfter = pos + removed < text.length() && isWordCodePoint(codePointAt(text, pos + removed));
+
+	textstats::ScanState before;
+	before.inWord = wordBefore;
+	textstats::Counts removedCounts;
+	text.forEachChunk(pos, removed,
+	                  [&before, &removedCounts](QStringView chunk)
+	                  {
+		                  textstats::Counts counts = textstats::count(chunk, before);
+		                  removedCounts.words += counts.words;
+		                  removedCounts.spaces += counts.spaces;
+		                  return true;
+	                  });
+
+	textstats::ScanState after;
+	after.inWord = wordBefore;
+	textstats::Counts insertedCounts = textstats::count(inserted, after);
+
+	words += insertedCounts.words + (wordAfter && !after.inWord) - removedCounts.words - (wordAfter && !before.inWord);
+	spaces += insertedCounts.spaces - removedCounts.spaces;
+	chars += inserted.size() - removed;
+}
+
+qsizetype TextStats::wordCount() const
+{
+	return words;
+}
+
+qsizetype TextStats::charCount() const
+{
+	return chars;
+}
+
+qsizetype TextStats::nonSpaceCount() const
+{
+	return chars - spaces;
+}
@@ -0,0 +1,66 @@
+#include "core/tokencache.hpp"
+#include <QHashFunctions>
+
+size_t qHash(const TokenCache::Key& key, size_t seed)
+{
+	return qHashMulti(seed, reinterpret_cast<quintptr>(key.language), key.entryState, key.textHash);
+}
+
+TokenCache::TokenCache(qsizetype capacity) : cache(capacity), hitCount(0), missCount(0)
+{
+}
+
+const TokenCache::Entry* TokenCache::find(const void* language, int entryState, const QString& text)
+{
+	// The hash only picks the entry, the text is compared to rule out collisions
+	const Entry* entry = cache.object({ language, entryState, qHash(text) });
+	if (entry == nullptr || entry->text != text)
+	{
+		++missCount;
+		return nullptr;
+	}
+	++hitCount;
+	return entry;
+}
+
+void TokenCache::insert(const void* language, int entryState, const QString& text, int exitState, const QVector<syntax::Token>& tokens)
+{
+	qsizetype cost = text.size() + tokens.size() * qsizetype(sizeof(syntax::Token) / sizeof(QChar)) + 1;
+	cache.insert({ language, entryState, qHash(text) }, new Entry{ text, exitState, tokens }, cost);
+}
+
+void TokenCache::clear()
+{
+	cache.clear();
+}
+
+void TokenCache::setCapacity(qsizetype capacity)
+{
+	cache.setMaxCost(capacity);
+}
+
+qsizetype TokenCache::getCapacity() const
+{
+	return cache.maxCost();
+}
+
+qsizetype TokenCache::totalCost() const
+{
+	return cache.totalCost();
+}
+
+quint64 TokenCache::hits() const
+{
+	return hitCount;
+}
+
+quint64 TokenCache::misses() const
+{
+	return missCount;
+}
+
+void TokenCache::resetCounters()
+{
+	hitCount = 0;
+	missCount = 0;
+}
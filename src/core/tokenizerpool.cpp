@@ -0,0 +1,37 @@
+#include "core/tokenizerpool.hpp"
+#include <QThread>
+
+TokenizerPool::TokenizerPool(QObject* parent) : QObject(parent), jobCounter(0)
+{
+	// One core stays free for the GUI thread
+	pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+TokenizerPool::~TokenizerPool()
+{
+	pool.clear();
+	pool.waitForDone();
+}
+
+quint64 TokenizerPool::submit(const Lexer* lexer, int firstBlock, int entryState, QVector<BlockSnapshot> blocks)
+{
+	quint64 job = ++jobCounter;
+	pool.start(
+	    [this, lexer, job, firstBlock, entryState, blocks = std::move(blocks)]()
+	    {
+		    QVector<TokenizedBlock> results;
+		    results.reserve(blocks.size());
+		    int state = entryState;
+		    for (const BlockSnapshot& block : blocks)
+		    {
+			    TokenizedBlock result{ block.revision, block.text, state, 0, {} };
+			    result.exitState = lexer->tokenize(block.text, state, result.tokens);
+			    state = result.exitState;
+			    results.append(std::move(result));
+		    }
+
+		    QMetaObject::invokeMethod(
+		        this, [this, job, firstBlock, results = std::move(results)]() { emit tokenized(job, firstBlock, results); }, Qt::QueuedConnection);
+	    });
+	return job;
+}
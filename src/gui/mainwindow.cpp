@@ -4,7 +4,6 @@
 #include <QMessageBox>
 #include <QTextCursor>
 #include <QTextCharFormat>
-#include <QRegularExpression>
 #include <QStatusBar>
 #include <QPalette>
 #include <QApplication>
@@ -20,20 +19,46 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QComboBox>
+#include <QDebug>
 #include <QTextEdit>
+#include <QScrollBar>
+#include <QInputDialog>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QContextMenuEvent>
+#include <QMenu>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	// Time spent appending loaded text per event-loop iteration
+	constexpr qint64 appendBudgetMs = 30;
+	// Status bar statistics are refreshed at most this often while typing
+	constexpr int statisticsDelayMs = 100;
+
+}; // namespace
 
 MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow), fileSearcher(), syntaxHighlighter(nullptr), currentFilePath(QString()), isDarkTheme(false)
+    : QMainWindow(parent), ui(new Ui::MainWindow), fileSearcher(), syntaxHighlighter(nullptr), isApplyingHistory(false), currentFilePath(QString()),
+      isDarkTheme(false), isLoading(false), loadReadFinished(false), loadReplacedDocument(false), previousModified(false), loadProgressBar(nullptr),
+      cancelLoadButton(nullptr), searchCountLabel(nullptr), activeSearch(0)
 {
 	ui->setupUi(this);
 	syntaxHighlighter = new SyntaxHighlighter(ui->textEdit->document());
+	syntaxHighlighter->setEditor(ui->textEdit);
 	setupUI();
 	setupConnections();
 	updateStatistics();
+
+	// Журнал предыдущего сеанса проверяем до того, как начнём новый
+	QTimer::singleShot(0, this, &MainWindow::recoverUnsavedChanges);
 }
 
 MainWindow::~MainWindow()
 {
+	// Normal shutdown: the journal is only needed after a crash
+	journal.close();
 	delete syntaxHighlighter;
 	delete ui;
 }
@@ -42,6 +67,21 @@ void MainWindow::setupUI()
 {
 	statusBar()->showMessage("Ready");
 	ui->textEdit->setFont(QFont("Consolas", 14));
+
+	// Прогресс открытия файла, виден только во время загрузки
+	loadProgressBar = new QProgressBar(this);
+	loadProgressBar->setRange(0, 100);
+	loadProgressBar->setMaximumWidth(200);
+	loadProgressBar->hide();
+	cancelLoadButton = new QPushButton("Cancel", this);
+	cancelLoadButton->hide();
+	statusBar()->addPermanentWidget(loadProgressBar);
+	statusBar()->addPermanentWidget(cancelLoadButton);
+
+	// Число совпадений поиска, видно, пока строка поиска не пуста
+	searchCountLabel = new QLabel(this);
+	searchCountLabel->hide();
+	statusBar()->addPermanentWidget(searchCountLabel);
 }
 
 void MainWindow::setupConnections()
@@ -87,8 +127,9 @@ void MainWindow::setupConnections()
 		        }
 
 		        fileSearcher.setFilePath(currentFilePath);
-		        auto text = ui->textEdit->toPlainText();
-		        emit onSaveFile(text);
+		        loadRemainingChunks();
+		        pendingSaveRevisions.append(journal.revision());
+		        emit onSaveFile(textBuffer);
 		        // Обновляем поле имени файла, показывая базовое имя без расширения
 		        QFileInfo fileInfo(currentFilePath);
 		        QString baseName = fileInfo.completeBaseName();
@@ -96,11 +137,32 @@ void MainWindow::setupConnections()
 		        {
 			        ui->lineEditFileName->setText(baseName);
 		        }
-		        statusBar()->showMessage("File saved: " + currentFilePath, 3000);
+		        statusBar()->showMessage("Saving: " + currentFilePath);
 	        });
 
 	connect(this, &MainWindow::onSaveFile, &fileSearcher, &FileSearcher::saveFile);
 	connect(this, &MainWindow::onSaveFileAs, &fileSearcher, &FileSearcher::saveFileAs);
+	connect(&fileSearcher, &FileSearcher::saveProgress, this, &MainWindow::onSaveProgress);
+	connect(&fileSearcher, &FileSearcher::saveFinished, this, &MainWindow::onSaveFinished);
+
+	statisticsTimer.setSingleShot(true);
+	connect(&statisticsTimer, &QTimer::timeout, this, &MainWindow::updateStatistics);
+
+	// Crash recovery journal
+	journalTimer.setInterval(1000);
+	connect(&journalTimer, &QTimer::timeout, this, &MainWindow::onJournalTimer);
+	journalTimer.start();
+
+	// Progressive open
+	connect(&fileSearcher, &FileSearcher::chunkLoaded, this, &MainWindow::onChunkLoaded);
+	connect(&fileSearcher, &FileSearcher::loadFinished, this, &MainWindow::onLoadFinished);
+	connect(&appendTimer, &QTimer::timeout, this, &MainWindow::appendLoadedChunks);
+	connect(cancelLoadButton, &QPushButton::clicked, this, &MainWindow::cancelLoading);
+
+	// Follow mode
+	connect(ui->actionFollow, &QAction::toggled, this, &MainWindow::toggleFollow);
+	connect(&fileFollower, &FileFollower::appended, this, &MainWindow::onFollowAppended);
+	connect(&fileFollower, &FileFollower::reset, this, &MainWindow::onFollowReset);
 
 	connect(ui->actionSaveAs,
 	        &QAction::triggered,
@@ -158,8 +220,9 @@ void MainWindow::setupConnections()
 				        }
 			        }
 
-			        auto text = ui->textEdit->toPlainText();
-			        emit onSaveFileAs(filePath, text);
+			        loadRemainingChunks();
+			        pendingSaveRevisions.append(journal.revision());
+			        emit onSaveFileAs(filePath, textBuffer);
 			        currentFilePath = filePath;
 			        fileSearcher.setFilePath(filePath);
 			        QFileInfo fileInfo(filePath);
@@ -175,7 +238,15 @@ void MainWindow::setupConnections()
 	connect(ui->actionOpen, &QAction::triggered, this, &MainWindow::onOpenFile);
 
 	// Text editing
+	connect(ui->textEdit->document(), &QTextDocument::contentsChange, this, &MainWindow::onContentsChange);
 	connect(ui->textEdit, &QTextEdit::textChanged, this, &MainWindow::onTextChanged);
+	connect(ui->textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &MainWindow::loadMoreChunks);
+	// Undo goes through editHistory, which leaves out the text appended from the file. The document keeps no
+	// history of its own, so the editor's undo keys and context menu entries are routed to it
+	ui->textEdit->document()->setUndoRedoEnabled(false);
+	ui->textEdit->installEventFilter(this);
+	ui->textEdit->viewport()->installEventFilter(this);
+	updateUndoActions();
 
 	// Font controls
 	connect(ui->fontComboBox, &QFontComboBox::currentFontChanged, this, &MainWindow::updateFont);
@@ -199,12 +270,30 @@ void MainWindow::setupConnections()
 
 	// Search and replace
 	connect(ui->actionSearch, &QAction::triggered, this, &MainWindow::toggleSearchPanel);
+	connect(ui->actionGoToLine, &QAction::triggered, this, &MainWindow::goToLine);
+	connect(ui->actionSearchIndex, &QAction::toggled, this, &MainWindow::toggleSearchIndex);
+	connect(ui->actionToggleFold, &QAction::triggered, this, &MainWindow::toggleFold);
+	connect(ui->textEdit, &QTextEdit::cursorPositionChanged, this, &MainWindow::updateBracketMatch);
 	connect(ui->pushButtonSearch, &QPushButton::clicked, this, &MainWindow::onSearchText);
 	connect(ui->pushButtonReplace, &QPushButton::clicked, this, &MainWindow::onReplaceText);
 	connect(ui->pushButtonReplaceAll, &QPushButton::clicked, this, &MainWindow::onReplaceAll);
+	connect(&replaceEngine,
+	        &ReplaceEngine::progress,
+	        this,
+	        [this](qsizetype done, qsizetype total)
+	        {
+		        // Цикл событий во время замены не крутится, поэтому перерисовываем только полосу
+		        loadProgressBar->setValue(int(done * 100 / total));
+		        loadProgressBar->repaint();
+	        });
 	connect(ui->lineEditSearch, &QLineEdit::returnPressed, this, &MainWindow::onSearchText);
 	// Обновляем подсветку при изменении текста поиска
 	connect(ui->lineEditSearch, &QLineEdit::textChanged, this, &MainWindow::updateSearchHighlight);
+	connect(&matchFinder, &MatchFinder::found, this, &MainWindow::onMatchesFound);
+	// Подсвечиваются только совпадения в видимой части документа
+	connect(ui->textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &MainWindow::updateVisibleMatches);
+	connect(ui->textEdit->verticalScrollBar(), &QScrollBar::rangeChanged, this, &MainWindow::updateVisibleMatches);
+	connect(ui->textEdit->horizontalScrollBar(), &QScrollBar::valueChanged, this, &MainWindow::updateVisibleMatches);
 
 	// Theme
 	connect(ui->actionToggleTheme, &QAction::triggered, this, &MainWindow::toggleDarkTheme);
@@ -221,35 +310,170 @@ void MainWindow::setupConnections()
 	connect(ui->actionExit, &QAction::triggered, this, &MainWindow::closeApplication);
 }
 
+bool MainWindow::eventFilter(QObject* watched, QEvent* event)
+{
+	if (watched == ui->textEdit && event->type() == QEvent::KeyPress)
+	{
+		QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+		if (keyEvent->matches(QKeySequence::Undo))
+		{
+			undo();
+			return true;
+		}
+		if (keyEvent->matches(QKeySequence::Redo))
+		{
+			redo();
+			return true;
+		}
+	}
+	else if (watched == ui->textEdit->viewport() && event->type() == QEvent::ContextMenu)
+	{
+		QMenu* menu = ui->textEdit->createStandardContextMenu();
+		for (QAction* action : menu->actions())
+		{
+			bool isUndo = action->objectName() == "edit-undo";
+			if (isUndo || action->objectName() == "edit-redo")
+			{
+				disconnect(action, &QAction::triggered, nullptr, nullptr);
+				connect(action, &QAction::triggered, this, isUndo ? &MainWindow::undo : &MainWindow::redo);
+				action->setEnabled(!ui->textEdit->isReadOnly() && (isUndo ? ui->actionUndo->isEnabled() : ui->actionRedo->isEnabled()));
+			}
+		}
+		menu->exec(static_cast<QContextMenuEvent*>(event)->globalPos());
+		delete menu;
+		return true;
+	}
+	return QMainWindow::eventFilter(watched, event);
+}
+
 void MainWindow::onTextChanged()
 {
-	updateStatistics();
+	// Statistics are computed once the file has been loaded completely
+	if (!loadingFilePath.isEmpty())
+	{
+		return;
+	}
+	if (!statisticsTimer.isActive())
+	{
+		statisticsTimer.start(statisticsDelayMs);
+	}
 	// Не вызываем updateSearchHighlight() здесь, чтобы избежать конфликтов и рекурсии
 }
 
-void MainWindow::updateStatistics()
+void MainWindow::onContentsChange(int position, int charsRemoved, int charsAdded)
 {
-	QString text = ui->textEdit->toPlainText();
-	int chars = text.length();
-	int charsNoSpaces = text.remove(' ').length();
-	int words = countWords(text);
-	int lines = ui->textEdit->document()->blockCount();
+	QTextDocument* document = ui->textEdit->document();
+	qsizetype documentLength = document->characterCount() - 1;
 
-	QString stats = QString("Words: %1 | Characters: %2 | Characters (no spaces): %3 | Lines: %4").arg(words).arg(chars).arg(charsNoSpaces).arg(lines);
-	statusBar()->showMessage(stats);
+	// Изменения всего документа учитывают завершающий разделитель абзаца, поэтому обрезаем длины
+	qsizetype removed = std::min<qsizetype>(charsRemoved, textBuffer.length() - position);
+	qsizetype added = std::min<qsizetype>(charsAdded, documentLength - position);
+
+	QString inserted = documentText(position, int(added));
+	bool wholeDocument = position == 0 && removed == textBuffer.length();
+	bool undoable = !isLoading && !isApplyingHistory;
+	QString removedText = undoable ? textBuffer.slice(position, removed) : QString();
+	if (wholeDocument)
+	{
+		textBuffer.reset(inserted);
+		textStats.reset(textBuffer);
+		searchIndex.reset(textBuffer);
+	}
+	else
+	{
+		textStats.replace(textBuffer, position, removed, inserted);
+		textBuffer.remove(position, removed);
+		textBuffer.insert(position, inserted);
+		searchIndex.replace(textBuffer, position, removed, inserted.size());
+	}
+	lineIndex.replace(position, removed, inserted);
+
+	// Qt reports exact ranges, also for a whole edit block merged into one change. Its only overcount is
+	// the final paragraph separator of changes that reach the end of the document, clamped off above.
+	// Should a change still be misreported, every later edit would land in the wrong place
+	bool outOfSync = textBuffer.length() != documentLength;
+	if (outOfSync)
+	{
+		qWarning() << "Text buffer has" << textBuffer.length() << "characters instead of" << documentLength << "after a change at" << position
+		           << "- rebuilding it from the document";
+		textBuffer.reset(documentText(0, int(documentLength)));
+		textStats.reset(textBuffer);
+		searchIndex.reset(textBuffer);
+		lineIndex.reset(textBuffer);
+		wholeDocument = true;
+
+		// The recorded edits no longer add up to the document: the journal starts over from it where it can
+		if (!fileSearcher.hasMoreChunks() && loadingFilePath.isEmpty())
+		{
+			journal.compact(textBuffer);
+		}
+		editHistory.clear();
+	}
+	// Содержимое, загружаемое из файла, уже есть на диске и в журнал не попадает
+	else if (!isLoading)
+	{
+		journal.recordRemove(position, removed);
+		journal.recordInsert(position, inserted);
+	}
+
+	// Text appended from the file stays out of the history; a document loaded in its place starts a new one
+	if (undoable && !outOfSync)
+	{
+		editHistory.record(position, removedText, inserted);
+	}
+	else if (isLoading && wholeDocument)
+	{
+		editHistory.clear();
+	}
+	updateUndoActions();
+
+	// Незавершённый поиск шёл по старому тексту, его начинаем заново
+	if (!searchQuery.isEmpty() && (wholeDocument || activeSearch != 0))
+	{
+		updateSearchHighlight();
+	}
+	else
+	{
+		shiftSearchMatches(position, removed, inserted.size());
+	}
 }
 
-int MainWindow::countWords(const QString& text)
+QString MainWindow::documentText(int position, int length) const
 {
-	QRegularExpression re(R"(\b\w+\b)");
-	int count = 0;
-	QRegularExpressionMatchIterator i = re.globalMatch(text);
-	while (i.hasNext())
+	if (length <= 0)
 	{
-		i.next();
-		count++;
+		return QString();
 	}
-	return count;
+
+	QTextCursor cursor(ui->textEdit->document());
+	cursor.setPosition(position);
+	cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+
+	// Same normalization as QTextDocument::toPlainText()
+	QString text = cursor.selectedText();
+	for (QChar& c : text)
+	{
+		if (c == QChar::ParagraphSeparator || c == QChar::LineSeparator)
+		{
+			c = u'\n';
+		}
+		else if (c == QChar::Nbsp)
+		{
+			c = u' ';
+		}
+	}
+	return text;
+}
+
+void MainWindow::updateStatistics()
+{
+	statisticsTimer.stop();
+	QString stats = QString("Words: %1 | Characters: %2 | Characters (no spaces): %3 | Lines: %4")
+	                    .arg(textStats.wordCount())
+	                    .arg(textStats.charCount())
+	                    .arg(textStats.nonSpaceCount())
+	                    .arg(lineIndex.lineCount());
+	statusBar()->showMessage(stats);
 }
 
 void MainWindow::onOpenFile()
@@ -262,31 +486,46 @@ void MainWindow::onOpenFile()
 	}
 
 	QString filePath = QFileDialog::getOpenFileName(this, "Open File", defaultDir, "All Files (*.*)");
-	if (!filePath.isEmpty())
+	if (filePath.isEmpty())
 	{
-		QString content = fileSearcher.openFile(filePath);
-		if (!content.isNull())
-		{
-			ui->textEdit->setPlainText(content);
-			currentFilePath = filePath;
-			QFileInfo fileInfo(filePath);
-			QString baseName = fileInfo.completeBaseName(); // Имя без расширения
-			QString fileName = fileInfo.fileName();         // Полное имя с расширением
-			ui->lineEditFileName->setText(baseName.isEmpty() ? fileName : baseName);
-			updateExtensionFromFileName(fileName);
-			detectLanguageFromFileName(fileName);
-			statusBar()->showMessage("File opened: " + filePath, 3000);
-		}
-		else
-		{
-			QMessageBox::warning(this, "Error", "Failed to open file: " + filePath);
-		}
+		return;
+	}
+
+	ui->actionFollow->setChecked(false);
+	cancelLoading();
+	// Compressed files cannot be mapped, they are always inflated on the load thread
+	if (QFileInfo(filePath).size() < FileSearcher::lazyLoadThreshold || compression::detectFile(filePath) != compression::Format::None)
+	{
+		beginLoading(filePath);
+		return;
+	}
+
+	// Большие файлы: показываем первый фрагмент, остальное догружаем при прокрутке
+	isLoading = true;
+	bool opened = fileSearcher.openFileMapped(filePath);
+	if (opened)
+	{
+		ui->textEdit->setPlainText(fileSearcher.readNextChunk());
+	}
+	isLoading = false;
+
+	if (opened)
+	{
+		journal.open(filePath);
+		loadMoreChunks();
+		setCurrentFile(filePath);
+		QString encodingName = textcodec::encodingName(fileSearcher.getEncoding().encoding);
+		statusBar()->showMessage("File opened: " + filePath + " (" + encodingName + ")", 3000);
+	}
+	else
+	{
+		QMessageBox::warning(this, "Error", "Failed to open file: " + filePath);
 	}
 }
 
 void MainWindow::onNewFile()
 {
-	if (ui->textEdit->document()->isModified() || !ui->textEdit->toPlainText().isEmpty())
+	if (ui->textEdit->document()->isModified() || !textBuffer.isEmpty())
 	{
 		int ret = QMessageBox::question(
 		    this, "New File", "Do you want to save changes to the current file?", QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
@@ -300,12 +539,19 @@ void MainWindow::onNewFile()
 		}
 	}
 
+	ui->actionFollow->setChecked(false);
+	cancelLoading();
+	fileSearcher.closeMappedFile();
 	ui->textEdit->clear();
+	editHistory.clear();
+	updateUndoActions();
 	currentFilePath.clear();
 	fileSearcher.setFilePath("");
+	fileSearcher.resetEncoding();
 	ui->lineEditFileName->clear();
 	ui->comboBoxFileExtension->setCurrentIndex(0); // Reset to .txt
 	syntaxHighlighter->setLanguage("cpp");
+	journal.open(QString());
 }
 
 void MainWindow::onSearchText()
@@ -316,20 +562,25 @@ void MainWindow::onSearchText()
 		return;
 	}
 
+	// Продолжаем после текущего совпадения, по достижении конца — с начала документа
 	QTextCursor cursor = ui->textEdit->textCursor();
-	cursor.movePosition(QTextCursor::Start);
-	ui->textEdit->setTextCursor(cursor);
-
-	bool found = ui->textEdit->find(searchText);
-	if (!found)
+	qsizetype from = cursor.hasSelection() ? cursor.selectionEnd() : cursor.position();
+	SearchIndex::Range match = searchIndex.findNext(textBuffer, searchText, from);
+	if (match.start < 0)
 	{
 		statusBar()->showMessage("Text not found", 2000);
 	}
 	else
 	{
+		cursor.setPosition(int(match.start));
+		cursor.setPosition(int(match.start + match.length), QTextCursor::KeepAnchor);
+		ui->textEdit->setTextCursor(cursor);
 		statusBar()->showMessage("Text found", 2000);
 	}
-	updateSearchHighlight();
+	if (searchText != searchQuery)
+	{
+		updateSearchHighlight();
+	}
 }
 
 void MainWindow::onReplaceText()
@@ -346,6 +597,8 @@ void MainWindow::onReplaceText()
 	if (cursor.hasSelection() && cursor.selectedText() == searchText)
 	{
 		cursor.insertText(replaceText);
+		// Замена может образовать новые совпадения
+		updateSearchHighlight();
 	}
 	onSearchText();
 	updateStatistics();
@@ -360,37 +613,39 @@ void MainWindow::onReplaceAll()
 	{
 		return;
 	}
+	// Полоса прогресса занята загрузкой, да и документ ещё не полный
+	if (!loadingFilePath.isEmpty())
+	{
+		statusBar()->showMessage("Wait until the file has been loaded", 2000);
+		return;
+	}
 
-	// Простой и безопасный способ: заменяем через QString
-	QString documentText = ui->textEdit->toPlainText();
-	int count = documentText.count(searchText);
-
-	if (count == 0)
+	// Every match in the file is replaced, not only those in the part loaded so far
+	loadRemainingChunks();
+	const QList<SearchIndex::Range> matches = searchIndex.findAll(textBuffer, searchText, Qt::CaseSensitive);
+	if (matches.isEmpty())
 	{
 		statusBar()->showMessage("Text not found", 2000);
 		return;
 	}
 
-	// Сохраняем текущую позицию курсора
-	QTextCursor originalCursor = ui->textEdit->textCursor();
-	int originalPosition = originalCursor.position();
-
-	// Выполняем замену
-	documentText.replace(searchText, replaceText);
-
-	// Устанавливаем новый текст
-	ui->textEdit->setPlainText(documentText);
-
-	// Перемещаем курсор в начало для удобства
-	QTextCursor newCursor = ui->textEdit->textCursor();
-	newCursor.movePosition(QTextCursor::Start);
-	ui->textEdit->setTextCursor(newCursor);
+	// Замена на месте одним шагом отмены; курсор и история правок сохраняются
+	loadProgressBar->setValue(0);
+	loadProgressBar->show();
+	qsizetype count = replaceEngine.replaceAll(ui->textEdit->document(), matches, replaceText);
+	loadProgressBar->hide();
 
 	statusBar()->showMessage(QString("Replaced %1 occurrence(s)").arg(count), 3000);
 	updateSearchHighlight();
 	updateStatistics();
 }
 
+void MainWindow::toggleSearchIndex(bool enabled)
+{
+	searchIndex.setEnabled(enabled, textBuffer);
+	statusBar()->showMessage(enabled ? "Search index enabled" : "Search index disabled", 2000);
+}
+
 void MainWindow::toggleSearchPanel()
 {
 	bool visible = ui->searchPanel->isVisible();
@@ -401,45 +656,168 @@ void MainWindow::toggleSearchPanel()
 	}
 }
 
-void MainWindow::updateSearchHighlight()
+void MainWindow::goToLine()
 {
-	QString searchText = ui->lineEditSearch->text();
-
-	// Очищаем предыдущие подсветки
-	ui->textEdit->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+	int currentLine = int(lineIndex.lineAt(ui->textEdit->textCursor().position())) + 1;
+	int lineCount = int(std::min<qsizetype>(lineIndex.lineCount(), std::numeric_limits<int>::max()));
 
-	if (searchText.isEmpty())
+	bool accepted = false;
+	int line = QInputDialog::getInt(this, "Go to Line", QString("Line (1 - %1):").arg(lineCount), currentLine, 1, lineCount, 1, &accepted);
+	if (!accepted)
 	{
 		return;
 	}
 
-	QTextDocument* document = ui->textEdit->document();
-	QTextCharFormat highlightFormat;
-	highlightFormat.setBackground(QBrush(QColor(255, 255, 0, 100)));
+	QTextCursor cursor = ui->textEdit->textCursor();
+	cursor.setPosition(int(lineIndex.lineStart(line - 1)));
+	ui->textEdit->setTextCursor(cursor);
+	ui->textEdit->centerCursor();
+	ui->textEdit->setFocus();
+}
 
-	QList<QTextEdit::ExtraSelection> extraSelections;
-	QTextCursor cursor(document);
-	cursor.movePosition(QTextCursor::Start);
+void MainWindow::toggleFold()
+{
+	// The fold belongs to the line of the cursor, or to the closest visible line above it
+	QTextBlock block = ui->textEdit->textCursor().block();
+	while (block.isValid() && !block.isVisible())
+	{
+		block = block.previous();
+	}
+	if (!syntaxHighlighter->toggleFold(block))
+	{
+		statusBar()->showMessage("Nothing to fold here", 2000);
+		return;
+	}
 
-	QRegularExpression re(QRegularExpression::escape(searchText), QRegularExpression::CaseInsensitiveOption);
+	QTextCursor cursor = ui->textEdit->textCursor();
+	if (!cursor.block().isVisible())
+	{
+		cursor.setPosition(block.position() + block.length() - 1);
+		ui->textEdit->setTextCursor(cursor);
+	}
+}
 
-	while (!cursor.isNull() && !cursor.atEnd())
+void MainWindow::updateBracketMatch()
+{
+	bracketSelections.clear();
+	QTextCursor cursor = ui->textEdit->textCursor();
+	if (!cursor.hasSelection())
 	{
-		cursor = document->find(re, cursor);
-		if (!cursor.isNull())
+		// The bracket after the cursor, otherwise the one before it
+		int position = cursor.position();
+		int match = syntaxHighlighter->matchingBracket(position);
+		if (match < 0 && position > 0)
 		{
-			QTextEdit::ExtraSelection selection;
-			selection.cursor = cursor;
-			selection.format = highlightFormat;
-			extraSelections.append(selection);
+			match = syntaxHighlighter->matchingBracket(--position);
 		}
-		else
+
+		if (match >= 0)
 		{
-			break; // Больше не найдено
+			QTextCharFormat matchFormat;
+			matchFormat.setBackground(QBrush(QColor(120, 180, 255, 110)));
+			for (int bracket : { position, match })
+			{
+				QTextEdit::ExtraSelection selection;
+				selection.cursor = QTextCursor(ui->textEdit->document());
+				selection.cursor.setPosition(bracket);
+				selection.cursor.setPosition(bracket + 1, QTextCursor::KeepAnchor);
+				selection.format = matchFormat;
+				bracketSelections.append(selection);
+			}
 		}
 	}
+	applyExtraSelections();
+}
+
+void MainWindow::applyExtraSelections()
+{
+	ui->textEdit->setExtraSelections(searchSelections + bracketSelections);
+}
+
+void MainWindow::updateSearchHighlight()
+{
+	searchQuery = ui->lineEditSearch->text();
+	searchMatches.clear();
+	searchSelections.clear();
+	applyExtraSelections();
+
+	if (searchQuery.isEmpty())
+	{
+		matchFinder.cancel();
+		activeSearch = 0;
+		searchCountLabel->hide();
+		return;
+	}
+
+	// Поиск идёт в фоне по снимку текста, прежний незавершённый поиск отменяется
+	searchCountLabel->setText("Searching...");
+	searchCountLabel->show();
+	activeSearch = matchFinder.submit(textBuffer, searchQuery, Qt::CaseInsensitive, searchIndex.candidateRanges(searchQuery));
+}
+
+void MainWindow::onMatchesFound(quint64 search, const QList<qsizetype>& starts)
+{
+	if (search != activeSearch)
+	{
+		return;
+	}
+
+	activeSearch = 0;
+	searchMatches = starts;
+	searchCountLabel->setText(QString("Matches: %1").arg(searchMatches.size()));
+	updateVisibleMatches();
+}
+
+void MainWindow::updateVisibleMatches()
+{
+	if (searchSelections.isEmpty() && searchMatches.isEmpty())
+	{
+		return;
+	}
+
+	searchSelections.clear();
+	QTextEdit* textEdit = ui->textEdit;
+	QWidget* viewport = textEdit->viewport();
+	qsizetype first = textEdit->cursorForPosition(QPoint(0, 0)).position();
+	qsizetype last = textEdit->cursorForPosition(QPoint(viewport->width() - 1, viewport->height() - 1)).position();
+
+	QTextCharFormat highlightFormat;
+	highlightFormat.setBackground(QBrush(QColor(255, 255, 0, 100)));
+
+	qsizetype length = searchQuery.size();
+	for (auto match = std::lower_bound(searchMatches.cbegin(), searchMatches.cend(), first - length + 1); match != searchMatches.cend() && *match <= last; ++match)
+	{
+		QTextEdit::ExtraSelection selection;
+		selection.cursor = QTextCursor(textEdit->document());
+		selection.cursor.setPosition(int(*match));
+		selection.cursor.setPosition(int(*match + length), QTextCursor::KeepAnchor);
+		selection.format = highlightFormat;
+		searchSelections.append(selection);
+	}
+
+	applyExtraSelections();
+}
+
+void MainWindow::shiftSearchMatches(qsizetype position, qsizetype removed, qsizetype added)
+{
+	if (searchMatches.isEmpty())
+	{
+		return;
+	}
 
-	ui->textEdit->setExtraSelections(extraSelections);
+	// Совпадения, задетые правкой, убираем, следующие за ней сдвигаем
+	qsizetype length = searchQuery.size();
+	auto first = std::lower_bound(searchMatches.begin(), searchMatches.end(), position - length + 1);
+	auto last = std::lower_bound(first, searchMatches.end(), position + removed);
+	for (auto match = last; match != searchMatches.end(); ++match)
+	{
+		*match += added - removed;
+	}
+	if (first != last)
+	{
+		searchMatches.erase(first, last);
+		searchCountLabel->setText(QString("Matches: %1").arg(searchMatches.size()));
+	}
 }
 
 void MainWindow::toggleDarkTheme()
@@ -471,6 +849,7 @@ void MainWindow::toggleDarkTheme()
 		qApp->setPalette(QApplication::style()->standardPalette());
 		ui->textEdit->setStyleSheet("");
 	}
+	syntaxHighlighter->setTheme(isDarkTheme ? SyntaxHighlighter::Theme::Dark : SyntaxHighlighter::Theme::Light);
 
 	statusBar()->showMessage(isDarkTheme ? "Dark theme enabled" : "Light theme enabled", 2000);
 }
@@ -508,31 +887,8 @@ void MainWindow::detectLanguageFromFileName(const QString& fileName)
 
 QString MainWindow::detectLanguageFromExtension(const QString& filePath)
 {
-	if (filePath.endsWith(".cpp") || filePath.endsWith(".cxx") || filePath.endsWith(".cc") || filePath.endsWith(".c"))
-	{
-		return "cpp";
-	}
-	else if (filePath.endsWith(".h") || filePath.endsWith(".hpp") || filePath.endsWith(".hxx"))
-	{
-		return "cpp";
-	}
-	else if (filePath.endsWith(".py"))
-	{
-		return "python";
-	}
-	else if (filePath.endsWith(".java"))
-	{
-		return "java";
-	}
-	else if (filePath.endsWith(".js"))
-	{
-		return "javascript";
-	}
-	else if (filePath.endsWith(".html") || filePath.endsWith(".xml"))
-	{
-		return "html";
-	}
-	return "cpp";
+	const syntax::LanguageDefinition* language = LanguageRegistry::instance().forFileName(filePath);
+	return language != nullptr ? language->name : "cpp";
 }
 
 QString MainWindow::getFileExtension() const
@@ -559,6 +915,17 @@ QString MainWindow::buildFileName() const
 	return fileName;
 }
 
+void MainWindow::setCurrentFile(const QString& filePath)
+{
+	currentFilePath = filePath;
+	QFileInfo fileInfo(filePath);
+	QString baseName = fileInfo.completeBaseName(); // Имя без расширения
+	QString fileName = fileInfo.fileName();         // Полное имя с расширением
+	ui->lineEditFileName->setText(baseName.isEmpty() ? fileName : baseName);
+	updateExtensionFromFileName(fileName);
+	detectLanguageFromFileName(fileName);
+}
+
 void MainWindow::updateExtensionFromFileName(const QString& fileName)
 {
 	QFileInfo fileInfo(fileName);
@@ -593,12 +960,41 @@ void MainWindow::updateExtensionFromFileName(const QString& fileName)
 
 void MainWindow::undo()
 {
-	ui->textEdit->undo();
+	if (!ui->textEdit->isReadOnly() && !fileFollower.isFollowing() && editHistory.canUndo())
+	{
+		applyHistoryChange(editHistory.undo());
+	}
 }
 
 void MainWindow::redo()
 {
-	ui->textEdit->redo();
+	if (!ui->textEdit->isReadOnly() && !fileFollower.isFollowing() && editHistory.canRedo())
+	{
+		applyHistoryChange(editHistory.redo());
+	}
+}
+
+void MainWindow::applyHistoryChange(const EditHistory::Change& change)
+{
+	QTextCursor cursor(ui->textEdit->document());
+	cursor.setPosition(int(change.position));
+	cursor.setPosition(int(change.position + change.length), QTextCursor::KeepAnchor);
+
+	isApplyingHistory = true;
+	cursor.insertText(change.text);
+	isApplyingHistory = false;
+
+	ui->textEdit->setTextCursor(cursor);
+	ui->textEdit->ensureCursorVisible();
+	updateUndoActions();
+}
+
+void MainWindow::updateUndoActions()
+{
+	// While following, the document only grows from the file
+	bool following = fileFollower.isFollowing();
+	ui->actionUndo->setEnabled(!following && editHistory.canUndo());
+	ui->actionRedo->setEnabled(!following && editHistory.canRedo());
 }
 
 void MainWindow::cut()
@@ -625,3 +1021,377 @@ void MainWindow::closeApplication()
 {
 	close();
 }
+
+void MainWindow::onSaveProgress(qint64 written, qint64 total)
+{
+	int percent = total > 0 ? int(written * 100 / total) : 100;
+	statusBar()->showMessage(QString("Saving... %1%").arg(percent));
+}
+
+void MainWindow::onSaveFinished(bool success, const QString& filePath, const QString& error)
+{
+	quint64 savedRevision = pendingSaveRevisions.isEmpty() ? journal.revision() : pendingSaveRevisions.takeFirst();
+	if (success)
+	{
+		// The saved file becomes the journal base; edits made while it was written go into a snapshot
+		bool editedDuringSave = journal.revision() != savedRevision;
+		journal.open(filePath);
+		if (editedDuringSave)
+		{
+			journal.compact(textBuffer);
+		}
+		statusBar()->showMessage("File saved: " + filePath, 3000);
+	}
+	else
+	{
+		QMessageBox::warning(this, "Error", "Failed to save file: " + filePath + "\n" + error);
+	}
+}
+
+void MainWindow::onJournalTimer()
+{
+	journal.flush();
+
+	// A partially loaded file cannot be snapshotted: the snapshot would miss its tail
+	if (journal.size() > EditJournal::compactionThreshold && !fileSearcher.hasMoreChunks() && loadingFilePath.isEmpty())
+	{
+		journal.compact(textBuffer);
+	}
+}
+
+void MainWindow::recoverUnsavedChanges()
+{
+	const QStringList recoveries = EditJournal::pendingRecoveries();
+	for (const QString& filePath : recoveries)
+	{
+		QString title = filePath.isEmpty() ? "an unsaved document" : filePath;
+		int ret = QMessageBox::question(this, "Recover", "Noter was not closed properly. Recover unsaved changes to " + title + "?", QMessageBox::Yes | QMessageBox::No);
+
+		if (ret == QMessageBox::No)
+		{
+			EditJournal::discardRecovery(filePath);
+			continue;
+		}
+
+		QString text;
+		if (EditJournal::recover(filePath, text))
+		{
+			isLoading = true;
+			ui->textEdit->setPlainText(text);
+			isLoading = false;
+			ui->textEdit->document()->setModified(true);
+
+			if (!filePath.isEmpty())
+			{
+				fileSearcher.setFilePath(filePath);
+				setCurrentFile(filePath);
+			}
+
+			// Recovered text is not on disk yet, so the new journal starts from a snapshot of it
+			journal.open(filePath);
+			journal.compact(textBuffer);
+			statusBar()->showMessage("Recovered unsaved changes", 3000);
+			return;
+		}
+
+		// The journal is the only copy of these edits: it is moved out of the way of new journals, never deleted
+		QString keptPath = EditJournal::setAsideRecovery(filePath);
+		QMessageBox::warning(this, "Error", "Failed to recover unsaved changes to " + title + ".\nThe journal was kept as " + keptPath);
+	}
+
+	journal.open(currentFilePath);
+}
+
+void MainWindow::beginLoading(const QString& filePath)
+{
+	loadingFilePath = filePath;
+	loadReadFinished = false;
+	loadReplacedDocument = false;
+	loadedChunks.clear();
+
+	// The current document stays until the first chunk arrives, so a file that cannot be read leaves it untouched
+	ui->textEdit->setReadOnly(true);
+	ui->actionSave->setEnabled(false);
+	ui->actionSaveAs->setEnabled(false);
+
+	loadProgressBar->setValue(0);
+	loadProgressBar->show();
+	cancelLoadButton->show();
+	statusBar()->showMessage("Opening: " + filePath);
+
+	fileSearcher.openFileAsync(filePath);
+}
+
+void MainWindow::replaceDocumentForLoading()
+{
+	// Kept until the load completes: a failed or cancelled open puts it back
+	previousText = textBuffer;
+	previousHistory = editHistory;
+	previousModified = ui->textEdit->document()->isModified();
+	loadReplacedDocument = true;
+
+	// The document is filled without undo history, highlighting or statistics and cannot be edited meanwhile
+	isLoading = true;
+	syntaxHighlighter->suspend();
+	ui->textEdit->clear();
+}
+
+void MainWindow::onChunkLoaded(const QString& text, qint64 bytesRead, qint64 totalBytes)
+{
+	if (!loadReplacedDocument)
+	{
+		replaceDocumentForLoading();
+	}
+
+	int percent = totalBytes > 0 ? int(bytesRead * 100 / totalBytes) : 100;
+	loadedChunks.enqueue({ text, percent });
+	if (!appendTimer.isActive())
+	{
+		appendTimer.start(0);
+	}
+}
+
+void MainWindow::appendLoadedChunks()
+{
+	// Appends as much as fits into the time budget, then yields back to the event loop
+	QElapsedTimer elapsed;
+	elapsed.start();
+
+	QTextCursor cursor(ui->textEdit->document());
+	cursor.movePosition(QTextCursor::End);
+	while (!loadedChunks.isEmpty() && elapsed.elapsed() < appendBudgetMs)
+	{
+		LoadedChunk chunk = loadedChunks.dequeue();
+		cursor.insertText(chunk.text);
+		loadProgressBar->setValue(chunk.percent);
+	}
+
+	if (loadedChunks.isEmpty())
+	{
+		appendTimer.stop();
+		if (loadReadFinished)
+		{
+			completeLoading();
+		}
+	}
+}
+
+void MainWindow::onLoadFinished(bool success, const QString& filePath, const QString& error)
+{
+	if (loadingFilePath.isEmpty())
+	{
+		return;
+	}
+
+	if (!success)
+	{
+		cancelLoading();
+		QMessageBox::warning(this, "Error", "Failed to open file: " + filePath + "\n" + error);
+		return;
+	}
+
+	// An empty file sends no chunks
+	if (!loadReplacedDocument)
+	{
+		replaceDocumentForLoading();
+	}
+
+	// The tail of the file may still be waiting in the queue
+	loadReadFinished = true;
+	if (loadedChunks.isEmpty())
+	{
+		completeLoading();
+	}
+}
+
+void MainWindow::completeLoading()
+{
+	QString filePath = loadingFilePath;
+	previousText = PieceTable();
+	previousHistory.clear();
+	endLoading();
+
+	journal.open(filePath);
+	setCurrentFile(filePath);
+	syntaxHighlighter->resume();
+	updateStatistics();
+
+	QString formatName = textcodec::encodingName(fileSearcher.getEncoding().encoding);
+	if (fileSearcher.getCompression() != compression::Format::None)
+	{
+		formatName += ", " + compression::formatName(fileSearcher.getCompression());
+	}
+	statusBar()->showMessage("File opened: " + filePath + " (" + formatName + ")", 3000);
+}
+
+void MainWindow::cancelLoading()
+{
+	if (loadingFilePath.isEmpty())
+	{
+		return;
+	}
+
+	fileSearcher.cancelLoad();
+	appendTimer.stop();
+	loadedChunks.clear();
+
+	QString filePath = loadingFilePath;
+	if (!loadReplacedDocument)
+	{
+		endLoading();
+		statusBar()->showMessage("Opening cancelled: " + filePath, 3000);
+		return;
+	}
+
+	// A partially loaded file is not kept: saving it would truncate the original. The previous document
+	// comes back with its undo history; its file, encoding and journal were never switched
+	bool wasModified = previousModified;
+	ui->textEdit->setPlainText(previousText.toString());
+	editHistory = previousHistory;
+	previousText = PieceTable();
+	previousHistory.clear();
+	updateUndoActions();
+	endLoading();
+	ui->textEdit->document()->setModified(wasModified);
+	syntaxHighlighter->resume();
+	updateStatistics();
+	statusBar()->showMessage("Opening cancelled: " + filePath, 3000);
+}
+
+void MainWindow::endLoading()
+{
+	loadingFilePath.clear();
+	loadReadFinished = false;
+
+	if (loadReplacedDocument)
+	{
+		ui->textEdit->document()->setModified(false);
+		loadReplacedDocument = false;
+	}
+	isLoading = false;
+
+	ui->textEdit->setReadOnly(false);
+	ui->actionSave->setEnabled(true);
+	ui->actionSaveAs->setEnabled(true);
+	loadProgressBar->hide();
+	cancelLoadButton->hide();
+}
+
+void MainWindow::toggleFollow(bool enabled)
+{
+	if (!enabled)
+	{
+		if (fileFollower.isFollowing())
+		{
+			fileFollower.stop();
+			ui->textEdit->setReadOnly(false);
+			// Typing after following starts a step of its own
+			editHistory.closeStep();
+			updateUndoActions();
+			// The file has grown since the journal was closed, later edits are based on it as it is now
+			journal.open(currentFilePath);
+			statusBar()->showMessage("Stopped following", 2000);
+		}
+		return;
+	}
+
+	// Новые строки дописываются в конец документа, поэтому он должен совпадать с файлом на диске
+	if (currentFilePath.isEmpty() || !loadingFilePath.isEmpty() || ui->textEdit->document()->isModified())
+	{
+		statusBar()->showMessage("Follow mode needs an opened file without unsaved changes", 3000);
+		ui->actionFollow->setChecked(false);
+		return;
+	}
+	if (fileSearcher.getCompression() != compression::Format::None)
+	{
+		statusBar()->showMessage("Compressed files cannot be followed", 3000);
+		ui->actionFollow->setChecked(false);
+		return;
+	}
+
+	loadRemainingChunks();
+	if (!fileFollower.follow(currentFilePath, fileSearcher.getLoadedBytes(), fileSearcher.getEncoding()))
+	{
+		statusBar()->showMessage("Cannot follow " + currentFilePath, 3000);
+		ui->actionFollow->setChecked(false);
+		return;
+	}
+
+	// Appended lines are never recorded in the edit history; the document keeps no undo of its own
+	ui->textEdit->setReadOnly(true);
+	ui->textEdit->document()->setUndoRedoEnabled(false);
+	editHistory.closeStep();
+	updateUndoActions();
+	// Nothing can be edited while following, and the growing file would no longer match the journal's base
+	journal.close();
+	QScrollBar* scrollBar = ui->textEdit->verticalScrollBar();
+	scrollBar->setValue(scrollBar->maximum());
+	statusBar()->showMessage("Following: " + currentFilePath, 3000);
+}
+
+void MainWindow::onFollowAppended(const QString& text)
+{
+	// Stay at the bottom only if the view was already there
+	QScrollBar* scrollBar = ui->textEdit->verticalScrollBar();
+	bool atBottom = scrollBar->value() >= scrollBar->maximum();
+
+	appendFileText(text);
+	ui->textEdit->document()->setModified(false);
+
+	if (atBottom)
+	{
+		scrollBar->setValue(scrollBar->maximum());
+	}
+}
+
+void MainWindow::onFollowReset()
+{
+	isLoading = true;
+	ui->textEdit->clear();
+	isLoading = false;
+	// The steps refer to text that is gone
+	editHistory.clear();
+	updateUndoActions();
+	statusBar()->showMessage("File was truncated or replaced, reloading", 2000);
+}
+
+void MainWindow::loadMoreChunks()
+{
+	QScrollBar* scrollBar = ui->textEdit->verticalScrollBar();
+	if (loadingFilePath.isEmpty() && fileSearcher.hasMoreChunks() && scrollBar->value() >= scrollBar->maximum() - scrollBar->pageStep())
+	{
+		appendNextChunk();
+	}
+}
+
+void MainWindow::appendNextChunk()
+{
+	QTextDocument* document = ui->textEdit->document();
+	bool wasModified = document->isModified();
+	appendFileText(fileSearcher.readNextChunk());
+	document->setModified(wasModified);
+}
+
+void MainWindow::appendFileText(const QString& text)
+{
+	QTextCursor cursor(ui->textEdit->document());
+	cursor.movePosition(QTextCursor::End);
+
+	// File content is not an edit: it is neither journaled nor undoable
+	isLoading = true;
+	cursor.insertText(text);
+	isLoading = false;
+}
+
+void MainWindow::loadRemainingChunks()
+{
+	// While another file loads, the mapped file still belongs to the document it replaces
+	if (!loadingFilePath.isEmpty())
+	{
+		return;
+	}
+	while (fileSearcher.hasMoreChunks())
+	{
+		appendNextChunk();
+	}
+}
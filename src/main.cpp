@@ -1,10 +1,12 @@
 #include "gui/mainwindow.hpp"
 #include "core/filesearcher.hpp"
+#include "core/languageregistry.hpp"
 #include <QApplication>
 
 int main(int argc, char* argv[])
 {
 	QApplication app(argc, argv);
+	LanguageRegistry::instance().loadDataFiles();
 	FileSearcher fileSearch;
 	MainWindow w;
 	w.show();
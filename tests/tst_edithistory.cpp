@@ -0,0 +1,152 @@
+#include "core/edithistory.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+
+namespace
+{
+	// Applies an edit to text and records it, the way MainWindow does from contentsChange
+	void edit(QString& text, EditHistory& history, qsizetype position, qsizetype removed, const QString& inserted)
+	{
+		history.record(position, text.sliced(position, removed), inserted);
+		text.replace(position, removed, inserted);
+	}
+
+	void apply(QString& text, const EditHistory::Change& change)
+	{
+		text.replace(change.position, change.length, change.text);
+	}
+
+}; // namespace
+
+class EditHistoryTest : public QObject
+{
+	Q_OBJECT
+
+  private slots:
+	void typingMergesIntoOneStep()
+	{
+		QString text = "int x;";
+		EditHistory history;
+		for (int i = 0; i < 3; ++i)
+		{
+			edit(text, history, 4 + i, 0, QString(QChar(u'a' + i)));
+		}
+		QCOMPARE(text, QString("int abcx;"));
+
+		apply(text, history.undo());
+		QCOMPARE(text, QString("int x;"));
+		QVERIFY(!history.canUndo());
+
+		apply(text, history.redo());
+		QCOMPARE(text, QString("int abcx;"));
+		QVERIFY(!history.canRedo());
+	}
+
+	void deletingMergesIntoOneStep()
+	{
+		QString text = "0123456789";
+		EditHistory history;
+		// Backspace twice from 5, then Delete twice at 3
+		edit(text, history, 4, 1, QString());
+		edit(text, history, 3, 1, QString());
+		edit(text, history, 3, 1, QString());
+		edit(text, history, 3, 1, QString());
+		QCOMPARE(text, QString("012789"));
+
+		apply(text, history.undo());
+		QCOMPARE(text, QString("0123456789"));
+		QVERIFY(!history.canUndo());
+	}
+
+	void stepBoundaries()
+	{
+		QString text;
+		EditHistory history;
+		edit(text, history, 0, 0, "a");
+		edit(text, history, 1, 0, "b");
+		// A new line is a step of its own, and so is what is typed after it
+		edit(text, history, 2, 0, "\n");
+		edit(text, history, 3, 0, "c");
+		// Not where the typing left off
+		edit(text, history, 0, 0, "d");
+		// Undo ends the step, typing after it starts a new one
+		apply(text, history.undo());
+		edit(text, history, 0, 0, "e");
+		edit(text, history, 1, 0, "f");
+		QCOMPARE(text, QString("efab\nc"));
+
+		const QStringList states = { "ab\nc", "ab\n", "ab", "" };
+		for (const QString& state : states)
+		{
+			apply(text, history.undo());
+			QCOMPARE(text, state);
+		}
+		QVERIFY(!history.canUndo());
+	}
+
+	void formatChangesAreNotSteps()
+	{
+		QString text = "abc";
+		EditHistory history;
+		edit(text, history, 0, 3, "abc");
+		QVERIFY(!history.canUndo());
+	}
+
+	void newEditDropsRedo()
+	{
+		QString text;
+		EditHistory history;
+		edit(text, history, 0, 0, "one ");
+		edit(text, history, 4, 0, "two");
+		apply(text, history.undo());
+		QVERIFY(history.canRedo());
+
+		edit(text, history, 4, 0, "three");
+		QVERIFY(!history.canRedo());
+		apply(text, history.undo());
+		QCOMPARE(text, QString("one "));
+	}
+
+	void randomEdits()
+	{
+		// Undoing everything walks back through every state, redoing walks forward again
+		QRandomGenerator random(1);
+		QString text = "The quick brown fox\njumps over the lazy dog\n";
+		EditHistory history;
+		QStringList states = { text };
+		for (int i = 0; i < 500; ++i)
+		{
+			qsizetype position = random.bounded(int(text.size() + 1));
+			qsizetype removed = std::min<qsizetype>(random.bounded(3), text.size() - position);
+			QString inserted = random.bounded(3) == 0 ? QString() : QString(QChar(u'a' + random.bounded(3)));
+			if (removed == 0 && inserted.isEmpty())
+			{
+				continue;
+			}
+			edit(text, history, position, removed, inserted);
+			states.append(text);
+		}
+
+		QStringList undone;
+		while (history.canUndo())
+		{
+			apply(text, history.undo());
+			undone.append(text);
+		}
+		QCOMPARE(text, states.first());
+		// Merged steps skip the states inside them, but every state reached is one the text went through
+		for (const QString& state : undone)
+		{
+			QVERIFY(states.contains(state));
+		}
+
+		while (history.canRedo())
+		{
+			apply(text, history.redo());
+		}
+		QCOMPARE(text, states.last());
+	}
+};
+
+QTEST_GUILESS_MAIN(EditHistoryTest)
+#include "tst_edithistory.moc"
@@ -0,0 +1,170 @@
+#include "core/editjournal.hpp"
+#include <QDataStream>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <algorithm>
+
+namespace
+{
+	void writeFile(const QString& filePath, const QByteArray& bytes)
+	{
+		QFile file(filePath);
+		QVERIFY(file.open(QIODeviceBase::WriteOnly | QIODeviceBase::Truncate));
+		QCOMPARE(file.write(bytes), bytes.size());
+	}
+
+	// Journals random edits of text the way MainWindow does and collects every state the text goes through.
+	// The journal is dropped without close(), the way a crash leaves it behind
+	QStringList journalRandomEdits(const QString& filePath, QString text, int editCount, bool compact)
+	{
+		QRandomGenerator random(1);
+		QStringList states = { text };
+		EditJournal journal;
+		if (!journal.open(filePath))
+		{
+			return {};
+		}
+
+		for (int i = 0; i < editCount; ++i)
+		{
+			qsizetype pos = random.bounded(int(text.size() + 1));
+			if (random.bounded(3) == 0 && pos < text.size())
+			{
+				qsizetype count = std::min<qsizetype>(random.bounded(1, 20), text.size() - pos);
+				journal.recordRemove(pos, count);
+				text.remove(pos, count);
+			}
+			else
+			{
+				QString inserted = QString("edit %1\n").arg(i).first(random.bounded(1, 8));
+				journal.recordInsert(pos, inserted);
+				text.insert(pos, inserted);
+			}
+			states.append(text);
+
+			if (compact && i == editCount / 2)
+			{
+				journal.compact(PieceTable(text));
+			}
+		}
+		journal.flush();
+		return states;
+	}
+
+}; // namespace
+
+class EditJournalTest : public QObject
+{
+	Q_OBJECT
+
+  private:
+	QTemporaryDir dir;
+
+  private slots:
+	void initTestCase()
+	{
+		// Keeps the recovery registry out of the user's settings
+		QStandardPaths::setTestModeEnabled(true);
+		QVERIFY(dir.isValid());
+	}
+
+	void roundTrip()
+	{
+		for (bool compact : { false, true })
+		{
+			QString filePath = dir.filePath(compact ? "compacted.txt" : "plain.txt");
+			writeFile(filePath, "first line\nsecond line\n");
+			QStringList states = journalRandomEdits(filePath, "first line\nsecond line\n", 300, compact);
+			QVERIFY(!states.isEmpty());
+			QVERIFY(EditJournal::pendingRecoveries().contains(filePath));
+
+			QString recovered;
+			QVERIFY(EditJournal::recover(filePath, recovered));
+			QCOMPARE(recovered, states.last());
+
+			EditJournal::discardRecovery(filePath);
+			QVERIFY(!QFile::exists(EditJournal::journalPathFor(filePath)));
+			QVERIFY(!EditJournal::pendingRecoveries().contains(filePath));
+		}
+	}
+
+	void corruptTail()
+	{
+		QString filePath = dir.filePath("tail.txt");
+		writeFile(filePath, "base\n");
+		QStringList states = journalRandomEdits(filePath, "base\n", 50, false);
+		QVERIFY(!states.isEmpty());
+
+		QFile journalFile(EditJournal::journalPathFor(filePath));
+		QVERIFY(journalFile.open(QIODeviceBase::ReadOnly));
+		const QByteArray journal = journalFile.readAll();
+		journalFile.close();
+
+		// Cut off anywhere, the journal replays up to its last complete record
+		for (qsizetype cut = 1; cut < 200; ++cut)
+		{
+			writeFile(journalFile.fileName(), journal.first(journal.size() - cut));
+			QString recovered;
+			QVERIFY(EditJournal::recover(filePath, recovered));
+			QVERIFY(states.contains(recovered));
+			QVERIFY(recovered != states.last());
+		}
+
+		// Garbage lengths and positions end the replay instead of being trusted
+		const QList<std::pair<qint64, qint64>> records = { { 0, -1 }, { -1, 1 }, { 1 << 30, 1 }, { 0, qint64(1) << 40 }, { 0, qint64(1) << 62 } };
+		for (quint8 op : { quint8('I'), quint8('R') })
+		{
+			for (auto [pos, count] : records)
+			{
+				QByteArray garbage;
+				QDataStream stream(&garbage, QIODeviceBase::WriteOnly);
+				stream << op << pos << count;
+				writeFile(journalFile.fileName(), journal + garbage + "more bytes after the record");
+
+				QString recovered;
+				QVERIFY(EditJournal::recover(filePath, recovered));
+				QCOMPARE(recovered, states.last());
+			}
+		}
+
+		EditJournal::discardRecovery(filePath);
+	}
+
+	void baseFileChanged()
+	{
+		// Changed in place with the same size, grown past the sampled ends, and removed
+		QString filePath = dir.filePath("changed.txt");
+		const QByteArray base = QByteArray(200 * 1024, 'x') + "\n";
+		QList<QByteArray> changes = { base, base + "appended\n", QByteArray() };
+		changes[0][10] = 'y';
+		for (qsizetype i = 0; i < changes.size(); ++i)
+		{
+			writeFile(filePath, base);
+			QVERIFY(!journalRandomEdits(filePath, QString::fromLatin1(base), 20, false).isEmpty());
+
+			QString recovered;
+			QVERIFY(EditJournal::recover(filePath, recovered));
+			if (i + 1 < changes.size())
+			{
+				writeFile(filePath, changes[i]);
+			}
+			else
+			{
+				QFile::remove(filePath);
+			}
+			QVERIFY(!EditJournal::recover(filePath, recovered));
+
+			// Set aside rather than deleted, the edits are still there to look at
+			QString keptPath = EditJournal::setAsideRecovery(filePath);
+			QVERIFY(QFile::exists(keptPath));
+			QVERIFY(!EditJournal::pendingRecoveries().contains(filePath));
+			QFile::remove(keptPath);
+		}
+	}
+};
+
+QTEST_GUILESS_MAIN(EditJournalTest)
+#include "tst_editjournal.moc"
@@ -0,0 +1,172 @@
+#include "core/foldindex.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+
+namespace
+{
+	// Summary of a random run of brackets, the way the highlighter builds it for one block
+	BracketSummary randomSummary(QRandomGenerator& random)
+	{
+		BracketSummary summary;
+		int brackets = random.bounded(4) == 0 ? 0 : random.bounded(1, 6);
+		for (int i = 0; i < brackets; ++i)
+		{
+			summary.delta += random.bounded(2) == 0 ? 1 : -1;
+			summary.minDepth = std::min(summary.minDepth, summary.delta);
+		}
+		return summary;
+	}
+
+	// Linear references over the plain list of summaries; depths[i] is the depth at the start of block i
+	QVector<int> referenceDepths(const QVector<BracketSummary>& blocks)
+	{
+		QVector<int> depths(blocks.size() + 1, 0);
+		for (qsizetype i = 0; i < blocks.size(); ++i)
+		{
+			depths[i + 1] = depths[i] + blocks[i].delta;
+		}
+		return depths;
+	}
+
+	int referenceForward(const QVector<BracketSummary>& blocks, const QVector<int>& depths, int after, int depth)
+	{
+		for (int i = std::max(after + 1, 0); i < blocks.size(); ++i)
+		{
+			if (depths[i] + blocks[i].minDepth <= depth)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int referenceBackward(const QVector<BracketSummary>& blocks, const QVector<int>& depths, int before, int depth)
+	{
+		for (int i = std::min(before, int(blocks.size())) - 1; i >= 0; --i)
+		{
+			if (depths[i] + blocks[i].minDepth <= depth)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+}; // namespace
+
+class FoldIndexTest : public QObject
+{
+	Q_OBJECT
+
+  private:
+	static void compareQueries(const FoldIndex& index, const QVector<BracketSummary>& blocks, QRandomGenerator& random)
+	{
+		QVector<int> depths = referenceDepths(blocks);
+		QCOMPARE(index.size(), int(blocks.size()));
+		for (int i = 0; i <= blocks.size(); ++i)
+		{
+			QCOMPARE(index.depthAt(i), depths[i]);
+		}
+		for (int query = 0; query < 200; ++query)
+		{
+			int block = random.bounded(-1, int(blocks.size()) + 1);
+			// Around the depth at the block, where both hits and misses happen
+			int depth = depths[std::clamp(block, 0, int(blocks.size()))] + random.bounded(-3, 2);
+			QCOMPARE(index.findForward(block, depth), referenceForward(blocks, depths, block, depth));
+			QCOMPARE(index.findBackward(block, depth), referenceBackward(blocks, depths, block, depth));
+		}
+	}
+
+  private slots:
+	void emptyIndex()
+	{
+		FoldIndex index;
+		QCOMPARE(index.size(), 0);
+		QCOMPARE(index.depthAt(0), 0);
+		QCOMPARE(index.findForward(-1, 0), -1);
+		QCOMPARE(index.findBackward(0, 0), -1);
+	}
+
+	void nestedBlocks()
+	{
+		// int f() {        depth 0 -> 1
+		//     if (x) {     1 -> 2
+		//     }            2 -> 1
+		// }                1 -> 0
+		QVector<BracketSummary> blocks = { { 1, 0 }, { 1, 0 }, { -1, -1 }, { -1, -1 } };
+		FoldIndex index;
+		index.reset(blocks);
+		QCOMPARE(index.depthAt(2), 2);
+		// The block that closes the fold opened on block 1 takes the depth back to 1
+		QCOMPARE(index.findForward(1, 1), 2);
+		QCOMPARE(index.findForward(0, 0), 3);
+		// And the other way round
+		QCOMPARE(index.findBackward(3, 0), 0);
+	}
+
+	void randomSummaries()
+	{
+		QRandomGenerator random(1);
+		QVector<BracketSummary> blocks;
+		for (int i = 0; i < 3000; ++i)
+		{
+			blocks.append(randomSummary(random));
+		}
+
+		FoldIndex index;
+		index.reset(blocks);
+		compareQueries(index, blocks, random);
+	}
+
+	void edits()
+	{
+		QRandomGenerator random(2);
+		QVector<BracketSummary> blocks;
+		for (int i = 0; i < 500; ++i)
+		{
+			blocks.append(randomSummary(random));
+		}
+		FoldIndex index;
+		index.reset(blocks);
+
+		for (int edit = 0; edit < 2000; ++edit)
+		{
+			int at = random.bounded(int(blocks.size()) + 1);
+			switch (random.bounded(3))
+			{
+				case 0:
+				{
+					int count = random.bounded(1, 5);
+					index.insert(at, count);
+					blocks.insert(at, count, BracketSummary());
+					break;
+				}
+				case 1:
+				{
+					int count = std::min(random.bounded(1, 5), int(blocks.size()) - at);
+					index.remove(at, count);
+					blocks.remove(at, count);
+					break;
+				}
+				default:
+					if (at < blocks.size())
+					{
+						BracketSummary summary = randomSummary(random);
+						index.set(at, summary);
+						blocks[at] = summary;
+					}
+					break;
+			}
+
+			if (edit % 200 == 0)
+			{
+				compareQueries(index, blocks, random);
+			}
+		}
+		compareQueries(index, blocks, random);
+	}
+};
+
+QTEST_GUILESS_MAIN(FoldIndexTest)
+#include "tst_foldindex.moc"
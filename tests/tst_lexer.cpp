@@ -0,0 +1,191 @@
+#include "core/lexer.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+
+using syntax::Style;
+
+namespace
+{
+	// Style of every character of every line, each line lexed in the state the one before it ends in
+	struct Lexed
+	{
+		QStringList lines;
+		QList<QVector<Style>> styles;
+		int endState = 0;
+	};
+
+	Lexed lex(const Lexer* lexer, const QStringList& lines)
+	{
+		Lexed lexed{ lines, {}, 0 };
+		for (const QString& line : lines)
+		{
+			QVector<syntax::Token> tokens;
+			lexed.endState = lexer->tokenize(line, lexed.endState, tokens);
+			QVector<Style> styles(line.size(), Style::Normal);
+			for (const syntax::Token& token : tokens)
+			{
+				std::fill(styles.begin() + token.start, styles.begin() + token.start + token.length, token.style);
+			}
+			lexed.styles.append(styles);
+		}
+		return lexed;
+	}
+
+	// Every character of the first occurrence of part in the line has the style
+	bool hasStyle(const Lexed& lexed, int line, const QString& part, Style style)
+	{
+		qsizetype at = lexed.lines[line].indexOf(part);
+		if (at < 0)
+		{
+			return false;
+		}
+		const QVector<Style>& styles = lexed.styles[line];
+		return std::all_of(styles.begin() + at, styles.begin() + at + part.size(), [style](Style s) { return s == style; });
+	}
+
+}; // namespace
+
+class LexerTest : public QObject
+{
+	Q_OBJECT
+
+  private slots:
+	void builtInLanguages()
+	{
+		for (const QString& name : { "cpp", "python", "java", "javascript", "html", "rust" })
+		{
+			const Lexer* lexer = Lexer::forLanguage(name);
+			QVERIFY(lexer != nullptr);
+			QCOMPARE(lexer->getName(), name);
+		}
+		QVERIFY(Lexer::forLanguage("sql") == nullptr);
+	}
+
+	void cpp()
+	{
+		const Lexer* cpp = Lexer::forLanguage("cpp");
+		Lexed lexed = lex(cpp, { "int main() { return 42; } // done", "QString s = \"a\\\"b\"; char c = '\\'';" });
+		QVERIFY(hasStyle(lexed, 0, "int", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "main", Style::Function));
+		QVERIFY(hasStyle(lexed, 0, "{ ", Style::Normal));
+		QVERIFY(hasStyle(lexed, 0, "return", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "42", Style::Number));
+		QVERIFY(hasStyle(lexed, 0, "// done", Style::Comment));
+		QVERIFY(hasStyle(lexed, 1, "QString", Style::Type));
+		QVERIFY(hasStyle(lexed, 1, " s = ", Style::Normal));
+		QVERIFY(hasStyle(lexed, 1, "\"a\\\"b\"", Style::String));
+		QVERIFY(hasStyle(lexed, 1, "'\\''", Style::String));
+		QCOMPARE(lexed.endState, 0);
+	}
+
+	void blockCommentAcrossLines()
+	{
+		Lexed lexed = lex(Lexer::forLanguage("cpp"), { "x /* open", "still", "end */ y" });
+		QVERIFY(hasStyle(lexed, 0, "x", Style::Normal));
+		QVERIFY(hasStyle(lexed, 0, "/* open", Style::Comment));
+		QVERIFY(hasStyle(lexed, 1, "still", Style::Comment));
+		QVERIFY(hasStyle(lexed, 2, "end */", Style::Comment));
+		QVERIFY(hasStyle(lexed, 2, "y", Style::Normal));
+		QCOMPARE(lexed.endState, 0);
+	}
+
+	void rawStringAcrossLines()
+	{
+		// ")\"" inside does not end a raw string whose terminator is ")x\""
+		Lexed lexed = lex(Lexer::forLanguage("cpp"), { "auto s = R\"x(a \")\" b", "c)x\"; int" });
+		QVERIFY(hasStyle(lexed, 0, "auto", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "R\"x(a \")\" b", Style::String));
+		QVERIFY(hasStyle(lexed, 1, "c)x\"", Style::String));
+		QVERIFY(hasStyle(lexed, 1, "int", Style::Keyword));
+		QCOMPARE(lexed.endState, 0);
+	}
+
+	void rustNestedComment()
+	{
+		Lexed lexed = lex(Lexer::forLanguage("rust"), { "fn main() { /* a /* b */ c */ x }" });
+		QVERIFY(hasStyle(lexed, 0, "fn", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "main", Style::Function));
+		QVERIFY(hasStyle(lexed, 0, "/* a /* b */ c */", Style::Comment));
+		QVERIFY(hasStyle(lexed, 0, " x }", Style::Normal));
+	}
+
+	void pythonTripleQuoted()
+	{
+		Lexed lexed = lex(Lexer::forLanguage("python"), { "def run():", "    \"\"\"doc", "    more", "    \"\"\" + x" });
+		QVERIFY(hasStyle(lexed, 0, "def", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "run", Style::Function));
+		QVERIFY(hasStyle(lexed, 1, "\"\"\"doc", Style::String));
+		QVERIFY(hasStyle(lexed, 2, "more", Style::String));
+		QVERIFY(hasStyle(lexed, 3, "\"\"\"", Style::String));
+		QVERIFY(hasStyle(lexed, 3, " + x", Style::Normal));
+	}
+
+	void javaScriptTemplateLiteral()
+	{
+		// The interpolated expression is code, with a template literal of its own
+		Lexed lexed = lex(Lexer::forLanguage("javascript"), { "let s = `a ${b + `c`} d`;" });
+		QVERIFY(hasStyle(lexed, 0, "let", Style::Keyword));
+		QVERIFY(hasStyle(lexed, 0, "`a ${", Style::String));
+		QVERIFY(hasStyle(lexed, 0, "b + ", Style::Normal));
+		QVERIFY(hasStyle(lexed, 0, "`c`", Style::String));
+		QVERIFY(hasStyle(lexed, 0, "} d`", Style::String));
+		QVERIFY(hasStyle(lexed, 0, ";", Style::Normal));
+		QCOMPARE(lexed.endState, 0);
+	}
+
+	void html()
+	{
+		Lexed lexed = lex(Lexer::forLanguage("html"), { "<a href=\"x\">&amp; text</a>", "<!-- open", "close --> after" });
+		QVERIFY(hasStyle(lexed, 0, "<a", Style::Tag));
+		QVERIFY(hasStyle(lexed, 0, "href", Style::Tag));
+		QVERIFY(hasStyle(lexed, 0, "\"x\"", Style::String));
+		QVERIFY(hasStyle(lexed, 0, "&amp;", Style::Entity));
+		QVERIFY(hasStyle(lexed, 0, " text", Style::Normal));
+		QVERIFY(hasStyle(lexed, 0, "</a>", Style::Tag));
+		QVERIFY(hasStyle(lexed, 1, "<!-- open", Style::Comment));
+		QVERIFY(hasStyle(lexed, 2, "close -->", Style::Comment));
+		QVERIFY(hasStyle(lexed, 2, " after", Style::Normal));
+	}
+
+	void randomText()
+	{
+		// Whatever the input, tokens are ordered, inside the line and non-empty, and lexing is repeatable
+		const QString alphabet = QString("/*\"'`${}<>!-&;#\\ \tR(x)aQZ09.=") + QChar(0x00E9) + QChar(0xD83D) + QChar(0xDE00);
+		QRandomGenerator random(1);
+		for (const QString& name : { "cpp", "python", "java", "javascript", "html", "rust" })
+		{
+			const Lexer* lexer = Lexer::forLanguage(name);
+			int state = 0;
+			for (int line = 0; line < 2000; ++line)
+			{
+				QString text;
+				qsizetype length = random.bounded(40);
+				for (qsizetype i = 0; i < length; ++i)
+				{
+					text += alphabet[random.bounded(int(alphabet.size()))];
+				}
+
+				QVector<syntax::Token> tokens;
+				int endState = lexer->tokenize(text, state, tokens);
+				QVERIFY(endState >= 0);
+				int previousEnd = 0;
+				for (const syntax::Token& token : tokens)
+				{
+					QVERIFY(token.length > 0);
+					QVERIFY(token.start >= previousEnd);
+					previousEnd = token.start + token.length;
+				}
+				QVERIFY(previousEnd <= text.size());
+
+				QVector<syntax::Token> again;
+				QCOMPARE(lexer->tokenize(text, state, again), endState);
+				QCOMPARE(again.size(), tokens.size());
+				state = endState;
+			}
+		}
+	}
+};
+
+QTEST_GUILESS_MAIN(LexerTest)
+#include "tst_lexer.moc"
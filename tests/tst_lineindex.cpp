@@ -0,0 +1,131 @@
+#include "core/lineindex.hpp"
+#include "core/piecetable.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+
+namespace
+{
+	QList<qsizetype> referenceLineStarts(const QString& text)
+	{
+		QList<qsizetype> starts = { 0 };
+		for (qsizetype i = 0; i < text.size(); ++i)
+		{
+			if (text[i] == u'\n')
+			{
+				starts.append(i + 1);
+			}
+		}
+		return starts;
+	}
+
+	QString randomLines(QRandomGenerator& random, qsizetype lineCount)
+	{
+		QString text;
+		for (qsizetype i = 0; i < lineCount; ++i)
+		{
+			text += QString(random.bounded(40), u'x') + u'\n';
+		}
+		return text;
+	}
+
+	void compare(const LineIndex& index, const QString& text, QRandomGenerator& random)
+	{
+		const QList<qsizetype> starts = referenceLineStarts(text);
+		QCOMPARE(index.lineCount(), starts.size());
+		for (qsizetype line = 0; line < starts.size(); ++line)
+		{
+			QCOMPARE(index.lineStart(line), starts[line]);
+		}
+		for (int i = 0; i < 100; ++i)
+		{
+			qsizetype pos = random.bounded(int(text.size() + 1));
+			qsizetype line = std::upper_bound(starts.cbegin(), starts.cend(), pos) - starts.cbegin() - 1;
+			QCOMPARE(index.lineAt(pos), line);
+		}
+	}
+
+}; // namespace
+
+class LineIndexTest : public QObject
+{
+	Q_OBJECT
+
+  private slots:
+	void findNewlines()
+	{
+		// Newlines at every position of the vector blocks and in the scalar tail
+		for (qsizetype length = 0; length < 70; ++length)
+		{
+			for (qsizetype at = 0; at < length; ++at)
+			{
+				QString text(length, u'a');
+				text[at] = u'\n';
+				text[length - 1] = u'\n';
+				QList<qsizetype> positions;
+				LineIndex::findNewlines(text, 100, positions);
+
+				QList<qsizetype> expected = referenceLineStarts(text).sliced(1);
+				for (qsizetype& position : expected)
+				{
+					position += 100 - 1;
+				}
+				QCOMPARE(positions, expected);
+			}
+		}
+	}
+
+	void emptyText()
+	{
+		LineIndex index;
+		QCOMPARE(index.lineCount(), qsizetype(1));
+		QCOMPARE(index.lineStart(0), qsizetype(0));
+		QCOMPARE(index.lineAt(0), qsizetype(0));
+
+		index.replace(0, 0, QString("\n\n"));
+		QCOMPARE(index.lineCount(), qsizetype(3));
+		QCOMPARE(index.lineStart(2), qsizetype(2));
+		index.replace(0, 2, QString());
+		QCOMPARE(index.lineCount(), qsizetype(1));
+	}
+
+	void randomEdits()
+	{
+		// Several chunks, edits that stay inside one, and removals and pastes that span or split them
+		QRandomGenerator random(1);
+		QString text = randomLines(random, 5 * LineIndex::chunkSize);
+		LineIndex index;
+		index.reset(PieceTable(text));
+		compare(index, text, random);
+
+		for (int i = 0; i < 300; ++i)
+		{
+			qsizetype pos = random.bounded(int(text.size() + 1));
+			qsizetype removed = 0;
+			QString inserted;
+			switch (random.bounded(4))
+			{
+				case 0: inserted = random.bounded(2) == 0 ? QString("\n") : QString("ab"); break;
+				case 1: removed = std::min<qsizetype>(random.bounded(3), text.size() - pos); break;
+				case 2: removed = std::min<qsizetype>(random.bounded(100000), text.size() - pos); break;
+				case 3: inserted = randomLines(random, random.bounded(3 * LineIndex::chunkSize)); break;
+			}
+
+			index.replace(pos, removed, inserted);
+			text.replace(pos, removed, inserted);
+			if (i % 10 == 0)
+			{
+				compare(index, text, random);
+			}
+		}
+		compare(index, text, random);
+
+		// Rebuilt from scratch, the index is the same
+		LineIndex rebuilt;
+		rebuilt.reset(PieceTable(text));
+		compare(rebuilt, text, random);
+	}
+};
+
+QTEST_GUILESS_MAIN(LineIndexTest)
+#include "tst_lineindex.moc"
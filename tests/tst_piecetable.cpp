@@ -0,0 +1,146 @@
+#include "core/piecetable.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+
+namespace
+{
+	QString randomText(QRandomGenerator& random, qsizetype length)
+	{
+		static const QString alphabet = "abcAB \n";
+		QString text;
+		text.reserve(length);
+		for (qsizetype i = 0; i < length; ++i)
+		{
+			text += alphabet[random.bounded(int(alphabet.size()))];
+		}
+		return text;
+	}
+
+	QString chunksOf(const PieceTable& text, qsizetype pos, qsizetype count)
+	{
+		QString joined;
+		text.forEachChunk(pos, count,
+		                  [&joined](QStringView chunk)
+		                  {
+			                  joined += chunk;
+			                  return true;
+		                  });
+		return joined;
+	}
+
+	// Non-overlapping matches, as PieceTable::count() counts them
+	qsizetype referenceCount(const QString& text, const QString& needle, Qt::CaseSensitivity cs)
+	{
+		qsizetype count = 0;
+		for (qsizetype hit = text.indexOf(needle, 0, cs); hit >= 0; hit = text.indexOf(needle, hit + needle.size(), cs))
+		{
+			++count;
+		}
+		return count;
+	}
+
+}; // namespace
+
+class PieceTableTest : public QObject
+{
+	Q_OBJECT
+
+  private slots:
+	void emptyTable()
+	{
+		PieceTable text;
+		QVERIFY(text.isEmpty());
+		QCOMPARE(text.length(), qsizetype(0));
+		QCOMPARE(text.toString(), QString());
+		QCOMPARE(text.indexOf(u"a"), qsizetype(-1));
+
+		text.insert(0, u"abc");
+		text.remove(0, 3);
+		QVERIFY(text.isEmpty());
+	}
+
+	void randomEdits()
+	{
+		// Small edits on a small alphabet make many pieces and matches that straddle them
+		QRandomGenerator random(1);
+		QString expected = randomText(random, 2000);
+		PieceTable text(expected);
+		for (int edit = 0; edit < 5000; ++edit)
+		{
+			qsizetype pos = random.bounded(int(expected.size() + 1));
+			if (random.bounded(2) == 0)
+			{
+				QString inserted = randomText(random, random.bounded(1, 12));
+				text.insert(pos, inserted);
+				expected.insert(pos, inserted);
+			}
+			else
+			{
+				qsizetype count = std::min<qsizetype>(random.bounded(12), expected.size() - pos);
+				text.remove(pos, count);
+				expected.remove(pos, count);
+			}
+			QCOMPARE(text.length(), expected.size());
+
+			if (edit % 250 == 0)
+			{
+				QCOMPARE(text.toString(), expected);
+			}
+		}
+		QCOMPARE(text.toString(), expected);
+
+		for (int query = 0; query < 500; ++query)
+		{
+			qsizetype pos = random.bounded(int(expected.size()));
+			qsizetype count = random.bounded(int(expected.size() - pos + 1));
+			QCOMPARE(text.at(pos), expected.at(pos));
+			QCOMPARE(text.slice(pos, count), expected.sliced(pos, count));
+			QCOMPARE(chunksOf(text, pos, count), expected.sliced(pos, count));
+		}
+	}
+
+	void find()
+	{
+		QRandomGenerator random(2);
+		QString expected = randomText(random, 3000);
+		PieceTable text(expected);
+		for (int edit = 0; edit < 1000; ++edit)
+		{
+			qsizetype pos = random.bounded(int(expected.size() + 1));
+			QString inserted = randomText(random, random.bounded(1, 6));
+			text.insert(pos, inserted);
+			expected.insert(pos, inserted);
+		}
+
+		for (int query = 0; query < 300; ++query)
+		{
+			QString needle = randomText(random, random.bounded(1, 6));
+			qsizetype from = random.bounded(int(expected.size()));
+			for (Qt::CaseSensitivity cs : { Qt::CaseSensitive, Qt::CaseInsensitive })
+			{
+				QCOMPARE(text.indexOf(needle, from, cs), expected.indexOf(needle, from, cs));
+				QCOMPARE(text.count(needle, cs), referenceCount(expected, needle, cs));
+			}
+		}
+	}
+
+	void snapshot()
+	{
+		// A copy keeps the text it was taken from while the original is edited
+		PieceTable text(QString("first line\nsecond line\n"));
+		text.insert(6, u"piece ");
+		PieceTable copy = text;
+
+		text.remove(0, 6);
+		text.insert(0, u"changed ");
+		QCOMPARE(copy.toString(), QString("first piece line\nsecond line\n"));
+		QCOMPARE(text.toString(), QString("changed piece line\nsecond line\n"));
+
+		text.reset();
+		QVERIFY(text.isEmpty());
+		QCOMPARE(copy.length(), qsizetype(29));
+	}
+};
+
+QTEST_GUILESS_MAIN(PieceTableTest)
+#include "tst_piecetable.moc"
@@ -0,0 +1,152 @@
+#include "core/piecetable.hpp"
+#include "core/searchindex.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+
+namespace
+{
+	const QStringList words = { "value", "index", "buffer", "Count", "RESULT", "node", "größe", "значение", "x", "ab", "_" };
+
+	// Lines of words, long enough in total to spread over many segments
+	QString randomText(QRandomGenerator& random, qsizetype length)
+	{
+		QString text;
+		while (text.size() < length)
+		{
+			text += words[random.bounded(int(words.size()))];
+			text += random.bounded(8) == 0 ? u'\n' : u' ';
+		}
+		return text;
+	}
+
+	// Non-overlapping matches from the start, the way SearchIndex::findAll() reports them
+	QList<qsizetype> referenceMatches(const PieceTable& text, QStringView needle, Qt::CaseSensitivity cs)
+	{
+		QList<qsizetype> starts;
+		for (qsizetype hit = text.indexOf(needle, 0, cs); hit >= 0; hit = text.indexOf(needle, hit + needle.size(), cs))
+		{
+			starts.append(hit);
+		}
+		return starts;
+	}
+
+	QList<qsizetype> startsOf(const QList<SearchIndex::Range>& ranges)
+	{
+		QList<qsizetype> starts;
+		for (const SearchIndex::Range& range : ranges)
+		{
+			starts.append(range.start);
+		}
+		return starts;
+	}
+
+	QString randomNeedle(QRandomGenerator& random, const PieceTable& text)
+	{
+		switch (random.bounded(4))
+		{
+			// Short and multi-line needles cannot be filtered and take the fallback
+			case 0: return random.bounded(2) == 0 ? "ab" : "e\nv";
+			// Absent from the text
+			case 1: return "zzzq";
+			default:
+			{
+				qsizetype start = random.bounded(int(text.length() - 8));
+				return text.slice(start, random.bounded(3, 8));
+			}
+		}
+	}
+
+}; // namespace
+
+class SearchIndexTest : public QObject
+{
+	Q_OBJECT
+
+  private:
+	static void compareQueries(const SearchIndex& index, const PieceTable& text, QRandomGenerator& random)
+	{
+		for (int query = 0; query < 40; ++query)
+		{
+			QString needle = randomNeedle(random, text);
+			for (Qt::CaseSensitivity cs : { Qt::CaseSensitive, Qt::CaseInsensitive })
+			{
+				QList<qsizetype> expected = referenceMatches(text, needle, cs);
+				QCOMPARE(startsOf(index.findAll(text, needle, cs)), expected);
+
+				// First match at or after from, else the first one of the text
+				qsizetype from = random.bounded(int(text.length()));
+				qsizetype expectedNext = text.indexOf(needle, from, cs);
+				if (expectedNext < 0)
+				{
+					expectedNext = text.indexOf(needle, 0, cs);
+				}
+				SearchIndex::Range found = index.findNext(text, needle, from, cs);
+				QCOMPARE(found.start, expectedNext);
+				QCOMPARE(found.length, expectedNext >= 0 ? needle.size() : qsizetype(0));
+			}
+
+			// Every match lies in one of the candidate ranges
+			const QList<SearchIndex::Range> candidates = index.candidateRanges(needle);
+			for (qsizetype start : referenceMatches(text, needle, Qt::CaseInsensitive))
+			{
+				bool covered = std::any_of(candidates.cbegin(),
+				                           candidates.cend(),
+				                           [&](const SearchIndex::Range& range)
+				                           { return start >= range.start && start + needle.size() <= range.start + range.length; });
+				QVERIFY(covered);
+			}
+		}
+	}
+
+  private slots:
+	void wholeText()
+	{
+		QRandomGenerator random(1);
+		PieceTable text(randomText(random, 10 * SearchIndex::segmentChars));
+		SearchIndex index;
+		index.reset(text);
+		compareQueries(index, text, random);
+	}
+
+	void edits()
+	{
+		// Edits rebuild the segments they touch and shift the rest, the results must not change
+		QRandomGenerator random(2);
+		PieceTable text(randomText(random, 10 * SearchIndex::segmentChars));
+		SearchIndex index;
+		index.reset(text);
+
+		for (int edit = 0; edit < 600; ++edit)
+		{
+			qsizetype pos = random.bounded(int(text.length() + 1));
+			qsizetype removed = std::min<qsizetype>(random.bounded(random.bounded(10) == 0 ? 3000 : 30), text.length() - pos);
+			QString inserted = randomText(random, random.bounded(random.bounded(10) == 0 ? 3000 : 30));
+			text.remove(pos, removed);
+			text.insert(pos, inserted);
+			index.replace(text, pos, removed, inserted.size());
+
+			if (edit % 100 == 0)
+			{
+				compareQueries(index, text, random);
+			}
+		}
+		compareQueries(index, text, random);
+	}
+
+	void disabled()
+	{
+		QRandomGenerator random(3);
+		PieceTable text(randomText(random, 3 * SearchIndex::segmentChars));
+		SearchIndex index;
+		index.setEnabled(false, text);
+		QVERIFY(!index.isEnabled());
+
+		text.insert(0, u"index value\n");
+		index.replace(text, 0, 0, 12);
+		compareQueries(index, text, random);
+	}
+};
+
+QTEST_GUILESS_MAIN(SearchIndexTest)
+#include "tst_searchindex.moc"
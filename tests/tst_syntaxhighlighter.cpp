@@ -0,0 +1,82 @@
+#include "core/languageregistry.hpp"
+#include "core/syntaxhighlighter.hpp"
+#include <QTest>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+namespace
+{
+	// Lines of one length but different tokens and brackets, so a result stored on the wrong line goes unnoticed by a length check
+	QString sampleText(int lineCount)
+	{
+		const QStringList samples = { "int a = 42;", "// comment {", "f(\"str{\");", "{ return 1;", "}", "/* a */ x++;", "" };
+		QStringList lines;
+		for (int i = 0; i < lineCount; ++i)
+		{
+			lines.append(samples[i % samples.size()].leftJustified(16));
+		}
+		return lines.join(u'\n');
+	}
+
+}; // namespace
+
+class SyntaxHighlighterTest : public QObject
+{
+	Q_OBJECT
+
+  private:
+	// Every block carries the tokens of its own text, lexed in the state the block before it ends in
+	static void compareWithLexer(const QTextDocument& document, const Lexer* lexer)
+	{
+		int state = 0;
+		for (QTextBlock block = document.begin(); block.isValid(); block = block.next())
+		{
+			QVector<syntax::Token> expected;
+			int exitState = lexer->tokenize(block.text(), state, expected);
+
+			const HighlightBlockData* data = static_cast<const HighlightBlockData*>(block.userData());
+			QVERIFY(data != nullptr);
+			QVERIFY(!data->pending);
+			QCOMPARE(data->revision, block.revision());
+			QCOMPARE(data->entryState, state);
+			QCOMPARE(data->exitState, exitState);
+			QCOMPARE(block.userState(), exitState);
+			QCOMPARE(data->tokens.size(), expected.size());
+			for (qsizetype i = 0; i < expected.size(); ++i)
+			{
+				QCOMPARE(data->tokens[i].start, expected[i].start);
+				QCOMPARE(data->tokens[i].length, expected[i].length);
+				QVERIFY(data->tokens[i].style == expected[i].style);
+			}
+			state = exitState;
+		}
+	}
+
+  private slots:
+	void lineInsertedWhileTokenizing()
+	{
+		const syntax::LanguageDefinition* cpp = LanguageRegistry::instance().find("cpp");
+		QVERIFY(cpp != nullptr && cpp->lexer != nullptr);
+
+		// At the start of the run the tokenizer is working on, right after its first line and in its middle
+		for (int line : { 0, 1, 50 })
+		{
+			QTextDocument document;
+			SyntaxHighlighter highlighter(&document);
+			document.setPlainText(sampleText(200));
+			QVERIFY(highlighter.isBusy());
+
+			// The results are delivered through the event loop, so the job is still in flight here. The new
+			// line shifts the blocks after it; their revisions stay the same as those of all the others
+			QTextCursor cursor(document.findBlockByNumber(line));
+			cursor.insertText(QString("long x = 0;").leftJustified(16) + "\n");
+
+			QTRY_VERIFY(!highlighter.isBusy());
+			compareWithLexer(document, cpp->lexer);
+		}
+	}
+};
+
+QTEST_MAIN(SyntaxHighlighterTest)
+#include "tst_syntaxhighlighter.moc"
@@ -0,0 +1,201 @@
+#include "core/streamingwriter.hpp"
+#include "core/textcodec.hpp"
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QStringEncoder>
+#include <QTest>
+#include <algorithm>
+
+namespace
+{
+	// ASCII runs long enough for the vector loops, mixed with 2-, 3- and 4-byte sequences
+	QString randomText(QRandomGenerator& random, qsizetype length)
+	{
+		const QStringList pieces = {
+			"The quick brown fox jumps over the lazy dog. ",
+			"\n",
+			QString(QChar(0x00E9)), // é, 2 bytes
+			QString(QChar(0x0436)), // ж, 2 bytes
+			QString(QChar(0x20AC)), // €, 3 bytes
+			QString(QChar(0xFFFD)), // 3 bytes
+			QString::fromUcs4(U"\U0001F600"), // 4 bytes
+			QString::fromUcs4(U"\U0010FFFF")
+		};
+		QString text;
+		while (text.size() < length)
+		{
+			const QString& piece = pieces[random.bounded(int(pieces.size()))];
+			text += random.bounded(2) == 0 ? piece : piece.first(1);
+			if (text.back().isHighSurrogate())
+			{
+				text.chop(1);
+			}
+		}
+		return text;
+	}
+
+	QByteArray encode(QStringConverter::Encoding encoding, const QString& text, QStringConverter::Flags flags = QStringConverter::Flag::Default)
+	{
+		QStringEncoder encoder(encoding, flags);
+		return encoder.encode(text);
+	}
+
+	QByteArray writeAll(const QString& text, QStringConverter::Encoding encoding, bool writeBom, bool& ok, QString& error)
+	{
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		StreamingWriter writer(&buffer, encoding, writeBom);
+		// Uneven pieces, so surrogate pairs get split between calls
+		ok = true;
+		for (qsizetype offset = 0; offset < text.size(); offset += 4099)
+		{
+			ok = ok && writer.write(QStringView(text).sliced(offset, std::min<qsizetype>(4099, text.size() - offset)));
+		}
+		ok = ok && writer.flush();
+		error = writer.errorString();
+		return buffer.data();
+	}
+
+}; // namespace
+
+class TextCodecTest : public QObject
+{
+	Q_OBJECT
+
+  private slots:
+	void decodeUtf8()
+	{
+		QRandomGenerator random(1);
+		for (int round = 0; round < 100; ++round)
+		{
+			QString text = randomText(random, random.bounded(2000));
+			QByteArray bytes = text.toUtf8();
+
+			QString decoded;
+			QVERIFY(textcodec::isValidUtf8(bytes));
+			QVERIFY(textcodec::decodeUtf8(bytes, decoded));
+			QCOMPARE(decoded, text);
+		}
+	}
+
+	void rejectInvalidUtf8()
+	{
+		// Overlong, an encoded surrogate, past U+10FFFF, cut off, a stray continuation byte and an invalid lead
+		const QList<QByteArray> invalid = { "\xC0\x80", "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xE2\x82", "\x80", "\xFF" };
+		for (const QByteArray& sequence : invalid)
+		{
+			// At the end of a vector-sized ASCII run and in the scalar tail
+			for (const QByteArray& prefix : { QByteArray(), QByteArray(40, 'a') })
+			{
+				QByteArray bytes = prefix + sequence + "tail";
+				QString decoded;
+				QVERIFY(!textcodec::isValidUtf8(bytes));
+				QVERIFY(!textcodec::decodeUtf8(bytes, decoded));
+				// The fallback replaces the sequence instead of dropping the text
+				QVERIFY(textcodec::decode(bytes, textcodec::Encoding::Utf8).endsWith("tail"));
+			}
+		}
+	}
+
+	void asciiPrefixLength()
+	{
+		QByteArray bytes(100, 'x');
+		for (qsizetype i = 0; i < bytes.size(); ++i)
+		{
+			QByteArray copy = bytes;
+			copy[i] = char(0xC3);
+			QCOMPARE(textcodec::asciiPrefixLength(copy), i);
+		}
+		QCOMPARE(textcodec::asciiPrefixLength(bytes), bytes.size());
+	}
+
+	void detectEncoding()
+	{
+		using textcodec::Encoding;
+		QString text = "plain text, " + QString(QChar(0x00E9)) + "t" + QString(QChar(0x00E9)) + "\n";
+
+		textcodec::Detection detected = textcodec::detectEncoding("\xEF\xBB\xBF" + text.toUtf8());
+		QVERIFY(detected.encoding == Encoding::Utf8 && detected.bomLength == 3);
+		detected = textcodec::detectEncoding("\xFF\xFE" + encode(QStringConverter::Utf16LE, text));
+		QVERIFY(detected.encoding == Encoding::Utf16LE && detected.bomLength == 2);
+		detected = textcodec::detectEncoding(encode(QStringConverter::Utf16BE, text));
+		QVERIFY(detected.encoding == Encoding::Utf16BE && detected.bomLength == 0);
+		detected = textcodec::detectEncoding(text.toLatin1());
+		QVERIFY(detected.encoding == Encoding::Latin1);
+
+		// A sample cut in the middle of a sequence is still UTF-8
+		QByteArray utf8 = text.toUtf8();
+		detected = textcodec::detectEncoding(utf8.first(utf8.indexOf('t', 12) - 1));
+		QVERIFY(detected.encoding == Encoding::Utf8);
+	}
+
+	void completeLinesLength()
+	{
+		using textcodec::Encoding;
+		QCOMPARE(textcodec::completeLinesLength("one\ntwo\nthr", Encoding::Utf8), qsizetype(8));
+		QCOMPARE(textcodec::completeLinesLength("no newline", Encoding::Latin1), qsizetype(0));
+
+		QCOMPARE(textcodec::completeLinesLength(encode(QStringConverter::Utf16LE, "one\ntwo"), Encoding::Utf16LE), qsizetype(8));
+		QCOMPARE(textcodec::completeLinesLength(encode(QStringConverter::Utf16BE, "one\ntwo"), Encoding::Utf16BE), qsizetype(8));
+		// U+0A00 has the bytes of a newline the other way round
+		QString swapped = QString(QChar(0x0A00)) + "x";
+		QCOMPARE(textcodec::completeLinesLength(encode(QStringConverter::Utf16LE, swapped), Encoding::Utf16LE), qsizetype(0));
+	}
+
+	void completeCharactersLength()
+	{
+		using textcodec::Encoding;
+		// 2-byte é, 3-byte €, 4-byte emoji: a cut inside any of them backs off to before it
+		QByteArray utf8 = QString("ab" + QString(QChar(0x00E9)) + QChar(0x20AC) + QString::fromUcs4(U"\U0001F600")).toUtf8();
+		const QList<qsizetype> complete = { 0, 1, 2, 2, 4, 4, 4, 7, 7, 7, 7, 11 };
+		for (qsizetype cut = 0; cut <= utf8.size(); ++cut)
+		{
+			QCOMPARE(textcodec::completeCharactersLength(utf8.first(cut), Encoding::Utf8), complete[cut]);
+		}
+		QCOMPARE(textcodec::completeCharactersLength("line\r", Encoding::Utf8), qsizetype(4));
+		QCOMPARE(textcodec::completeCharactersLength("caf\xE9\r", Encoding::Latin1), qsizetype(4));
+
+		for (QStringConverter::Encoding encoding : { QStringConverter::Utf16LE, QStringConverter::Utf16BE })
+		{
+			Encoding ours = encoding == QStringConverter::Utf16LE ? Encoding::Utf16LE : Encoding::Utf16BE;
+			QByteArray utf16 = encode(encoding, "ab" + QString::fromUcs4(U"\U0001F600"));
+			const QList<qsizetype> units = { 0, 0, 2, 2, 4, 4, 4, 4, 8 };
+			for (qsizetype cut = 0; cut <= utf16.size(); ++cut)
+			{
+				QCOMPARE(textcodec::completeCharactersLength(utf16.first(cut), ours), units[cut]);
+			}
+			QCOMPARE(textcodec::completeCharactersLength(encode(encoding, "line\r"), ours), qsizetype(8));
+		}
+	}
+
+	void writeEncoded()
+	{
+		QRandomGenerator random(2);
+		QString text = randomText(random, 3 * StreamingWriter::bufferSize);
+		for (QStringConverter::Encoding encoding : { QStringConverter::Utf8, QStringConverter::Utf16LE, QStringConverter::Utf16BE })
+		{
+			bool ok = false;
+			QString error;
+			QByteArray written = writeAll(text, encoding, true, ok, error);
+			QVERIFY(ok);
+			QCOMPARE(written, encode(encoding, text, QStringConverter::Flag::WriteBom));
+		}
+	}
+
+	void failOnUnencodableText()
+	{
+		// é is in Latin-1, ж is not and would be written as '?'
+		bool ok = false;
+		QString error;
+		QString latin1 = QString(5000, u'a') + QChar(0x00E9);
+		QCOMPARE(writeAll(latin1, QStringConverter::Latin1, false, ok, error), latin1.toLatin1());
+		QVERIFY(ok);
+
+		writeAll(QString(5000, u'a') + QChar(0x0436) + "tail", QStringConverter::Latin1, false, ok, error);
+		QVERIFY(!ok);
+		QVERIFY(!error.isEmpty());
+	}
+};
+
+QTEST_GUILESS_MAIN(TextCodecTest)
+#include "tst_textcodec.moc"
@@ -0,0 +1,211 @@
+#include "core/piecetable.hpp"
+#include "core/textstats.hpp"
+#include <QRandomGenerator>
+#include <QTest>
+
+namespace
+{
+	// Word characters, others, surrogate pairs (a letter and an emoji) and, last, a lone surrogate
+	const QStringList alphabet = {
+		"a", "Z", "q", "7", "_", " ", " ", "\n", "\t", ".", "(", "-",
+		QString(QChar(0x00E9)), // é
+		QString(QChar(0x0436)), // ж
+		QString(QChar(0x5B57)), // CJK ideograph
+		QString(QChar(0x0301)), // combining acute accent, a mark
+		QString(QChar(0x00A0)), // no-break space, not counted as a space
+		QString::fromUcs4(U"\U0001D400"),
+		QString::fromUcs4(U"\U0001F600"),
+		QString(QChar(0xD800))
+	};
+
+	// Scalar reference for textstats::count(): one code point at a time, by QChar properties
+	textstats::Counts referenceCount(QStringView text)
+	{
+		textstats::Counts counts;
+		counts.chars = text.size();
+		bool inWord = false;
+		for (qsizetype i = 0; i < text.size(); ++i)
+		{
+			char32_t c = text[i].unicode();
+			if (QChar::isHighSurrogate(c) && i + 1 < text.size() && text[i + 1].isLowSurrogate())
+			{
+				c = QChar::surrogateToUcs4(text[i], text[i + 1]);
+				++i;
+			}
+
+			bool word = c < 0x80 ? (QChar::isLetterOrNumber(c) || c == U'_') : (QChar::isLetterOrNumber(c) || QChar::isMark(c));
+			counts.words += word && !inWord;
+			inWord = word;
+			counts.spaces += c == U' ';
+		}
+		return counts;
+	}
+
+	// Long ASCII runs reach the vector loops, the rest goes through the scalar tail and Unicode paths
+	QString randomText(QRandomGenerator& random, qsizetype length, bool validUtf16)
+	{
+		QString text;
+		while (text.size() < length)
+		{
+			if (random.bounded(4) == 0)
+			{
+				static const QString ascii = "The quick_brown fox 42 jumps over lazy dogs; ";
+				qsizetype run = random.bounded(80);
+				for (qsizetype i = 0; i < run; ++i)
+				{
+					text += ascii[random.bounded(int(ascii.size()))];
+				}
+				continue;
+			}
+
+			qsizetype symbols = validUtf16 ? alphabet.size() - 1 : alphabet.size();
+			text += alphabet[random.bounded(int(symbols))];
+		}
+		return text;
+	}
+
+	textstats::Counts countChunked(QStringView text, QRandomGenerator& random)
+	{
+		textstats::Counts total;
+		textstats::ScanState state;
+		qsizetype pos = 0;
+		while (pos < text.size())
+		{
+			qsizetype length = std::min<qsizetype>(text.size() - pos, random.bounded(1, 100));
+			textstats::Counts counts = textstats::count(text.sliced(pos, length), state);
+			total.words += counts.words;
+			total.chars += counts.chars;
+			total.spaces += counts.spaces;
+			pos += length;
+		}
+		return total;
+	}
+
+	// Pieces never split a multi-byte sequence, as countUtf8() requires
+	textstats::Counts countUtf8Chunked(QByteArrayView bytes, QRandomGenerator& random)
+	{
+		textstats::Counts total;
+		textstats::ScanState state;
+		qsizetype pos = 0;
+		while (pos < bytes.size())
+		{
+			qsizetype end = std::min<qsizetype>(bytes.size(), pos + random.bounded(1, 100));
+			while (end < bytes.size() && (uchar(bytes[end]) & 0xC0) == 0x80)
+			{
+				++end;
+			}
+			textstats::Counts counts = textstats::countUtf8(bytes.sliced(pos, end - pos), state);
+			total.words += counts.words;
+			total.chars += counts.chars;
+			total.spaces += counts.spaces;
+			pos = end;
+		}
+		return total;
+	}
+
+}; // namespace
+
+class TextStatsTest : public QObject
+{
+	Q_OBJECT
+
+  private:
+	static void compare(const textstats::Counts& actual, const textstats::Counts& expected)
+	{
+		QCOMPARE(actual.words, expected.words);
+		QCOMPARE(actual.chars, expected.chars);
+		QCOMPARE(actual.spaces, expected.spaces);
+	}
+
+  private slots:
+	void wholeText()
+	{
+		QRandomGenerator random(1);
+		for (qsizetype length : { 0, 1, 7, 8, 15, 16, 31, 32, 33, 1000, 100000 })
+		{
+			QString text = randomText(random, length, false);
+			textstats::ScanState state;
+			compare(textstats::count(text, state), referenceCount(text));
+		}
+	}
+
+	void asciiBlockBoundaries()
+	{
+		// Words that start, end or continue exactly at the 8, 16 and 32 character block edges
+		for (qsizetype offset = 0; offset < 40; ++offset)
+		{
+			QString text = QString(offset, u' ') + "word_1 x" + QString(offset % 9, u'y') + " z" + QString(33, u'w') + " end";
+			textstats::ScanState state;
+			compare(textstats::count(text, state), referenceCount(text));
+		}
+	}
+
+	void randomChunking()
+	{
+		QRandomGenerator random(2);
+		for (int round = 0; round < 50; ++round)
+		{
+			QString text = randomText(random, random.bounded(1, 5000), false);
+			compare(countChunked(text, random), referenceCount(text));
+		}
+	}
+
+	void utf8MatchesUtf16()
+	{
+		QRandomGenerator random(3);
+		for (int round = 0; round < 50; ++round)
+		{
+			QString text = randomText(random, random.bounded(1, 5000), true);
+			compare(countUtf8Chunked(text.toUtf8(), random), referenceCount(text));
+		}
+	}
+
+	void utf8MalformedBytes()
+	{
+		// Each malformed byte is one non-word character
+		textstats::ScanState state;
+		textstats::Counts counts = textstats::countUtf8(QByteArrayView("ab\xFF" "cd \xC3 e\xE2\x82", 11), state);
+		QCOMPARE(counts.words, qsizetype(3));
+		QCOMPARE(counts.chars, qsizetype(11));
+		QCOMPARE(counts.spaces, qsizetype(2));
+	}
+
+	void pieceTable()
+	{
+		// Past the parallel threshold and edited, so ranges and pieces split words and surrogate pairs
+		QRandomGenerator random(4);
+		PieceTable text(randomText(random, 9 * 1024 * 1024, false));
+		for (int edit = 0; edit < 200; ++edit)
+		{
+			qsizetype pos = random.bounded(int(text.length()));
+			text.remove(pos, std::min<qsizetype>(random.bounded(20), text.length() - pos));
+			text.insert(random.bounded(int(text.length())), randomText(random, random.bounded(20), false));
+		}
+		compare(textstats::count(text), referenceCount(text.toString()));
+	}
+
+	void incrementalStats()
+	{
+		QRandomGenerator random(5);
+		PieceTable text(randomText(random, 20000, false));
+		TextStats stats;
+		stats.reset(text);
+		for (int edit = 0; edit < 2000; ++edit)
+		{
+			qsizetype pos = random.bounded(int(text.length() + 1));
+			qsizetype removed = std::min<qsizetype>(random.bounded(10), text.length() - pos);
+			QString inserted = randomText(random, random.bounded(10), false);
+			stats.replace(text, pos, removed, inserted);
+			text.remove(pos, removed);
+			text.insert(pos, inserted);
+		}
+
+		textstats::Counts expected = referenceCount(text.toString());
+		QCOMPARE(stats.wordCount(), expected.words);
+		QCOMPARE(stats.charCount(), expected.chars);
+		QCOMPARE(stats.nonSpaceCount(), expected.chars - expected.spaces);
+	}
+};
+
+QTEST_GUILESS_MAIN(TextStatsTest)
+#include "tst_textstats.moc"